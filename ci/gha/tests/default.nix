@@ -55,6 +55,7 @@ rec {
       # Build the fuzz targets in CI.
       withFuzzTargets = withSanitizers;
 
+      nix-util-tests = prev.nix-util-tests.override { withBenchmarks = true; };
       nix-store-tests = prev.nix-store-tests.override { withBenchmarks = true; };
       nix-expr-tests = prev.nix-expr-tests.override { withBenchmarks = true; };
       # Boehm is incompatible with ASAN.
@@ -81,6 +82,7 @@ rec {
     installTests = hydraJobs.installTests.${system};
     nixpkgsLibTests = hydraJobs.tests.nixpkgsLibTests.${system};
     filetransfer-retry-backoff = hydraJobs.tests.filetransfer-retry-backoff.${system};
+    filetransfer-range-resume = hydraJobs.tests.filetransfer-range-resume.${system};
     rl-next = pkgs.buildPackages.runCommand "test-rl-next-release-notes" { } ''
       LANG=C.UTF-8 ${pkgs.changelog-d}/bin/changelog-d ${../../../doc/manual/rl-next} >$out
     '';
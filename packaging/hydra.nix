@@ -411,6 +411,13 @@ rec {
           nix = nixpkgsFor.${system}.native.nixComponents2.nix-cli;
         }
       );
+
+      filetransfer-range-resume = forAllSystems (
+        system:
+        nixpkgsFor.${system}.native.callPackage ../tests/filetransfer-range-resume {
+          nix = nixpkgsFor.${system}.native.nixComponents2.nix-cli;
+        }
+      );
     };
 
   metrics.nixpkgs = import "${nixpkgs-regression}/pkgs/top-level/metrics.nix" {
@@ -0,0 +1,62 @@
+#include <benchmark/benchmark.h>
+
+#include "nix/expr/eval.hh"
+#include "nix/expr/eval-settings.hh"
+#include "nix/fetchers/fetch-settings.hh"
+#include "nix/store/store-open.hh"
+
+namespace nix {
+
+/**
+ * Evaluate a function that is dominated by conditionals and equality
+ * tests, like the `mkIf`/`mkMerge` and type-checking helpers of the
+ * module system, with or without `eval-bytecode`.
+ */
+static void BM_EvalConditionals(benchmark::State & state)
+{
+    const auto n = static_cast<size_t>(state.range(0));
+    const bool bytecode = state.range(1);
+    const auto exprStr = fmt(
+        R"(
+          let
+            classify = x: t:
+              if t == "int" && x != null then
+                (if x == 0 then "zero" else if x == 1 || x == 2 then "small" else "big")
+              else if t == "bool" -> x == true then
+                "true"
+              else
+                "other";
+          in
+          builtins.foldl' (acc: i: if classify i "int" == "big" then acc + 1 else acc) 0 (builtins.genList (x: x) %d)
+        )",
+        n);
+
+    for (auto _ : state) {
+        state.PauseTiming();
+
+        auto store = openStore("dummy://");
+        fetchers::Settings fetchSettings{};
+        bool readOnlyMode = true;
+        EvalSettings evalSettings{readOnlyMode};
+        evalSettings.nixPath = {};
+        evalSettings.evalBytecode = bytecode;
+
+        auto stPtr = std::make_shared<EvalState>(LookupPath{}, store, fetchSettings, evalSettings, nullptr);
+        auto & st = *stPtr;
+        Expr * expr = st.parseExprFromString(exprStr, st.rootPath(CanonPath::root));
+
+        Value v;
+
+        state.ResumeTiming();
+
+        st.eval(expr, v);
+        st.forceValue(v, noPos);
+        benchmark::DoNotOptimize(v);
+    }
+
+    state.SetItemsProcessed(state.iterations() * n);
+}
+
+BENCHMARK(BM_EvalConditionals)->ArgsProduct({{10'000, 100'000}, {false, true}})->ArgNames({"n", "bytecode"});
+
+} // namespace nix
@@ -1,7 +1,9 @@
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
+#include "nix/expr/bytecode.hh"
 #include "nix/expr/eval.hh"
+#include "nix/expr/print.hh"
 #include "nix/expr/tests/libexpr.hh"
 
 namespace nix {
@@ -211,4 +213,153 @@ TEST_F(PureEvalTest, pathExists)
     }
 }
 
+class BytecodeTest : public LibExprTest
+{
+public:
+    BytecodeTest()
+        : LibExprTest(openStore("dummy://"), [](bool & readOnlyMode) {
+            EvalSettings settings{readOnlyMode};
+            settings.nixPath = {};
+            settings.evalBytecode = true;
+            return settings;
+        })
+    {
+        astSettings.nixPath = {};
+    }
+
+    /**
+     * Evaluate `input` deeply, and return the printed result, or the
+     * error message and its traces.
+     */
+    static std::string evalToString(EvalState & st, const std::string & input)
+    {
+        try {
+            Value v;
+            st.eval(st.parseExprFromString(input, st.rootPath(CanonPath::root)), v);
+            st.forceValueDeep(v);
+            std::ostringstream out;
+            out << ValuePrinter(st, v, PrintOptions{.force = true});
+            return out.str();
+        } catch (Error & e) {
+            std::ostringstream out;
+            out << "error: " << e.info().msg.str();
+            for (auto & trace : e.info().traces) {
+                out << "\n  " << trace.hint.str();
+                if (trace.pos)
+                    out << " at " << trace.pos->line << ":" << trace.pos->column;
+            }
+            return out.str();
+        }
+    }
+
+    /**
+     * Check that evaluating `input` with bytecode gives the same
+     * result as the AST interpreter.
+     */
+    void expectSameAsAST(const std::string & input)
+    {
+        EXPECT_EQ(evalToString(state, input), evalToString(astState, input)) << input;
+    }
+
+    EvalSettings astSettings{readOnlyMode};
+    EvalState astState{{}, store, fetchSettings, astSettings, nullptr};
+};
+
+TEST_F(BytecodeTest, compilesLambdaBodies)
+{
+    auto e = dynamic_cast<ExprLambda *>(state.parseExprFromString("x: if x then 1 else 2", state.rootPath(".")));
+    ASSERT_NE(e, nullptr);
+    ASSERT_NE(e->bytecode, nullptr);
+
+    /* Nothing to gain from compiling a single call. */
+    e = dynamic_cast<ExprLambda *>(state.parseExprFromString("x: builtins.toString x", state.rootPath(".")));
+    ASSERT_NE(e, nullptr);
+    ASSERT_EQ(e->bytecode, nullptr);
+
+    e = dynamic_cast<ExprLambda *>(astState.parseExprFromString("x: if x then 1 else 2", astState.rootPath(".")));
+    ASSERT_NE(e, nullptr);
+    ASSERT_EQ(e->bytecode, nullptr);
+}
+
+TEST_F(BytecodeTest, sameResults)
+{
+    expectSameAsAST("(x: if x then 1 else 2) true");
+    expectSameAsAST("(x: if x then 1 else 2) false");
+    expectSameAsAST("map (x: x == 2 || x == 3 && !(x != 3)) [ 1 2 3 4 ]");
+    expectSameAsAST("map (x: x > 2 -> x < 4) [ 1 2 3 4 5 ]");
+    expectSameAsAST("(x: y: if x == y then \"same\" else [ x y ]) { a = 1; } { a = 1.0; }");
+    expectSameAsAST("(x: { inherit x; y = x; }) 1");
+    expectSameAsAST("let f = n: if n == 0 then 0 else n + f (n - 1); in f 100");
+    expectSameAsAST("let x = 1; in with { y = 2; }; (z: if z then y else x) true");
+    expectSameAsAST("({ a, b ? a == 1 }: if b then a else null) { a = 1; }");
+    expectSameAsAST("(x: if x then throw \"foo\" else 1) false");
+}
+
+TEST_F(BytecodeTest, sameErrors)
+{
+    expectSameAsAST("(x: if x then 1 else 2) 1");
+    expectSameAsAST("(x: !x) \"foo\"");
+    expectSameAsAST("(x: x && true) null");
+    expectSameAsAST("(x: true && x) null");
+    expectSameAsAST("(x: false || x) { }");
+    expectSameAsAST("(x: x -> true) [ ]");
+    expectSameAsAST("(x: if x && (x || x) then 1 else 2) 1");
+    expectSameAsAST("(x: if x then throw \"foo\" else 1) true");
+    expectSameAsAST("(x: if x == 1 then abort \"bar\" else 1) 1");
+    expectSameAsAST("(x: x == (y: y)) (y: y)");
+    expectSameAsAST("(x: if !(x.a == 1) then 1 else 2) { }");
+    expectSameAsAST("(x: if x then 1 else 2) (throw \"lazy\")");
+}
+
+class ReuseEnvTest : public LibExprTest
+{
+public:
+    ReuseEnvTest()
+        : LibExprTest(openStore("dummy://"), [](bool & readOnlyMode) {
+            EvalSettings settings{readOnlyMode};
+            settings.nixPath = {};
+            settings.reuseEnvs = true;
+            return settings;
+        })
+    {
+    }
+
+    bool reusesEnv(const std::string & input)
+    {
+        auto e = dynamic_cast<ExprLambda *>(state.parseExprFromString(input, state.rootPath(".")));
+        EXPECT_NE(e, nullptr) << input;
+        return e && e->reuseEnv;
+    }
+};
+
+TEST_F(ReuseEnvTest, escapeAnalysis)
+{
+    ASSERT_TRUE(reusesEnv("x: if x then 1 else 2"));
+    ASSERT_TRUE(reusesEnv("{ x, y }: x.${y} or (x == y)"));
+    ASSERT_TRUE(reusesEnv("{ a, b ? 1 }: \"${a}-${toString b}\""));
+    ASSERT_TRUE(reusesEnv("x: builtins.hasAttr \"foo\" x || x ? bar"));
+
+    /* The inner lambda's closure refers to the outer Env. */
+    ASSERT_FALSE(reusesEnv("x: y: x"));
+    ASSERT_FALSE(reusesEnv("x: { inherit x; }"));
+    ASSERT_FALSE(reusesEnv("x: [ x ]"));
+    ASSERT_FALSE(reusesEnv("x: let y = x; in y"));
+    ASSERT_FALSE(reusesEnv("x: builtins.toString (x + 1)"));
+    ASSERT_FALSE(reusesEnv("{ a, b ? a }: b"));
+    ASSERT_FALSE(reusesEnv("x: with x; foo"));
+}
+
+TEST_F(ReuseEnvTest, repeatedCalls)
+{
+    auto v = eval(R"(
+      let
+        f = x: y: if x == y then x + y else y;
+        g = { a, b ? 1 }: a + b;
+        loop = n: acc: if n == 0 then acc else loop (n - 1) (acc + f n n + g { a = n; });
+      in
+        loop 10000 0
+    )");
+    ASSERT_THAT(v, IsIntEq(150025000));
+}
+
 } // namespace nix
@@ -0,0 +1,87 @@
+#include <benchmark/benchmark.h>
+
+#include "nix/expr/eval.hh"
+#include "nix/expr/eval-settings.hh"
+#include "nix/expr/json-to-value.hh"
+#include "nix/fetchers/fetch-settings.hh"
+#include "nix/store/store-open.hh"
+
+#include <nlohmann/json.hpp>
+
+namespace nix {
+
+/**
+ * Generate a document shaped like an npm `package-lock.json` (lockfile
+ * version 3), which is the kind of input that is commonly read with
+ * `importJSON`.
+ */
+static std::string mkPackageLock(size_t packageCount)
+{
+    std::string res;
+    res.reserve(packageCount * 400);
+    res += "{\n  \"name\": \"example\",\n  \"version\": \"1.0.0\",\n  \"lockfileVersion\": 3,\n";
+    res += "  \"requires\": true,\n  \"packages\": {\n";
+    res += "    \"\": {\n      \"name\": \"example\",\n      \"version\": \"1.0.0\"\n    }";
+    for (size_t i = 0; i < packageCount; ++i) {
+        auto name = "pkg-" + std::to_string(i);
+        auto version = fmt("%d.%d.%d", i % 7, i % 13, i % 29);
+        res += ",\n    \"node_modules/" + name + "\": {\n";
+        res += "      \"version\": \"" + version + "\",\n";
+        res += "      \"resolved\": \"https://registry.npmjs.org/" + name + "/-/" + name + "-" + version + ".tgz\",\n";
+        res += "      \"integrity\": \"sha512-" + std::string(86, 'A' + i % 26) + "==\",\n";
+        if (i % 3 == 0)
+            res += "      \"dev\": true,\n";
+        res += "      \"license\": \"MIT\",\n      \"dependencies\": {";
+        for (size_t j = 1; j <= i % 5; ++j)
+            res += fmt("%s\n        \"pkg-%d\": \"^%d.0.0\"", j == 1 ? "" : ",", (i + j * 31) % packageCount, j);
+        res += "\n      },\n      \"engines\": {\n        \"node\": \">=14\"\n      }\n    }";
+    }
+    res += "\n  }\n}\n";
+    return res;
+}
+
+static void BM_ParseJSONPackageLock(benchmark::State & state)
+{
+    const auto packageCount = static_cast<size_t>(state.range(0));
+    const auto doc = mkPackageLock(packageCount);
+
+    auto store = openStore("dummy://");
+    fetchers::Settings fetchSettings{};
+    bool readOnlyMode = true;
+    EvalSettings evalSettings{readOnlyMode};
+    evalSettings.nixPath = {};
+
+    auto stPtr = std::make_shared<EvalState>(LookupPath{}, store, fetchSettings, evalSettings, nullptr);
+    auto & st = *stPtr;
+
+    for (auto _ : state) {
+        Value v;
+        parseJSON(st, doc, v);
+        benchmark::DoNotOptimize(v);
+    }
+
+    state.SetBytesProcessed(state.iterations() * doc.size());
+}
+
+BENCHMARK(BM_ParseJSONPackageLock)->Arg(100)->Arg(2'000)->Arg(20'000);
+
+/**
+ * Baseline: parsing the same document into a nlohmann DOM, without
+ * creating any Nix values.
+ */
+static void BM_ParseJSONPackageLockNlohmann(benchmark::State & state)
+{
+    const auto packageCount = static_cast<size_t>(state.range(0));
+    const auto doc = mkPackageLock(packageCount);
+
+    for (auto _ : state) {
+        auto json = nlohmann::json::parse(doc);
+        benchmark::DoNotOptimize(json);
+    }
+
+    state.SetBytesProcessed(state.iterations() * doc.size());
+}
+
+BENCHMARK(BM_ParseJSONPackageLockNlohmann)->Arg(100)->Arg(2'000)->Arg(20'000);
+
+} // namespace nix
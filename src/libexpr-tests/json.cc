@@ -1,7 +1,11 @@
 #include "nix/expr/tests/libexpr.hh"
 #include "nix/expr/value-to-json.hh"
+#include "nix/expr/json-to-value.hh"
 #include "nix/expr/static-string-data.hh"
 
+#include <gmock/gmock.h>
+#include <nlohmann/json.hpp>
+
 namespace nix {
 // Testing the conversion to JSON
 
@@ -77,6 +81,65 @@ TEST_F(JSONValueTest, DISABLED_Path)
     ASSERT_EQ(getJSONValue(v), "\"/nix/store/g1w7hy3qg1w7hy3qg1w7hy3qg1w7hy3q-x\"");
 }
 
+TEST_F(JSONValueTest, StringEscapes)
+{
+    Value v;
+    v.mkStringNoCopy("a\\b\n\t\r\b\f\x01\x1f\x7f/\u00e9\u4e2d\U0001f600"_sds);
+    ASSERT_EQ(getJSONValue(v), "\"a\\\\b\\n\\t\\r\\b\\f\\u0001\\u001f\x7f/\u00e9\u4e2d\U0001f600\"");
+}
+
+TEST_F(JSONValueTest, MatchesTree)
+{
+    auto v = eval(R"({
+        b = [ 1 (-2) 3.5 1.0e100 0.1 true null "x" ];
+        a = { "z\"" = { }; y = [ ]; x = "${"long string with a \n newline " + builtins.concatStringsSep "," (builtins.genList toString 100)}"; };
+        "\u00e9" = 1;
+        "" = -9223372036854775807;
+    })");
+    NixStringContext context;
+    std::string out;
+    printValueAsJSON(state, true, v, noPos, out, context);
+    ASSERT_EQ(out, printValueAsJSON(state, true, v, noPos, context).dump());
+}
+
+TEST_F(JSONValueTest, InvalidUTF8)
+{
+    auto check = [&](std::string_view s, std::string_view message) {
+        Value v;
+        v.mkString(s, state.mem);
+        ASSERT_THAT(
+            [&]() { getJSONValue(v); },
+            ::testing::ThrowsMessage<JSONSerializationError>(::testing::HasSubstr(message)));
+    };
+    check("a\xff", "[json.exception.type_error.316] invalid UTF-8 byte at index 1: 0xFF");
+    check("\xc3(", "[json.exception.type_error.316] invalid UTF-8 byte at index 1: 0x28");
+    check("\xed\xa0\x80", "[json.exception.type_error.316] invalid UTF-8 byte at index 1: 0xA0");
+    check("ab\xe2\x82", "[json.exception.type_error.316] incomplete UTF-8 string; last byte: 0x82");
+}
+
+TEST_F(JSONValueTest, EvalErrorTakesPrecedence)
+{
+    /* The whole value used to be evaluated before it was serialised. */
+    auto v = eval("[ \"\xff\" (throw \"foo\") ]", false);
+    ASSERT_THROW(getJSONValue(v), ThrownError);
+}
+
+TEST_F(JSONValueTest, SinkGetsNothingOnError)
+{
+    /* Enough output that it would be worth writing some of it before
+       the error. */
+    auto v = eval(
+        "builtins.genList (i: if i == 100000 then throw \"foo\" else \"element ${toString i}\") 100001", false);
+    NixStringContext context;
+    StringSink sink;
+    ASSERT_THROW(printValueAsJSON(state, true, v, noPos, sink, context), ThrownError);
+    ASSERT_EQ(sink.s, "");
+
+    v = eval("builtins.genList (i: if i == 100000 then \"\xff\" else \"element ${toString i}\") 100001", false);
+    ASSERT_THROW(printValueAsJSON(state, true, v, noPos, sink, context), JSONSerializationError);
+    ASSERT_EQ(sink.s, "");
+}
+
 /* Fixture for JSONValueTest/ToStringAcceptsExternal */
 namespace {
 class MyExternal : public ExternalValueBase
@@ -122,4 +185,114 @@ TEST_F(JSONValueTest, ToStringAcceptsExternal)
 
     ASSERT_EQ(getJSONValue(vAttrs), "\"external-json\"");
 }
+
+// Testing the conversion from JSON
+
+class JSONToValueTest : public LibExprTest
+{
+protected:
+    Value parse(std::string_view s)
+    {
+        Value v;
+        parseJSON(state, s, v);
+        return v;
+    }
+
+    /**
+     * Round-trip through a Nix value, which should give the same
+     * result as parsing with nlohmann.
+     */
+    std::string roundTrip(std::string_view s)
+    {
+        auto v = parse(s);
+        NixStringContext context;
+        return printValueAsJSON(state, true, v, noPos, context).dump();
+    }
+};
+
+TEST_F(JSONToValueTest, MatchesNlohmann)
+{
+    for (std::string_view s : {
+             "null",
+             " true ",
+             "\xef\xbb\xbf[false]",
+             "[1, -2, 0, -0, 3.5, -0.0, 1e3, 1E-2, 1e-400, 0.1]",
+             "[9223372036854775807, -9223372036854775808, -9223372036854775809, 123456789012345678901234567890]",
+             "\"\"",
+             "\"a\\\"b\\\\c\\/d\\b\\f\\n\\r\\t\\u0041\\u00e9\\u4e2d\\ud83d\\ude00\"",
+             "\"\xc3\xa9\xe4\xb8\xad\xf0\x9f\x98\x80 a rather long string that spans several SIMD blocks\"",
+             "{}",
+             "[]",
+             "[[], {}, [[]], {\"\": {}}]",
+             "{\"b\": [1, {\"c\": null}], \"a\": \"x\", \"\": 1}",
+             "\r\n\t{ \"x\" : [ 1 , 2 ] , \"y\" : { } }\n",
+         }) {
+        SCOPED_TRACE(s);
+        ASSERT_EQ(roundTrip(s), nlohmann::json::parse(s).dump());
+    }
+}
+
+TEST_F(JSONToValueTest, DuplicateKeys)
+{
+    auto v = parse(R"({"a": 1, "b": 2, "a": 3})");
+    ASSERT_THAT(v, IsAttrsOfSize(2));
+    ASSERT_THAT(*v.attrs()->get(createSymbol("a"))->value, IsIntEq(3));
+    ASSERT_THAT(*v.attrs()->get(createSymbol("b"))->value, IsIntEq(2));
+}
+
+TEST_F(JSONToValueTest, DeepNesting)
+{
+    size_t depth = 100000;
+    auto v = parse(std::string(depth, '[') + std::string(depth, ']'));
+    ASSERT_THAT(v, IsListOfSize(1));
+}
+
+TEST_F(JSONToValueTest, ErrorMessages)
+{
+    for (std::string_view s : {
+             "",
+             "[1,]",
+             "{\"a\" 1}",
+             "{1: 2}",
+             "[1 2]",
+             "01",
+             "1.",
+             "-",
+             "1e400",
+             "tru",
+             "nullx",
+             "[1]]",
+             "\"abc",
+             "\"a\x01\"",
+             "\"\\x\"",
+             "\"\\u12\"",
+             "\"\\ud83d\"",
+             "\"\\ude00\"",
+             "\"\xc3(\"",
+             "\"\xed\xa0\x80\"",
+             "\"\xff\"",
+         }) {
+        SCOPED_TRACE(s);
+        std::string expected;
+        try {
+            std::ignore = nlohmann::json::parse(s);
+        } catch (nlohmann::json::exception & e) {
+            expected = e.what();
+        }
+        ASSERT_FALSE(expected.empty());
+        ASSERT_THAT([&]() { parse(s); }, ::testing::ThrowsMessage<JSONParseError>(::testing::HasSubstr(expected)));
+    }
+}
+
+TEST_F(JSONToValueTest, NotRepresentable)
+{
+    ASSERT_THAT(
+        [&]() { parse(R"({"a\u0000b": 1})"); },
+        ::testing::ThrowsMessage<Error>(::testing::HasSubstr("contains null bytes")));
+    ASSERT_THAT(
+        [&]() { parse("[9223372036854775808]"); },
+        ::testing::ThrowsMessage<Error>(
+            ::testing::HasSubstr("unsigned json number 9223372036854775808 outside of Nix integer range")));
+}
+
 } /* namespace nix */
@@ -0,0 +1,69 @@
+#include <benchmark/benchmark.h>
+
+#include "nix/expr/eval.hh"
+#include "nix/expr/eval-settings.hh"
+#include "nix/fetchers/fetch-settings.hh"
+#include "nix/store/store-open.hh"
+
+namespace nix {
+
+static void runListConcatBenchmark(benchmark::State & state, std::string_view body)
+{
+    const auto n = static_cast<size_t>(state.range(0));
+    const auto exprStr = fmt("let n = %d; in builtins.length (%s)", n, body);
+
+    for (auto _ : state) {
+        state.PauseTiming();
+
+        auto store = openStore("dummy://");
+        fetchers::Settings fetchSettings{};
+        bool readOnlyMode = true;
+        EvalSettings evalSettings{readOnlyMode};
+        evalSettings.nixPath = {};
+
+        auto stPtr = std::make_shared<EvalState>(LookupPath{}, store, fetchSettings, evalSettings, nullptr);
+        auto & st = *stPtr;
+        Expr * expr = st.parseExprFromString(exprStr, st.rootPath(CanonPath::root));
+
+        Value v;
+
+        state.ResumeTiming();
+
+        st.eval(expr, v);
+        st.forceValue(v, noPos);
+        benchmark::DoNotOptimize(v);
+    }
+
+    state.SetItemsProcessed(state.iterations() * n);
+}
+
+/**
+ * The common `foldl' (acc: x: acc ++ [ x ])` idiom.
+ */
+static void BM_EvalListAppendFold(benchmark::State & state)
+{
+    runListConcatBenchmark(state, "builtins.foldl' (acc: x: acc ++ [ x ]) [ ] (builtins.genList (x: x) n)");
+}
+
+BENCHMARK(BM_EvalListAppendFold)->Arg(1'000)->Arg(10'000)->Arg(50'000);
+
+static void BM_EvalListPrependFold(benchmark::State & state)
+{
+    runListConcatBenchmark(state, "builtins.foldl' (acc: x: [ x ] ++ acc) [ ] (builtins.genList (x: x) n)");
+}
+
+BENCHMARK(BM_EvalListPrependFold)->Arg(1'000)->Arg(10'000)->Arg(50'000);
+
+/**
+ * Appending lists of several elements, as done when merging module
+ * option definitions.
+ */
+static void BM_EvalListAppendChunksFold(benchmark::State & state)
+{
+    runListConcatBenchmark(
+        state, "builtins.foldl' (acc: x: acc ++ [ x x x x ]) [ ] (builtins.genList (x: x) (n / 4))");
+}
+
+BENCHMARK(BM_EvalListAppendChunksFold)->Arg(1'000)->Arg(10'000)->Arg(50'000);
+
+} // namespace nix
@@ -0,0 +1,65 @@
+#include <benchmark/benchmark.h>
+
+#include "nix/expr/eval.hh"
+#include "nix/expr/eval-settings.hh"
+#include "nix/fetchers/fetch-settings.hh"
+#include "nix/store/store-open.hh"
+
+namespace nix {
+
+static void runStringConcatBenchmark(benchmark::State & state, std::string_view body)
+{
+    const auto n = static_cast<size_t>(state.range(0));
+    const auto exprStr = fmt("let n = %d; in builtins.stringLength (%s)", n, body);
+
+    for (auto _ : state) {
+        state.PauseTiming();
+
+        auto store = openStore("dummy://");
+        fetchers::Settings fetchSettings{};
+        bool readOnlyMode = true;
+        EvalSettings evalSettings{readOnlyMode};
+        evalSettings.nixPath = {};
+
+        auto stPtr = std::make_shared<EvalState>(LookupPath{}, store, fetchSettings, evalSettings, nullptr);
+        auto & st = *stPtr;
+        Expr * expr = st.parseExprFromString(exprStr, st.rootPath(CanonPath::root));
+
+        Value v;
+
+        state.ResumeTiming();
+
+        st.eval(expr, v);
+        st.forceValue(v, noPos);
+        benchmark::DoNotOptimize(v);
+    }
+
+    state.SetItemsProcessed(state.iterations() * n);
+}
+
+/**
+ * Building a script line by line, as done by e.g. activation scripts.
+ */
+static void BM_EvalStringAppendFold(benchmark::State & state)
+{
+    runStringConcatBenchmark(
+        state, "builtins.foldl' (acc: x: acc + \"echo line ${toString x}\\n\") \"\" (builtins.genList (x: x) n)");
+}
+
+BENCHMARK(BM_EvalStringAppendFold)->Arg(1'000)->Arg(10'000)->Arg(50'000);
+
+/**
+ * Joining sections that were themselves joined, as done when
+ * generating configuration files from module options.
+ */
+static void BM_EvalStringNestedJoin(benchmark::State & state)
+{
+    runStringConcatBenchmark(
+        state,
+        "builtins.foldl' (acc: x: builtins.concatStringsSep \"\\n\" [ acc (builtins.concatStringsSep \" \" "
+        "(builtins.genList toString 10)) ]) \"\" (builtins.genList (x: x) (n / 10))");
+}
+
+BENCHMARK(BM_EvalStringNestedJoin)->Arg(1'000)->Arg(10'000)->Arg(50'000);
+
+} // namespace nix
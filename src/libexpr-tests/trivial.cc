@@ -97,6 +97,41 @@ TEST_F(TrivialExpressionTest, hasAttrOpTrue)
     ASSERT_THAT(v, IsTrue());
 }
 
+TEST_F(TrivialExpressionTest, selectPolymorphic)
+{
+    /* The same select and has-attr sites see attribute sets of
+       different shapes, including layered ones where the attribute is
+       in the base layer or overridden by the top layer. */
+    auto v = eval(R"(
+        let
+          sets = [
+            { a = 1; b = 2; }
+            { b = 3; c = 4; }
+            ({ b = 5; } // { a = 6; })
+            ({ a = 0; b = 7; } // { b = 8; })
+            { x = 1; }
+          ];
+          get = s: s.b or null;
+          has = s: s ? b;
+        in
+          map get sets ++ map get sets ++ map has sets
+          == [ 2 3 5 8 null 2 3 5 8 null true true true true false ]
+    )");
+    ASSERT_THAT(v, IsTrue());
+}
+
+TEST_F(TrivialExpressionTest, selectLookupCacheHits)
+{
+    auto enabled = Counter::enabled;
+    Counter::enabled = true;
+    auto hits = AttrLookupCache::nrHits.load();
+    auto v = eval(
+        "let s = { a = 1; b = 2; c = 3; }; in builtins.foldl' (acc: x: acc + x.b) 0 (builtins.genList (_: s) 10)");
+    Counter::enabled = enabled;
+    ASSERT_THAT(v, IsIntEq(20));
+    ASSERT_GE(AttrLookupCache::nrHits.load() - hits, 9u);
+}
+
 TEST_F(TrivialExpressionTest, withFound)
 {
     auto v = eval("with { a = 23; }; a");
@@ -355,4 +390,98 @@ TEST_F(TrivialExpressionTest, tooManyFormals)
             "too many formal arguments, implementation supports at most 65535")));
 }
 
+TEST_F(TrivialExpressionTest, repeatedListConcat)
+{
+    auto v = eval("builtins.foldl' (acc: x: acc ++ [ x ]) [ ] (builtins.genList (x: x) 10000)");
+    ASSERT_THAT(v, IsListOfSize(10000));
+    auto listView = v.listView();
+    for (const auto [n, elem] : enumerate(listView)) {
+        state.forceValue(*elem, noPos);
+        ASSERT_THAT(*elem, IsIntEq(NixInt::Inner(n)));
+    }
+}
+
+TEST_F(TrivialExpressionTest, nestedListConcat)
+{
+    /* Mix prepending and appending, with operands that are themselves
+       unflattened concatenations, some of which have been flattened
+       by `elemAt` in the meantime. */
+    auto v = eval(R"(
+        let
+          xs = builtins.genList (x: x) 40;
+          ys = builtins.genList (x: x + 40) 40;
+          a = xs ++ ys;
+          b = [ (-1) ] ++ a;
+          c = b ++ (a ++ [ 80 ]);
+        in
+          builtins.seq (builtins.elemAt b 3) [
+            (builtins.length c)
+            (builtins.elemAt c 0)
+            (builtins.elemAt c 80)
+            (builtins.elemAt c 81)
+            (builtins.elemAt c 161)
+            (c == [ (-1) ] ++ xs ++ ys ++ xs ++ ys ++ [ 80 ])
+          ]
+    )");
+    state.forceValueDeep(v);
+    auto listView = v.listView();
+    ASSERT_THAT(*listView[0], IsIntEq(162));
+    ASSERT_THAT(*listView[1], IsIntEq(-1));
+    ASSERT_THAT(*listView[2], IsIntEq(79));
+    ASSERT_THAT(*listView[3], IsIntEq(0));
+    ASSERT_THAT(*listView[4], IsIntEq(80));
+    ASSERT_THAT(*listView[5], IsTrue());
+}
+
+TEST_F(TrivialExpressionTest, repeatedStringConcat)
+{
+    auto v = eval(R"(
+        let
+          s = builtins.foldl' (acc: x: acc + "${toString x},") "" (builtins.genList (x: x) 5000);
+        in
+          [
+            (builtins.stringLength s)
+            (builtins.substring 0 8 s)
+            (builtins.substring (builtins.stringLength s - 10) 10 s)
+            (s == builtins.concatStringsSep "" (builtins.genList (x: "${toString x},") 5000))
+          ]
+    )");
+    state.forceValueDeep(v);
+    auto listView = v.listView();
+    ASSERT_THAT(*listView[0], IsIntEq(23890));
+    ASSERT_THAT(*listView[1], IsStringEq("0,1,2,3,"));
+    ASSERT_THAT(*listView[2], IsStringEq("4998,4999,"));
+    ASSERT_THAT(*listView[3], IsTrue());
+}
+
+TEST_F(TrivialExpressionTest, stringConcatContext)
+{
+    /* The contexts of the parts of a large concatenation are only
+       merged when it is flattened. */
+    auto v = eval(R"(
+        let
+          big = builtins.concatStringsSep "
+" (builtins.genList toString 1000);
+          a = builtins.appendContext "a" { "/nix/store/aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa-a" = { path = true; }; };
+          b = builtins.appendContext "b" { "/nix/store/bbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbb-b" = { path = true; }; };
+          s1 = big + a;
+          s2 = "${s1}${big}${b}";
+        in
+          [
+            (builtins.attrNames (builtins.getContext s1))
+            (builtins.attrNames (builtins.getContext s2))
+            (builtins.getContext big)
+            (builtins.stringLength s2)
+          ]
+    )");
+    state.forceValueDeep(v);
+    auto listView = v.listView();
+    ASSERT_THAT(*listView[0], IsListOfSize(1));
+    ASSERT_THAT(*listView[1], IsListOfSize(2));
+    ASSERT_THAT(*listView[1]->listView()[0], IsStringEq("/nix/store/aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa-a"));
+    ASSERT_THAT(*listView[1]->listView()[1], IsStringEq("/nix/store/bbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbb-b"));
+    ASSERT_THAT(*listView[2], IsAttrsOfSize(0));
+    ASSERT_THAT(*listView[3], IsIntEq(2 * 3889 + 2));
+}
+
 } /* namespace nix */
@@ -0,0 +1,270 @@
+#include "nix/expr/bytecode.hh"
+#include "nix/expr/eval.hh"
+#include "nix/expr/eval-inline.hh"
+#include "nix/expr/gc-small-vector.hh"
+#include "nix/expr/print.hh"
+
+namespace nix {
+
+namespace {
+
+using Op = Bytecode::Op;
+using Instr = Bytecode::Instr;
+
+struct Compiler
+{
+    std::vector<Instr> code;
+    std::vector<Bytecode::TraceRegion> traceRegions;
+    uint32_t depth = 0, maxStack = 0;
+
+    /**
+     * Whether any subexpression was compiled, rather than evaluated
+     * by the AST interpreter.
+     */
+    bool compiledAny = false;
+
+    uint32_t emit(Instr instr, int stackEffect)
+    {
+        depth += stackEffect;
+        maxStack = std::max(maxStack, depth);
+        code.push_back(instr);
+        return code.size() - 1;
+    }
+
+    void patch(uint32_t jump)
+    {
+        code[jump].target = code.size();
+    }
+
+    /**
+     * Compile `e` as the argument of `EvalState::evalBool()`.
+     */
+    void compileBool(Expr * e, PosIdx pos, std::string_view errorCtx)
+    {
+        uint32_t begin = code.size();
+        compile(e);
+        emit({.op = Op::CheckBool, .pos = pos, .expr = e}, 0);
+        traceRegions.push_back({.begin = begin, .end = (uint32_t) code.size(), .pos = pos, .errorCtx = errorCtx});
+    }
+
+    void compileShortCircuit(
+        Expr * e1,
+        Expr * e2,
+        PosIdx pos,
+        bool negateLeft,
+        Op jump,
+        std::string_view leftErrorCtx,
+        std::string_view rightErrorCtx)
+    {
+        compileBool(e1, pos, leftErrorCtx);
+        if (negateLeft)
+            emit({.op = Op::Not}, 0);
+        auto j = emit({.op = jump}, -1);
+        compileBool(e2, pos, rightErrorCtx);
+        patch(j);
+    }
+
+    void compile(Expr * e)
+    {
+        if (auto e2 = dynamic_cast<ExprInt *>(e))
+            emit({.op = Op::Const, .constant = &e2->v}, 1);
+
+        else if (auto e2 = dynamic_cast<ExprFloat *>(e))
+            emit({.op = Op::Const, .constant = &e2->v}, 1);
+
+        else if (auto e2 = dynamic_cast<ExprString *>(e))
+            emit({.op = Op::Const, .constant = &e2->v}, 1);
+
+        else if (auto e2 = dynamic_cast<ExprVar *>(e); e2 && !e2->fromWith)
+            emit({.op = Op::Var, .pos = e2->pos, .level = e2->level, .displ = e2->displ}, 1);
+
+        else if (auto e2 = dynamic_cast<ExprIf *>(e)) {
+            compileBool(e2->cond, e2->pos, "while evaluating a branch condition");
+            auto jumpElse = emit({.op = Op::JumpIfFalse}, -1);
+            compile(e2->then);
+            auto jumpEnd = emit({.op = Op::Jump}, -1);
+            patch(jumpElse);
+            compile(e2->else_);
+            patch(jumpEnd);
+        }
+
+        else if (auto e2 = dynamic_cast<ExprOpNot *>(e)) {
+            compileBool(e2->e, e2->getPos(), "in the argument of the not operator");
+            emit({.op = Op::Not}, 0);
+        }
+
+        else if (auto e2 = dynamic_cast<ExprOpAnd *>(e))
+            compileShortCircuit(
+                e2->e1,
+                e2->e2,
+                e2->pos,
+                false,
+                Op::JumpIfFalseElsePop,
+                "in the left operand of the AND (&&) operator",
+                "in the right operand of the AND (&&) operator");
+
+        else if (auto e2 = dynamic_cast<ExprOpOr *>(e))
+            compileShortCircuit(
+                e2->e1,
+                e2->e2,
+                e2->pos,
+                false,
+                Op::JumpIfTrueElsePop,
+                "in the left operand of the OR (||) operator",
+                "in the right operand of the OR (||) operator");
+
+        else if (auto e2 = dynamic_cast<ExprOpImpl *>(e))
+            compileShortCircuit(
+                e2->e1,
+                e2->e2,
+                e2->pos,
+                true,
+                Op::JumpIfTrueElsePop,
+                "in the left operand of the IMPL (->) operator",
+                "in the right operand of the IMPL (->) operator");
+
+        else if (auto e2 = dynamic_cast<ExprOpEq *>(e)) {
+            compile(e2->e1);
+            compile(e2->e2);
+            emit({.op = Op::Eq, .pos = e2->pos}, -1);
+        }
+
+        else if (auto e2 = dynamic_cast<ExprOpNEq *>(e)) {
+            compile(e2->e1);
+            compile(e2->e2);
+            emit({.op = Op::NEq, .pos = e2->pos}, -1);
+        }
+
+        else {
+            emit({.op = Op::Eval, .expr = e}, 1);
+            return;
+        }
+
+        compiledAny = true;
+    }
+};
+
+} // namespace
+
+const Bytecode * Bytecode::compile(EvalState & state, Expr & body)
+{
+    Compiler compiler;
+    compiler.compile(&body);
+    if (!compiler.compiledAny)
+        return nullptr;
+    compiler.emit({.op = Op::Return}, 0);
+    assert(compiler.depth == 1);
+
+    auto & alloc = state.mem.exprs.alloc;
+    auto code = alloc.allocate_object<Instr>(compiler.code.size());
+    std::uninitialized_copy(compiler.code.begin(), compiler.code.end(), code);
+    auto traceRegions = alloc.allocate_object<TraceRegion>(compiler.traceRegions.size());
+    std::uninitialized_copy(compiler.traceRegions.begin(), compiler.traceRegions.end(), traceRegions);
+
+    return alloc.new_object<Bytecode>(Bytecode{
+        .code = {code, compiler.code.size()},
+        .traceRegions = {traceRegions, compiler.traceRegions.size()},
+        .maxStack = compiler.maxStack,
+    });
+}
+
+void Bytecode::run(EvalState & state, Env & env, Value & v) const
+{
+    /* The stack holds temporaries that aren't reachable from anywhere
+       else, so it must be visible to the garbage collector. */
+    SmallTemporaryValueVector<8> stack(maxStack);
+    auto sp = stack.data();
+    auto pc = code.data();
+
+    try {
+        while (true) {
+            switch (pc->op) {
+
+            case Op::Const:
+                *sp++ = *pc->constant;
+                break;
+
+            case Op::Var: {
+                auto env2 = &env;
+                for (auto l = pc->level; l; --l)
+                    env2 = env2->up;
+                auto v2 = env2->values[pc->displ];
+                state.forceValue(*v2, pc->pos);
+                *sp++ = *v2;
+                break;
+            }
+
+            case Op::Eval:
+                pc->expr->eval(state, env, *sp++);
+                break;
+
+            case Op::CheckBool:
+                if (sp[-1].type() != nBool)
+                    state
+                        .error<TypeError>(
+                            "expected a Boolean but found %1%: %2%",
+                            showType(sp[-1]),
+                            ValuePrinter(state, sp[-1], errorPrintOptions))
+                        .atPos(pc->pos)
+                        .withFrame(env, *pc->expr)
+                        .debugThrow();
+                break;
+
+            case Op::Not:
+                sp[-1].mkBool(!sp[-1].boolean());
+                break;
+
+            case Op::Eq:
+                --sp;
+                sp[-1].mkBool(state.eqValues(sp[-1], sp[0], pc->pos, "while testing two values for equality"));
+                break;
+
+            case Op::NEq:
+                --sp;
+                sp[-1].mkBool(!state.eqValues(sp[-1], sp[0], pc->pos, "while testing two values for inequality"));
+                break;
+
+            case Op::Jump:
+                pc = code.data() + pc->target;
+                continue;
+
+            case Op::JumpIfFalse:
+                if (!(--sp)->boolean()) {
+                    pc = code.data() + pc->target;
+                    continue;
+                }
+                break;
+
+            case Op::JumpIfFalseElsePop:
+                if (!sp[-1].boolean()) {
+                    pc = code.data() + pc->target;
+                    continue;
+                }
+                --sp;
+                break;
+
+            case Op::JumpIfTrueElsePop:
+                if (sp[-1].boolean()) {
+                    pc = code.data() + pc->target;
+                    continue;
+                }
+                --sp;
+                break;
+
+            case Op::Return:
+                v = sp[-1];
+                return;
+            }
+
+            ++pc;
+        }
+    } catch (Error & e) {
+        uint32_t offset = pc - code.data();
+        for (auto & region : traceRegions)
+            if (offset >= region.begin && offset < region.end)
+                e.addTrace(state.positions[region.pos], region.errorCtx);
+        throw;
+    }
+}
+
+} // namespace nix
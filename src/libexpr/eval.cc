@@ -1,4 +1,5 @@
 #include "nix/expr/eval.hh"
+#include "nix/expr/bytecode.hh"
 #include "nix/expr/eval-error.hh"
 #include "nix/expr/eval-settings.hh"
 #include "nix/expr/primops.hh"
@@ -179,6 +180,7 @@ std::string showType(const Value & v)
 #pragma GCC diagnostic ignored "-Wswitch-enum"
     switch (v.getInternalType()) {
     case tString:
+    case tStringConcat:
         return v.context() ? "a string with context" : "a string";
     case tPrimOp:
         return fmt("the built-in function '%s'", std::string(v.primOp()->name));
@@ -969,6 +971,197 @@ ListBuilder::ListBuilder(EvalMemory & mem, size_t size)
 {
 }
 
+struct Value::ListConcat::Operands
+{
+    Value left, right;
+};
+
+void Value::mkListConcat(const Value & left, const Value & right, EvalMemory & mem)
+{
+    auto operands = new (mem.allocBytes(sizeof(ListConcat::Operands))) ListConcat::Operands{left, right};
+    setStorage(new (mem.allocBytes(sizeof(ListConcat))) ListConcat(left.listSize() + right.listSize(), operands));
+}
+
+Value * const * Value::flattenListConcat(ListConcat & concat)
+{
+    if (auto elems = concat.elems.load())
+        return elems;
+
+    auto operands = concat.operands.load();
+    if (!operands)
+        /* Another thread has flattened the list in the meantime. */
+        return concat.elems.load();
+
+    auto res = (Value **) EvalMemory::allocBytes(concat.size * sizeof(Value *));
+    auto out = res;
+
+    auto append = [&](Value * const * elems, size_t n) {
+        memcpy(out, elems, n * sizeof(Value *));
+        out += n;
+    };
+
+    /* Copy the elements of the operands from left to right. Chains
+       of concatenations can be very deep, so use an explicit stack.
+       It must be visible to the garbage collector, because other
+       threads may drop the operands of nested concatenations while
+       we're working on them. */
+    struct Pending
+    {
+        const ListConcat::Operands * operands;
+        bool right;
+    };
+
+    std::vector<Pending, traceable_allocator<Pending>> pending{{operands, true}, {operands, false}};
+
+    while (!pending.empty()) {
+        auto [operands, right] = pending.back();
+        pending.pop_back();
+        auto & v = right ? operands->right : operands->left;
+
+        if (v.isa<tListConcat>()) {
+            auto & nested = *v.getStorage<ListConcat *>();
+            if (auto nestedOperands = nested.operands.load()) {
+                pending.push_back({nestedOperands, true});
+                pending.push_back({nestedOperands, false});
+            } else
+                append(nested.elems.load(), nested.size);
+        } else {
+            auto listView = v.listView();
+            append(listView.data(), listView.size());
+        }
+    }
+
+    assert(out == res + concat.size);
+
+    Value * const * expected = nullptr;
+    if (!concat.elems.compare_exchange_strong(expected, res))
+        return expected;
+    concat.operands.store(nullptr);
+    return res;
+}
+
+struct Value::StringConcat::Operands
+{
+    EvalMemory * mem;
+
+    /**
+     * Context that doesn't come from `parts`, e.g. from coercing a
+     * derivation to a string.
+     */
+    const StringWithContext::Context * context;
+
+    size_t count;
+    Value parts[];
+
+    Operands(EvalMemory & mem, const StringWithContext::Context * context, size_t count)
+        : mem(&mem)
+        , context(context)
+        , count(count)
+    {
+    }
+};
+
+void Value::mkStringConcat(std::span<const Value> parts, const NixStringContext & context, EvalMemory & mem)
+{
+    size_t size = 0;
+    for (auto & part : parts)
+        size += part.stringSize();
+    auto operands = new (mem.allocBytes(sizeof(StringConcat::Operands) + parts.size() * sizeof(Value)))
+        StringConcat::Operands(mem, StringWithContext::Context::fromBuilder(context, mem), parts.size());
+    std::uninitialized_copy(parts.begin(), parts.end(), operands->parts);
+    setStorage(new (mem.allocBytes(sizeof(StringConcat))) StringConcat(size, operands));
+}
+
+const Value::StringWithContext & Value::flattenStringConcat(StringConcat & concat)
+{
+    if (auto flat = concat.flat.load())
+        return *flat;
+
+    auto operands = concat.operands.load();
+    if (!operands)
+        /* Another thread has flattened the string in the meantime. */
+        return *concat.flat.load();
+
+    auto & mem = *operands->mem;
+    auto & str = StringData::alloc(mem, concat.size);
+    auto out = str.data();
+
+    /* Usually at most one of the parts has a context, which we can
+       reuse as is. Only parse and merge contexts if there are several
+       different ones. */
+    const StringWithContext::Context * onlyContext = nullptr;
+    std::optional<NixStringContext> mergedContext;
+
+    auto addContext = [&](const StringWithContext::Context * ctx) {
+        if (!ctx || ctx == onlyContext)
+            return;
+        if (!onlyContext && !mergedContext) {
+            onlyContext = ctx;
+            return;
+        }
+        if (!mergedContext) {
+            mergedContext.emplace();
+            for (auto * elem : *onlyContext)
+                mergedContext->insert(NixStringContextElem::parse(elem->view()));
+        }
+        for (auto * elem : *ctx)
+            mergedContext->insert(NixStringContextElem::parse(elem->view()));
+    };
+
+    /* Copy the parts from left to right. Chains of concatenations can
+       be very deep, so use an explicit stack. It must be visible to
+       the garbage collector, because other threads may drop the
+       operands of nested concatenations while we're working on them. */
+    struct Pending
+    {
+        const StringConcat::Operands * operands;
+        size_t next;
+    };
+
+    std::vector<Pending, traceable_allocator<Pending>> pending{{operands, 0}};
+    addContext(operands->context);
+
+    while (!pending.empty()) {
+        auto & top = pending.back();
+        if (top.next == top.operands->count) {
+            pending.pop_back();
+            continue;
+        }
+        auto & v = top.operands->parts[top.next++];
+
+        StringWithContext part;
+        if (v.isa<tStringConcat>()) {
+            auto & nested = *v.getStorage<StringConcat *>();
+            if (auto nestedOperands = nested.operands.load()) {
+                /* Note: this invalidates `top`. */
+                pending.push_back({nestedOperands, 0});
+                addContext(nestedOperands->context);
+                continue;
+            }
+            part = *nested.flat.load();
+        } else
+            part = v.getStorage<StringWithContext>();
+
+        memcpy(out, part.str->data(), part.str->size());
+        out += part.str->size();
+        addContext(part.context);
+    }
+
+    assert(out == str.data() + concat.size);
+    *out = '\0';
+
+    auto flat = new (mem.allocBytes(sizeof(StringWithContext))) StringWithContext{
+        .str = &str,
+        .context = mergedContext ? StringWithContext::Context::fromBuilder(*mergedContext, mem) : onlyContext,
+    };
+
+    const StringWithContext * expected = nullptr;
+    if (!concat.flat.compare_exchange_strong(expected, flat))
+        return *expected;
+    concat.operands.store(nullptr);
+    return *flat;
+}
+
 Value * EvalState::getBool(bool b)
 {
     return b ? &Value::vTrue : &Value::vFalse;
@@ -1472,15 +1665,16 @@ void ExprSelect::eval(EvalState & state, Env & env, Value & v)
             state.nrLookups++;
             const Attr * j;
             auto name = getName(i, state, env);
+            auto & cache = lookupCaches[&i - attrPathStart];
             if (def) {
                 state.forceValue(*vAttrs, pos);
-                if (vAttrs->type() != nAttrs || !(j = vAttrs->attrs()->get(name))) {
+                if (vAttrs->type() != nAttrs || !(j = vAttrs->attrs()->get(name, cache))) {
                     def->eval(state, env, v);
                     return;
                 }
             } else {
                 state.forceAttrs(*vAttrs, pos, "while selecting an attribute");
-                if (!(j = vAttrs->attrs()->get(name))) {
+                if (!(j = vAttrs->attrs()->get(name, cache))) {
                     StringSet allAttrNames;
                     for (auto & attr : *vAttrs->attrs())
                         allAttrNames.insert(std::string(state.symbols[attr.name]));
@@ -1547,7 +1741,7 @@ void ExprOpHasAttr::eval(EvalState & state, Env & env, Value & v)
         state.forceValue(*vAttrs, getPos());
         const Attr * j;
         auto name = getName(i, state, env);
-        if (vAttrs->type() == nAttrs && (j = vAttrs->attrs()->get(name))) {
+        if (vAttrs->type() == nAttrs && (j = vAttrs->attrs()->get(name, lookupCaches[&i - attrPath.data()]))) {
             vAttrs = j->value;
         } else {
             v.mkBool(false);
@@ -1682,7 +1876,15 @@ void EvalState::callFunction(Value & fun, std::span<Value * const> args, Value &
                                      lambda.name ? concatStrings("'", symbols[lambda.name], "'") : "anonymous lambda")
                                : nullptr;
 
-                lambda.body->eval(*this, env2, vCur);
+                if (lambda.bytecode)
+                    lambda.bytecode->run(*this, env2, vCur);
+                else
+                    lambda.body->eval(*this, env2, vCur);
+
+                /* The debugger keeps references to the Envs of the
+                   frames it has seen. */
+                if (lambda.reuseEnv && !debugRepl)
+                    mem.reuseEnv(env2, size);
             } catch (Error & e) {
                 if (loggerSettings.showTrace.get()) {
                     addErrorTrace(
@@ -2089,6 +2291,13 @@ void ExprOpConcatLists::eval(EvalState & state, Env & env, Value & v)
     state.concatLists(v, lists, pos, "while evaluating one of the elements to concatenate");
 }
 
+/**
+ * The size from which `++` produces a `ListConcat` rather than copying
+ * the elements. Smaller lists are cheap to copy, and are cheaper to
+ * access if they're flat.
+ */
+static constexpr size_t minListConcatSize = 32;
+
 void EvalState::concatLists(Value & v, std::span<Value * const> lists, const PosIdx pos, std::string_view errorCtx)
 {
     nrListConcats++;
@@ -2108,6 +2317,13 @@ void EvalState::concatLists(Value & v, std::span<Value * const> lists, const Pos
         return;
     }
 
+    /* Don't copy the elements of `++` on large lists yet, so that
+       appending to a list repeatedly isn't quadratic. */
+    if (lists.size() == 2 && len >= minListConcatSize) {
+        v.mkListConcat(*lists[0], *lists[1], mem);
+        return;
+    }
+
     auto list = buildList(len);
     auto out = list.elems;
     size_t pos2 = 0;
@@ -2178,6 +2394,11 @@ void ExprConcatStrings::eval(EvalState & state, Env & env, Value & v)
                     .atPos(i_pos)
                     .withFrame(env, *this)
                     .debugThrow();
+        } else if (firstType == nString && vTmp.type() == nString) {
+            /* Don't look at the contents or the context of strings
+               yet, as they may be concatenations that we don't want to
+               flatten. */
+            sSize += vTmp.stringSize();
         } else {
             if (strings.empty())
                 strings.reserve(es.size());
@@ -2209,13 +2430,31 @@ void ExprConcatStrings::eval(EvalState & state, Env & env, Value & v)
             resultStr += *part;
         }
         v.mkPath(state.rootPath(CanonPath(resultStr)), state.mem);
+    } else if (firstType == nString && sSize >= Value::StringConcat::minSize) {
+        /* Coerced parts are small (e.g. store paths), so just copy them. */
+        auto coerced = strings.begin();
+        for (auto & part : values)
+            if (part.type() != nString)
+                part.mkString(**coerced++, state.mem);
+        v.mkStringConcat({values.data(), values.size()}, context, state.mem);
     } else {
         auto & resultStr = StringData::alloc(state.mem, sSize);
         auto * tmp = resultStr.data();
-        for (const auto & part : strings) {
-            std::memcpy(tmp, part->data(), part->size());
-            tmp += part->size();
-        }
+        auto append = [&](std::string_view part) {
+            std::memcpy(tmp, part.data(), part.size());
+            tmp += part.size();
+        };
+        if (firstType == nString) {
+            auto coerced = strings.begin();
+            for (auto & part : values)
+                if (part.type() == nString) {
+                    copyContext(part, context);
+                    append(part.string_view());
+                } else
+                    append(**coerced++);
+        } else
+            for (const auto & part : strings)
+                append(*part);
         *tmp = '\0';
         v.mkStringMove(resultStr, context, state.mem);
     }
@@ -3091,6 +3330,7 @@ void EvalState::printStatistics()
     };
     topObj["envs"] = {
         {"number", memstats.nrEnvs.load()},
+        {"reused", memstats.nrEnvsReused.load()},
         {"elements", memstats.nrValuesInEnvs.load()},
         {"bytes", bEnvs},
     };
@@ -3124,6 +3364,10 @@ void EvalState::printStatistics()
     topObj["nrThunks"] = nrThunks.load();
     topObj["nrAvoided"] = nrAvoided.load();
     topObj["nrLookups"] = nrLookups.load();
+    topObj["lookupCache"] = {
+        {"hits", AttrLookupCache::nrHits.load()},
+        {"misses", AttrLookupCache::nrMisses.load()},
+    };
     topObj["nrPrimOpCalls"] = nrPrimOpCalls.load();
     topObj["nrFunctionCalls"] = nrFunctionCalls.load();
 #if NIX_USE_BOEHMGC
@@ -376,6 +376,34 @@ public:
         return nullptr;
     }
 
+    /**
+     * Like `get(name)`, but first try the positions remembered by
+     * `cache`. An attribute called `name` at one of those positions in
+     * the top layer is the one `get(name)` would find, because the top
+     * layer takes precedence and names in a layer are unique.
+     */
+    const Attr * get(Symbol name, AttrLookupCache & cache) const noexcept
+    {
+        for (auto & position : cache.positions) {
+            auto i = position.load(std::memory_order_relaxed);
+            if (i < numAttrs && attrs[i].name == name) {
+                AttrLookupCache::nrHits++;
+                return &attrs[i];
+            }
+        }
+
+        AttrLookupCache::nrMisses++;
+
+        auto attr = get(name);
+        if (attr && attr >= attrs && attr < attrs + numAttrs) {
+            /* Keep the two most recent positions, so that sites that
+               alternate between two shapes keep hitting. */
+            cache.positions[1].store(cache.positions[0].load(std::memory_order_relaxed), std::memory_order_relaxed);
+            cache.positions[0].store(attr - attrs, std::memory_order_relaxed);
+        }
+        return attr;
+    }
+
     /**
      * Check if the layer chain is full.
      */
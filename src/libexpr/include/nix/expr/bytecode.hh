@@ -0,0 +1,124 @@
+#pragma once
+///@file
+
+#include "nix/expr/nixexpr.hh"
+
+namespace nix {
+
+/**
+ * The body of a function compiled to a linear sequence of
+ * instructions, which avoids the virtual `Expr::eval()` call per AST
+ * node and resolves variables to environment slots.
+ *
+ * Only conditionals, Boolean operators, equality tests, constants
+ * and variables are compiled. Other subexpressions are evaluated by
+ * calling `Expr::eval()` on the AST, so results and error traces are
+ * the same as those of the AST interpreter.
+ *
+ * Bytecode is allocated in the same arena as the AST (`Exprs`), and
+ * lives as long as it.
+ */
+struct Bytecode
+{
+    enum class Op : uint8_t {
+        /**
+         * Push the constant `constant`.
+         */
+        Const,
+
+        /**
+         * Push the forced value of the variable at `level`, `displ`.
+         */
+        Var,
+
+        /**
+         * Push the result of `expr->eval()`.
+         */
+        Eval,
+
+        /**
+         * Check that the top of the stack is a Boolean, as the result
+         * of `expr`.
+         */
+        CheckBool,
+
+        Not,
+
+        /**
+         * Replace the top two values by the result of comparing them.
+         */
+        Eq,
+        NEq,
+
+        Jump,
+
+        /**
+         * Pop a Boolean, and jump to `target` if it is false.
+         */
+        JumpIfFalse,
+
+        /**
+         * Jump to `target` if the Boolean at the top of the stack is
+         * false (true), otherwise pop it.
+         */
+        JumpIfFalseElsePop,
+        JumpIfTrueElsePop,
+
+        /**
+         * Stop and return the top of the stack.
+         */
+        Return,
+    };
+
+    struct Instr
+    {
+        Op op;
+        PosIdx pos;
+
+        union
+        {
+            uint32_t target;
+            Level level;
+        };
+
+        Displacement displ = 0;
+
+        union
+        {
+            Expr * expr = nullptr;
+            const Value * constant;
+        };
+    };
+
+    /**
+     * Errors thrown by the instructions in `[begin, end)` get a trace
+     * `errorCtx` at `pos`, like the `try` blocks of the AST
+     * interpreter. Nested regions come before the regions enclosing
+     * them.
+     */
+    struct TraceRegion
+    {
+        uint32_t begin, end;
+        PosIdx pos;
+        std::string_view errorCtx;
+    };
+
+    std::span<const Instr> code;
+    std::span<const TraceRegion> traceRegions;
+
+    /**
+     * The maximum number of values on the stack.
+     */
+    uint32_t maxStack;
+
+    /**
+     * Compile `body`, which must have been bound already. Returns
+     * `nullptr` if there is nothing to be gained from compiling it,
+     * i.e. if it would just call `body->eval()`.
+     */
+    static const Bytecode * compile(EvalState & state, Expr & body);
+
+    void run(EvalState & state, Env & env, Value & v) const;
+};
+
+} // namespace nix
@@ -58,6 +58,25 @@ Value * EvalMemory::allocValue()
     return (Value *) p;
 }
 
+#if NIX_USE_BOEHMGC
+/**
+ * Allocation caches for Env objects of sizes 1 to `maxCachedEnvSize`,
+ * linked through their first word like the lists returned by
+ * GC_malloc_many. Boehm GC is already a global resource, so
+ * thread_local is a natural solution. Multiple EvalState instances on
+ * the same thread will reuse the same caches.
+ */
+static constexpr size_t maxCachedEnvSize = 8;
+
+[[gnu::always_inline]]
+inline void *& envAllocCache(size_t size)
+{
+    using Caches = std::array<void *, maxCachedEnvSize + 1>;
+    static thread_local std::shared_ptr<Caches> caches{std::allocate_shared<Caches>(traceable_allocator<Caches>())};
+    return (*caches)[size];
+}
+#endif
+
 [[gnu::always_inline]]
 Env & EvalMemory::allocEnv(size_t size)
 {
@@ -67,31 +86,44 @@ Env & EvalMemory::allocEnv(size_t size)
     Env * env;
 
 #if NIX_USE_BOEHMGC
-    if (size == 1) {
-        /* Allocation cache for size-1 Env objects. Boehm GC is already a global resource, so thread_local is
-           a natural solution. Multiple EvalState instances on the same thread will reuse the same cache. */
-        static thread_local std::shared_ptr<void *> env1AllocCache{
-            std::allocate_shared<void *>(traceable_allocator<void *>(), nullptr)};
-        /* see allocValue for explanations. */
-        if (!*env1AllocCache) {
-            *env1AllocCache = GC_malloc_many(sizeof(Env) + sizeof(Value *));
-            if (!*env1AllocCache)
+    if (size >= 1 && size <= maxCachedEnvSize) {
+        auto & cache = envAllocCache(size);
+        /* Size-1 Envs are the most common by far, so allocate them in
+           batches. Larger ones are only cached when they're reused. */
+        if (!cache && size == 1) {
+            cache = GC_malloc_many(sizeof(Env) + sizeof(Value *));
+            if (!cache)
                 throw std::bad_alloc();
         }
-
-        void * p = *env1AllocCache;
-        *env1AllocCache = GC_NEXT(p);
-        GC_NEXT(p) = nullptr;
-        env = (Env *) p;
-    } else
+        /* see allocValue for explanations. */
+        if (void * p = cache) {
+            cache = GC_NEXT(p);
+            GC_NEXT(p) = nullptr;
+            return *(Env *) p;
+        }
+    }
 #endif
-        env = (Env *) allocBytes(sizeof(Env) + size * sizeof(Value *));
+    env = (Env *) allocBytes(sizeof(Env) + size * sizeof(Value *));
 
     /* We assume that env->values has been cleared by the allocator; maybeThunk() and lookupVar fromWith expect this. */
 
     return *env;
 }
 
+[[gnu::always_inline]]
+void EvalMemory::reuseEnv(Env & env, size_t size)
+{
+#if NIX_USE_BOEHMGC
+    if (size < 1 || size > maxCachedEnvSize)
+        return;
+    std::fill_n(env.values, size, nullptr);
+    auto & cache = envAllocCache(size);
+    GC_NEXT(&env) = cache;
+    cache = &env;
+    stats.nrEnvsReused++;
+#endif
+}
+
 [[gnu::always_inline]]
 void EvalState::forceValue(Value & v, const PosIdx pos)
 {
@@ -329,6 +329,34 @@ public:
     Setting<unsigned int> maxCallDepth{
         this, 10000, "max-call-depth", "The maximum function call depth to allow before erroring."};
 
+    Setting<bool> reuseEnvs{
+        this,
+        false,
+        "eval-reuse-envs",
+        R"(
+          If set to true, the environment of a function call is reused for later calls
+          as soon as the call returns, rather than left for the garbage collector,
+          if the body of the function cannot capture it in a closure or a lazily evaluated value.
+          This reduces the rate at which the heap grows, and thus the number of garbage collections.
+
+          This applies to functions whose body consists only of conditionals, operators,
+          attribute selections, string interpolations and calls whose arguments are constants
+          or arguments of the function itself.
+        )"};
+
+    Setting<bool> evalBytecode{
+        this,
+        false,
+        "eval-bytecode",
+        R"(
+          If set to true, compile the bodies of functions to bytecode when they are parsed,
+          and run the bytecode when the function is called.
+
+          Only conditionals, Boolean operators, equality tests, constants and variables are compiled;
+          everything else is still evaluated by walking the syntax tree.
+          The result of evaluation and error traces are the same as without this setting.
+        )"};
+
     Setting<bool> builtinsTraceDebugger{
         this,
         false,
@@ -349,6 +349,7 @@ public:
     struct Statistics
     {
         Counter nrEnvs;
+        Counter nrEnvsReused;
         Counter nrValuesInEnvs;
         Counter nrValues;
         Counter nrAttrsets;
@@ -363,10 +364,17 @@ public:
     EvalMemory & operator=(const EvalMemory &) = delete;
     EvalMemory & operator=(EvalMemory &&) = delete;
 
-    inline void * allocBytes(size_t n);
+    static inline void * allocBytes(size_t n);
     inline Value * allocValue();
     inline Env & allocEnv(size_t size);
 
+    /**
+     * Make `env`, which has `size` values, available to `allocEnv()`
+     * again. The caller must guarantee that nothing refers to it
+     * anymore.
+     */
+    inline void reuseEnv(Env & env, size_t size);
+
     Bindings * allocBindings(size_t capacity);
 
     BindingsBuilder buildBindings(SymbolTable & symbols, size_t capacity)
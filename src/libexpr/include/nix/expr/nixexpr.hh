@@ -1,6 +1,8 @@
 #pragma once
 ///@file
 
+#include <array>
+#include <atomic>
 #include <map>
 #include <span>
 #include <memory>
@@ -23,6 +25,7 @@ namespace nix {
 
 class EvalState;
 class PosTable;
+struct Bytecode;
 struct Env;
 struct ExprWith;
 struct StaticEnv;
@@ -92,6 +95,21 @@ typedef std::vector<AttrName> AttrSelectionPath;
 
 std::string showAttrSelectionPath(const SymbolTable & symbols, std::span<const AttrName> attrPath);
 
+/**
+ * An inline cache for looking up an attribute at one `a.b` or `a ? b`
+ * site. Most sites see attribute sets of the same shape over and over,
+ * so it remembers the last positions in the top layer of `Bindings`
+ * at which the attribute was found. Positions are checked before use
+ * (see `Bindings::get(Symbol, AttrLookupCache &)`), so the cache is
+ * valid for any attribute set, and doesn't keep any alive.
+ */
+struct AttrLookupCache
+{
+    std::array<std::atomic<uint32_t>, 2> positions{};
+
+    static Counter nrHits, nrMisses;
+};
+
 using UpdateQueue = SmallTemporaryValueVector<conservativeStackReservation>;
 
 /* Abstract syntax of Nix expressions. */
@@ -286,6 +304,11 @@ struct ExprSelect : Expr
     Expr *e, *def;
     AttrName * attrPathStart;
 
+    /**
+     * One cache per element of the attribute path.
+     */
+    AttrLookupCache * lookupCaches;
+
     ExprSelect(
         std::pmr::polymorphic_allocator<char> & alloc,
         const PosIdx & pos,
@@ -297,8 +320,10 @@ struct ExprSelect : Expr
         , e(e)
         , def(def)
         , attrPathStart(alloc.allocate_object<AttrName>(nAttrPath))
+        , lookupCaches(alloc.allocate_object<AttrLookupCache>(nAttrPath))
     {
         std::ranges::copy(attrPath, attrPathStart);
+        std::uninitialized_value_construct_n(lookupCaches, nAttrPath);
     };
 
     ExprSelect(std::pmr::polymorphic_allocator<char> & alloc, const PosIdx & pos, Expr * e, Symbol name)
@@ -307,6 +332,7 @@ struct ExprSelect : Expr
         , e(e)
         , def(0)
         , attrPathStart((alloc.allocate_object<AttrName>()))
+        , lookupCaches(alloc.new_object<AttrLookupCache>())
     {
         *attrPathStart = AttrName(name);
     };
@@ -342,12 +368,15 @@ struct ExprOpHasAttr : Expr
 {
     Expr * e;
     std::span<AttrName> attrPath;
+    AttrLookupCache * lookupCaches;
 
     ExprOpHasAttr(std::pmr::polymorphic_allocator<char> & alloc, Expr * e, std::span<AttrName> attrPath)
         : e(e)
         , attrPath({alloc.allocate_object<AttrName>(attrPath.size()), attrPath.size()})
+        , lookupCaches(alloc.allocate_object<AttrLookupCache>(attrPath.size()))
     {
         std::ranges::copy(attrPath, this->attrPath.begin());
+        std::uninitialized_value_construct_n(lookupCaches, attrPath.size());
     };
 
     PosIdx getPos() const override
@@ -539,6 +568,19 @@ public:
     Expr * body;
     DocComment docComment;
 
+    /**
+     * `body` compiled to bytecode, if `eval-bytecode` is enabled.
+     */
+    const Bytecode * bytecode = nullptr;
+
+    /**
+     * Whether the `Env` of a call to this function can be reused as
+     * soon as the call returns, because evaluating the body cannot
+     * capture it in a thunk or a closure. Only set if
+     * `eval-reuse-envs` is enabled.
+     */
+    bool reuseEnv = false;
+
     ExprLambda(
         const PosTable & positions,
         std::pmr::polymorphic_allocator<char> & alloc,
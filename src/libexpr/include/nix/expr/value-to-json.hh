@@ -13,6 +13,33 @@ namespace nix {
 nlohmann::json printValueAsJSON(
     EvalState & state, bool strict, Value & v, const PosIdx pos, NixStringContext & context, bool copyToStore = true);
 
+/**
+ * Serialise a value as compact JSON, appending it to `out`. Unlike the
+ * variant above, this doesn't build an intermediate `nlohmann::json`
+ * tree, but produces the same output.
+ */
+void printValueAsJSON(
+    EvalState & state,
+    bool strict,
+    Value & v,
+    const PosIdx pos,
+    std::string & out,
+    NixStringContext & context,
+    bool copyToStore = true);
+
+/**
+ * Like the above, but write the JSON to `sink`. Nothing is written if
+ * serialisation fails, e.g. because a part of the value throws.
+ */
+void printValueAsJSON(
+    EvalState & state,
+    bool strict,
+    Value & v,
+    const PosIdx pos,
+    Sink & sink,
+    NixStringContext & context,
+    bool copyToStore = true);
+
 void printValueAsJSON(
     EvalState & state,
     bool strict,
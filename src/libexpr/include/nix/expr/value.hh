@@ -1,6 +1,7 @@
 #pragma once
 ///@file
 
+#include <atomic>
 #include <bit>
 #include <cassert>
 #include <cstddef>
@@ -51,6 +52,8 @@ enum InternalType {
     tExternal,
     tPrimOp,
     tAttrs,
+    tListConcat,
+    tStringConcat,
     /* layout: Pair of pointers payload */
     tFirstPairOfPointers,
     tListSmall = tFirstPairOfPointers,
@@ -388,6 +391,48 @@ struct ValueBase
         const Context * context;
     };
 
+    /**
+     * The concatenation of strings that hasn't been materialised yet.
+     * String interpolation and `+` produce these for large strings, so
+     * that building a large string incrementally (e.g. a script or a
+     * configuration file) doesn't copy the accumulated prefix every
+     * time.
+     *
+     * The string and its context are computed the first time they're
+     * needed, after which the operands are dropped so they can be
+     * garbage-collected.
+     */
+    struct StringConcat
+    {
+        struct Operands;
+
+        /**
+         * The size from which concatenations produce a `StringConcat`
+         * rather than copying the strings. Smaller strings are cheap
+         * to copy, and are cheaper to access if they're flat.
+         */
+        static constexpr size_t minSize = 1024;
+
+        size_t size;
+
+        /**
+         * The flattened string, or null if not flattened yet.
+         */
+        std::atomic<const StringWithContext *> flat;
+
+        /**
+         * The concatenated strings, or null once `flat` is set.
+         */
+        std::atomic<const Operands *> operands;
+
+        StringConcat(size_t size, const Operands * operands)
+            : size(size)
+            , flat(nullptr)
+            , operands(operands)
+        {
+        }
+    };
+
     struct Path
     {
         SourceAccessor * accessor;
@@ -432,6 +477,40 @@ struct ValueBase
         Value * const * elems;
     };
 
+    /**
+     * The concatenation of two lists that hasn't been materialised
+     * yet. `++` produces these for large lists, so that repeatedly
+     * appending to a list (e.g. `foldl' (acc: x: acc ++ [ x ]) [ ]`)
+     * doesn't copy the accumulated elements every time.
+     *
+     * The elements are copied into a flat array the first time they're
+     * needed, after which the operands are dropped so they can be
+     * garbage-collected.
+     */
+    struct ListConcat
+    {
+        struct Operands;
+
+        size_t size;
+
+        /**
+         * The flattened elements, or null if not flattened yet.
+         */
+        std::atomic<Value * const *> elems;
+
+        /**
+         * The concatenated lists, or null once `elems` is set.
+         */
+        std::atomic<const Operands *> operands;
+
+        ListConcat(size_t size, const Operands * operands)
+            : size(size)
+            , elems(nullptr)
+            , operands(operands)
+        {
+        }
+    };
+
     /**
      * Wrapper that stores a std::exception_ptr on the GC heap with a finaliser
      * that runs the exception_ptr destructor (which is refcounted internally).
@@ -508,6 +587,8 @@ struct PayloadTypeToInternalType
     MACRO(const Bindings *, attrs, tAttrs)                          \
     MACRO(ValueBase::List, bigList, tListN)                         \
     MACRO(ValueBase::SmallList, smallList, tListSmall)              \
+    MACRO(ValueBase::ListConcat *, listConcat, tListConcat)         \
+    MACRO(ValueBase::StringConcat *, stringConcat, tStringConcat)   \
     MACRO(ValueBase::ClosureThunk, thunk, tThunk)                   \
     MACRO(ValueBase::FunctionApplicationThunk, app, tApp)           \
     MACRO(ValueBase::Lambda, lambda, tLambda)                       \
@@ -933,6 +1014,18 @@ protected:
         failed = std::bit_cast<Failed *>(payload[1]);
     }
 
+    void getStorage(ListConcat *& listConcat) const noexcept
+    {
+        Payload payload = loadPayload();
+        listConcat = std::bit_cast<ListConcat *>(payload[1]);
+    }
+
+    void getStorage(StringConcat *& stringConcat) const noexcept
+    {
+        Payload payload = loadPayload();
+        stringConcat = std::bit_cast<StringConcat *>(payload[1]);
+    }
+
     void setStorage(NixInt integer) noexcept
     {
         setSingleDWordPayload<tInt>(integer.value);
@@ -987,6 +1080,16 @@ protected:
     {
         setSingleDWordPayload<tFailed>(std::bit_cast<PackedPointer>(failed));
     }
+
+    void setStorage(ListConcat * listConcat) noexcept
+    {
+        setSingleDWordPayload<tListConcat>(std::bit_cast<PackedPointer>(listConcat));
+    }
+
+    void setStorage(StringConcat * stringConcat) noexcept
+    {
+        setSingleDWordPayload<tStringConcat>(std::bit_cast<PackedPointer>(stringConcat));
+    }
 };
 
 /**
@@ -1221,6 +1324,25 @@ private:
         return out;
     }
 
+    /**
+     * Return the elements of a `ListConcat`, flattening it if that
+     * hasn't happened yet. Safe to call concurrently.
+     */
+    static Value * const * flattenListConcat(ListConcat & concat);
+
+    /**
+     * Return the string and context of a `StringConcat`, flattening it
+     * if that hasn't happened yet. Safe to call concurrently.
+     */
+    static const StringWithContext & flattenStringConcat(StringConcat & concat);
+
+    StringWithContext stringWithContext() const
+    {
+        if (isa<tStringConcat>()) [[unlikely]]
+            return flattenStringConcat(*getStorage<StringConcat *>());
+        return getStorage<StringWithContext>();
+    }
+
 public:
 
     /**
@@ -1297,7 +1419,9 @@ public:
             t[tThunk] = nThunk;
             t[tListSmall] = nList;
             t[tListN] = nList;
+            t[tListConcat] = nList;
             t[tString] = nString;
+            t[tStringConcat] = nString;
             t[tPath] = nPath;
             return t;
         }();
@@ -1345,10 +1469,12 @@ public:
         case tPrimOp:
         case tAttrs:
         case tListSmall:
+        case tListConcat:
         case tPrimOpApp: // primop-app is known to be a function, which is WHNF
         case tLambda:
         case tListN:
         case tString:
+        case tStringConcat:
         case tPath:
             return true;
         case tNumberOfInternalTypes:
@@ -1383,6 +1509,13 @@ public:
 
     void mkStringMove(const StringData & s, const NixStringContext & context, EvalMemory & mem);
 
+    /**
+     * Make a string that is the concatenation of `parts`, without
+     * copying them or merging their contexts. All parts must be
+     * strings. `context` is additional context for the result.
+     */
+    void mkStringConcat(std::span<const Value> parts, const NixStringContext & context, EvalMemory & mem);
+
     void mkPath(const SourcePath & path, EvalMemory & mem);
 
     inline void mkPath(SourceAccessor * accessor, const StringData & path) noexcept
@@ -1464,19 +1597,35 @@ public:
         setStorage(new Value::Failed(e, recovery));
     }
 
+    /**
+     * Make a list that is the concatenation of `left` and `right`,
+     * without copying their elements. Both must be lists.
+     */
+    void mkListConcat(const Value & left, const Value & right, EvalMemory & mem);
+
     bool isList() const noexcept
     {
-        return isa<tListSmall, tListN>();
+        return isa<tListSmall, tListN, tListConcat>();
     }
 
-    ListView listView() const noexcept
+    ListView listView() const
     {
-        return isa<tListSmall>() ? ListView(getStorage<SmallList>()) : ListView(getStorage<List>());
+        if (isa<tListSmall>())
+            return ListView(getStorage<SmallList>());
+        if (isa<tListConcat>()) [[unlikely]] {
+            auto concat = getStorage<ListConcat *>();
+            return ListView(List{.size = concat->size, .elems = flattenListConcat(*concat)});
+        }
+        return ListView(getStorage<List>());
     }
 
     size_t listSize() const noexcept
     {
-        return isa<tListSmall>() ? (getStorage<SmallList>()[1] == nullptr ? 1 : 2) : getStorage<List>().size;
+        if (isa<tListSmall>())
+            return getStorage<SmallList>()[1] == nullptr ? 1 : 2;
+        if (isa<tListConcat>()) [[unlikely]]
+            return getStorage<ListConcat *>()->size;
+        return getStorage<List>().size;
     }
 
     PosIdx determinePos(const PosIdx pos) const;
@@ -1494,24 +1643,34 @@ public:
             ref(pathAccessor()->shared_from_this()), CanonPath(CanonPath::unchecked_t(), std::string(pathStrView())));
     }
 
-    const StringData & string_data() const noexcept
+    const StringData & string_data() const
     {
-        return *getStorage<StringWithContext>().str;
+        return *stringWithContext().str;
     }
 
-    const char * c_str() const noexcept
+    const char * c_str() const
     {
-        return getStorage<StringWithContext>().str->data();
+        return string_data().data();
     }
 
-    std::string_view string_view() const noexcept
+    std::string_view string_view() const
     {
         return string_data().view();
     }
 
-    const Value::StringWithContext::Context * context() const noexcept
+    /**
+     * The length of the string, without flattening it.
+     */
+    size_t stringSize() const noexcept
+    {
+        if (isa<tStringConcat>()) [[unlikely]]
+            return getStorage<StringConcat *>()->size;
+        return getStorage<StringWithContext>().str->size();
+    }
+
+    const Value::StringWithContext::Context * context() const
     {
-        return getStorage<StringWithContext>().context;
+        return stringWithContext().context;
     }
 
     ExternalValueBase * external() const noexcept
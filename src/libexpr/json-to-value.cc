@@ -2,203 +2,606 @@
 #include "nix/expr/value.hh"
 #include "nix/expr/eval.hh"
 
+#include <bit>
+#include <cmath>
+#include <cstdlib>
 #include <limits>
 #include <nlohmann/json.hpp>
 
+#if defined(__x86_64__) && defined(__SSE2__)
+#  include <emmintrin.h>
+#endif
+
 using json = nlohmann::json;
 
 namespace nix {
 
 namespace {
 
-// for more information, refer to
-// https://github.com/nlohmann/json/blob/master/include/nlohmann/detail/input/json_sax.hpp
-class JSONSax : nlohmann::json_sax<json>
+/**
+ * A SAX handler that ignores everything except errors. Used to
+ * produce the error message once the input has been found to be
+ * invalid, so that messages are the same as those of other JSON
+ * parsing in Nix.
+ */
+class JSONErrorSax : public nlohmann::json_sax<json>
 {
-    class JSONState
-    {
-    protected:
-        std::unique_ptr<JSONState> parent;
-        RootValue v;
-    public:
-        virtual std::unique_ptr<JSONState> resolve(EvalState &)
-        {
-            throw std::logic_error("tried to close toplevel json parser state");
-        }
+public:
+    bool null() override
+    {
+        return true;
+    }
 
-        explicit JSONState(std::unique_ptr<JSONState> && p)
-            : parent(std::move(p))
-        {
-        }
+    bool boolean(bool) override
+    {
+        return true;
+    }
 
-        explicit JSONState(Value * v)
-            : v(allocRootValue(v))
-        {
-        }
+    bool number_integer(number_integer_t) override
+    {
+        return true;
+    }
 
-        JSONState(JSONState & p) = delete;
+    bool number_unsigned(number_unsigned_t) override
+    {
+        return true;
+    }
 
-        Value & value(EvalState & state)
-        {
-            if (!v)
-                v = allocRootValue(state.allocValue());
-            return **v;
-        }
+    bool number_float(number_float_t, const string_t &) override
+    {
+        return true;
+    }
 
-        virtual ~JSONState() {}
+    bool string(string_t &) override
+    {
+        return true;
+    }
 
-        virtual void add() {}
-    };
+#if NLOHMANN_JSON_VERSION_MAJOR >= 3 && NLOHMANN_JSON_VERSION_MINOR >= 8
+    bool binary(binary_t &) override
+    {
+        return true;
+    }
+#endif
 
-    class JSONObjectState : public JSONState
+    bool start_object(std::size_t) override
     {
-        using JSONState::JSONState;
-        ValueMap attrs;
+        return true;
+    }
 
-        std::unique_ptr<JSONState> resolve(EvalState & state) override
-        {
-            auto attrs2 = state.buildBindings(attrs.size());
-            for (auto & i : attrs)
-                attrs2.insert(i.first, i.second);
-            parent->value(state).mkAttrs(attrs2);
-            return std::move(parent);
-        }
+    bool key(string_t &) override
+    {
+        return true;
+    }
 
-        void add() override
-        {
-            v = nullptr;
-        }
-    public:
-        void key(string_t & name, EvalState & state)
-        {
-            forceNoNullByte(name);
-            attrs.insert_or_assign(state.symbols.create(name), &value(state));
-        }
+    bool end_object() override
+    {
+        return true;
+    }
+
+    bool start_array(std::size_t) override
+    {
+        return true;
+    }
+
+    bool end_array() override
+    {
+        return true;
+    }
+
+    bool parse_error(std::size_t, const std::string &, const nlohmann::detail::exception & ex) override
+    {
+        throw JSONParseError("%s", ex.what());
+    }
+};
+
+/**
+ * Return a pointer to the first byte in `[p, end)` that can't be
+ * part of a string verbatim, i.e. a quote, a backslash, a control
+ * character or a non-ASCII byte (which needs to be validated).
+ */
+static const char * findSpecialByte(const char * p, const char * end)
+{
+#if defined(__x86_64__) && defined(__SSE2__)
+    /* Bytes >= 0x80 are negative as signed chars, so a single signed
+       comparison catches them together with the control characters. */
+    auto space = _mm_set1_epi8(0x20);
+    auto quote = _mm_set1_epi8('"');
+    auto backslash = _mm_set1_epi8('\\');
+    for (; end - p >= 16; p += 16) {
+        auto chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        auto special = _mm_or_si128(
+            _mm_cmplt_epi8(chunk, space),
+            _mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, backslash)));
+        if (auto mask = _mm_movemask_epi8(special))
+            return p + std::countr_zero((unsigned int) mask);
+    }
+#endif
+    for (; p < end; ++p) {
+        auto c = (unsigned char) *p;
+        if (c < 0x20 || c >= 0x80 || c == '"' || c == '\\')
+            break;
+    }
+    return p;
+}
+
+/**
+ * A validating JSON parser that builds Nix values directly, without an
+ * intermediate DOM or per-container state objects.
+ *
+ * Nesting is handled with an explicit stack rather than recursion, so
+ * deeply nested input can't overflow the C++ stack. The elements of
+ * all open containers live in a single scratch vector that is scanned
+ * by the garbage collector, and are copied into a list or `Bindings`
+ * of the right size once the container is closed.
+ *
+ * It accepts exactly the same language as nlohmann's parser. When it
+ * finds an error, the input is parsed again by nlohmann to get the
+ * error message.
+ */
+class JSONParser
+{
+    EvalState & state;
+    std::string_view s;
+    const char * p;
+    const char * const end;
+
+    struct Item
+    {
+        /**
+         * The attribute name, or the empty symbol for list elements.
+         */
+        Symbol name;
+        Value * value;
     };
 
-    class JSONListState : public JSONState
+    std::vector<Item, traceable_allocator<Item>> items;
+
+    struct Frame
     {
-        ValueVector values;
+        bool isObject;
 
-        std::unique_ptr<JSONState> resolve(EvalState & state) override
-        {
-            auto list = state.buildList(values.size());
-            for (const auto & [n, v2] : enumerate(list))
-                v2 = values[n];
-            parent->value(state).mkList(list);
-            return std::move(parent);
-        }
+        /**
+         * Index in `items` of the first element of this container.
+         */
+        size_t start;
 
-        void add() override
-        {
-            values.push_back(*v);
-            v = nullptr;
-        }
-    public:
-        JSONListState(std::unique_ptr<JSONState> && p, std::size_t reserve)
-            : JSONState(std::move(p))
-        {
-            values.reserve(reserve);
-        }
+        /**
+         * The name of the object member being parsed.
+         */
+        Symbol key;
     };
 
-    EvalState & state;
-    std::unique_ptr<JSONState> rs;
+    std::vector<Frame> frames;
+
+    /**
+     * Scratch space for strings containing escapes, and for floats.
+     */
+    std::string buf;
 
 public:
-    JSONSax(EvalState & state, Value & v)
+
+    JSONParser(EvalState & state, std::string_view s)
         : state(state)
-        , rs(new JSONState(&v)) {};
+        , s(s)
+        , p(s.data())
+        , end(s.data() + s.size())
+    {
+    }
 
-    bool null() override
+    [[noreturn]] void fail()
     {
-        rs->value(state).mkNull();
-        rs->add();
-        return true;
+        JSONErrorSax sax;
+        json::sax_parse(s, &sax);
+        /* Shouldn't happen, since both parsers accept the same
+           language. */
+        throw JSONParseError("Invalid JSON Value");
     }
 
-    bool boolean(bool val) override
+    void skipWhitespace()
     {
-        rs->value(state).mkBool(val);
-        rs->add();
-        return true;
+        while (p < end && (*p == ' ' || *p == '\n' || *p == '\r' || *p == '\t'))
+            ++p;
     }
 
-    bool number_integer(number_integer_t val) override
+    void expect(char c)
     {
-        rs->value(state).mkInt(val);
-        rs->add();
-        return true;
+        if (p == end || *p != c)
+            fail();
+        ++p;
+    }
+
+    void expectLiteral(std::string_view literal)
+    {
+        if (std::string_view(p, end).substr(0, literal.size()) != literal)
+            fail();
+        p += literal.size();
     }
 
-    bool number_unsigned(number_unsigned_t val_) override
+    std::optional<uint32_t> parseHex4()
     {
-        if (val_ > std::numeric_limits<NixInt::Inner>::max()) {
-            throw Error("unsigned json number %1% outside of Nix integer range", val_);
+        if (end - p < 4)
+            return std::nullopt;
+        uint32_t res = 0;
+        for (int i = 0; i < 4; ++i, ++p) {
+            auto c = *p;
+            res <<= 4;
+            if (c >= '0' && c <= '9')
+                res |= c - '0';
+            else if (c >= 'a' && c <= 'f')
+                res |= c - 'a' + 10;
+            else if (c >= 'A' && c <= 'F')
+                res |= c - 'A' + 10;
+            else
+                return std::nullopt;
         }
-        NixInt::Inner val = val_;
-        rs->value(state).mkInt(val);
-        rs->add();
-        return true;
+        return res;
     }
 
-    bool number_float(number_float_t val, const string_t & s) override
+    void appendUTF8(uint32_t cp)
     {
-        rs->value(state).mkFloat(val);
-        rs->add();
-        return true;
+        if (cp < 0x80)
+            buf.push_back(cp);
+        else if (cp < 0x800) {
+            buf.push_back(0xc0 | (cp >> 6));
+            buf.push_back(0x80 | (cp & 0x3f));
+        } else if (cp < 0x10000) {
+            buf.push_back(0xe0 | (cp >> 12));
+            buf.push_back(0x80 | ((cp >> 6) & 0x3f));
+            buf.push_back(0x80 | (cp & 0x3f));
+        } else {
+            buf.push_back(0xf0 | (cp >> 18));
+            buf.push_back(0x80 | ((cp >> 12) & 0x3f));
+            buf.push_back(0x80 | ((cp >> 6) & 0x3f));
+            buf.push_back(0x80 | (cp & 0x3f));
+        }
     }
 
-    bool string(string_t & val) override
+    void parseEscape()
     {
-        forceNoNullByte(val);
-        rs->value(state).mkString(val, state.mem);
-        rs->add();
-        return true;
+        if (p == end)
+            fail();
+        switch (*p++) {
+        case '"':
+            buf.push_back('"');
+            break;
+        case '\\':
+            buf.push_back('\\');
+            break;
+        case '/':
+            buf.push_back('/');
+            break;
+        case 'b':
+            buf.push_back('\b');
+            break;
+        case 'f':
+            buf.push_back('\f');
+            break;
+        case 'n':
+            buf.push_back('\n');
+            break;
+        case 'r':
+            buf.push_back('\r');
+            break;
+        case 't':
+            buf.push_back('\t');
+            break;
+        case 'u': {
+            auto cp = parseHex4();
+            if (!cp)
+                fail();
+            if (*cp >= 0xd800 && *cp <= 0xdbff) {
+                if (end - p < 2 || p[0] != '\\' || p[1] != 'u')
+                    fail();
+                p += 2;
+                auto low = parseHex4();
+                if (!low || *low < 0xdc00 || *low > 0xdfff)
+                    fail();
+                *cp = 0x10000 + ((*cp - 0xd800) << 10) + (*low - 0xdc00);
+            } else if (*cp >= 0xdc00 && *cp <= 0xdfff)
+                fail();
+            appendUTF8(*cp);
+            break;
+        }
+        default:
+            fail();
+        }
     }
 
-#if NLOHMANN_JSON_VERSION_MAJOR >= 3 && NLOHMANN_JSON_VERSION_MINOR >= 8
-    bool binary(binary_t &) override
+    /**
+     * Validate the UTF-8 sequence starting at `p` and skip it.
+     */
+    void skipUTF8()
     {
-        // This function ought to be unreachable
-        assert(false);
-        return true;
+        auto c = (unsigned char) *p;
+        size_t len;
+        unsigned char lo = 0x80, hi = 0xbf;
+        if (c >= 0xc2 && c <= 0xdf)
+            len = 2;
+        else if (c >= 0xe0 && c <= 0xef) {
+            len = 3;
+            if (c == 0xe0)
+                lo = 0xa0;
+            else if (c == 0xed)
+                hi = 0x9f;
+        } else if (c >= 0xf0 && c <= 0xf4) {
+            len = 4;
+            if (c == 0xf0)
+                lo = 0x90;
+            else if (c == 0xf4)
+                hi = 0x8f;
+        } else
+            fail();
+        if ((size_t) (end - p) < len)
+            fail();
+        for (size_t i = 1; i < len; ++i) {
+            auto d = (unsigned char) p[i];
+            if (d < (i == 1 ? lo : 0x80) || d > (i == 1 ? hi : 0xbf))
+                fail();
+        }
+        p += len;
     }
-#endif
 
-    bool start_object(std::size_t len) override
+    /**
+     * Parse a string, with `p` pointing after the opening quote. The
+     * result points into the input if the string has no escapes, and
+     * into `buf` otherwise.
+     */
+    std::string_view parseString()
     {
-        rs = std::make_unique<JSONObjectState>(std::move(rs));
-        return true;
+        auto start = p, run = p;
+        bool escaped = false;
+
+        while (true) {
+            p = findSpecialByte(p, end);
+            if (p == end)
+                fail();
+            auto c = (unsigned char) *p;
+            if (c == '"')
+                break;
+            else if (c == '\\') {
+                if (!escaped) {
+                    buf.clear();
+                    escaped = true;
+                }
+                buf.append(run, p);
+                ++p;
+                parseEscape();
+                run = p;
+            } else if (c >= 0x80)
+                skipUTF8();
+            else
+                fail();
+        }
+
+        std::string_view res;
+        if (escaped) {
+            buf.append(run, p);
+            /* Only `\u0000` can produce a null byte. */
+            forceNoNullByte(buf);
+            res = buf;
+        } else
+            res = std::string_view(start, p);
+
+        ++p;
+        return res;
     }
 
-    bool key(string_t & name) override
+    Value * parseNumber()
     {
-        dynamic_cast<JSONObjectState *>(rs.get())->key(name, state);
-        return true;
+        auto start = p;
+        bool negative = false, isFloat = false, overflow = false;
+        uint64_t n = 0;
+
+        if (*p == '-') {
+            negative = true;
+            ++p;
+        }
+
+        auto digits = [&]() {
+            auto digitsStart = p;
+            while (p < end && *p >= '0' && *p <= '9')
+                ++p;
+            if (p == digitsStart)
+                fail();
+        };
+
+        if (p < end && *p == '0')
+            ++p;
+        else {
+            auto intStart = p;
+            digits();
+            for (auto q = intStart; q < p; ++q) {
+                unsigned int d = *q - '0';
+                if (n > (std::numeric_limits<uint64_t>::max() - d) / 10)
+                    overflow = true;
+                n = n * 10 + d;
+            }
+        }
+
+        if (p < end && *p == '.') {
+            ++p;
+            digits();
+            isFloat = true;
+        }
+
+        if (p < end && (*p == 'e' || *p == 'E')) {
+            ++p;
+            if (p < end && (*p == '+' || *p == '-'))
+                ++p;
+            digits();
+            isFloat = true;
+        }
+
+        auto v = state.allocValue();
+
+        /* Integers that don't fit in 64 bits become floats, like in
+           nlohmann's parser. */
+        if (!isFloat && !overflow) {
+            if (negative) {
+                if (n <= uint64_t(std::numeric_limits<NixInt::Inner>::max()) + 1) {
+                    v->mkInt(NixInt::Inner(-n));
+                    return v;
+                }
+            } else {
+                if (n > uint64_t(std::numeric_limits<NixInt::Inner>::max()))
+                    throw Error("unsigned json number %1% outside of Nix integer range", n);
+                v->mkInt(NixInt::Inner(n));
+                return v;
+            }
+        }
+
+        buf.assign(start, p);
+        auto f = strtod(buf.c_str(), nullptr);
+        if (!std::isfinite(f))
+            fail();
+        v->mkFloat(f);
+        return v;
     }
 
-    bool end_object() override
+    Symbol parseKey()
     {
-        rs = rs->resolve(state);
-        rs->add();
-        return true;
+        if (p == end || *p != '"')
+            fail();
+        ++p;
+        auto name = state.symbols.create(parseString());
+        skipWhitespace();
+        expect(':');
+        skipWhitespace();
+        return name;
     }
 
-    bool end_array() override
+    Value * finishList(const Frame & frame)
     {
-        return end_object();
+        auto n = items.size() - frame.start;
+        auto list = state.buildList(n);
+        for (size_t i = 0; i < n; ++i)
+            list[i] = items[frame.start + i].value;
+        auto v = state.allocValue();
+        v->mkList(list);
+        items.resize(frame.start);
+        return v;
     }
 
-    bool start_array(size_t len) override
+    Value * finishObject(const Frame & frame)
     {
-        rs = std::make_unique<JSONListState>(std::move(rs), len != std::numeric_limits<size_t>::max() ? len : 128);
-        return true;
+        auto begin = items.begin() + frame.start;
+
+        /* If a key occurs more than once, the last occurrence wins. */
+        std::stable_sort(begin, items.end(), [](const Item & a, const Item & b) { return a.name < b.name; });
+
+        size_t unique = 0;
+        for (auto i = begin; i != items.end(); ++i)
+            if (i + 1 == items.end() || i->name != (i + 1)->name)
+                ++unique;
+
+        auto bindings = state.buildBindings(unique);
+        for (auto i = begin; i != items.end(); ++i)
+            if (i + 1 == items.end() || i->name != (i + 1)->name)
+                bindings.insert(i->name, i->value);
+
+        auto v = state.allocValue();
+        v->mkAttrs(bindings);
+        items.resize(frame.start);
+        return v;
     }
 
-    bool parse_error(std::size_t, const std::string &, const nlohmann::detail::exception & ex) override
+    Value * parse()
     {
-        throw JSONParseError("%s", ex.what());
+        /* Skip a byte order mark, like nlohmann. */
+        if (s.starts_with("\xef\xbb\xbf"))
+            p += 3;
+
+        skipWhitespace();
+
+        while (true) {
+            if (p == end)
+                fail();
+
+            Value * v;
+
+            switch (*p) {
+            case '{':
+                ++p;
+                skipWhitespace();
+                if (p < end && *p == '}') {
+                    ++p;
+                    v = state.allocValue();
+                    v->mkAttrs(&Bindings::emptyBindings);
+                    break;
+                }
+                frames.push_back({.isObject = true, .start = items.size(), .key = parseKey()});
+                continue;
+
+            case '[':
+                ++p;
+                skipWhitespace();
+                if (p < end && *p == ']') {
+                    ++p;
+                    v = &Value::vEmptyList;
+                    break;
+                }
+                frames.push_back({.isObject = false, .start = items.size()});
+                continue;
+
+            case '"': {
+                ++p;
+                v = state.allocValue();
+                v->mkString(parseString(), state.mem);
+                break;
+            }
+
+            case 't':
+                expectLiteral("true");
+                v = &Value::vTrue;
+                break;
+
+            case 'f':
+                expectLiteral("false");
+                v = &Value::vFalse;
+                break;
+
+            case 'n':
+                expectLiteral("null");
+                v = &Value::vNull;
+                break;
+
+            default:
+                if (*p != '-' && (*p < '0' || *p > '9'))
+                    fail();
+                v = parseNumber();
+            }
+
+            /* Add the value to the enclosing containers, closing
+               them as long as their end follows. */
+            while (true) {
+                skipWhitespace();
+
+                if (frames.empty()) {
+                    if (p != end)
+                        fail();
+                    return v;
+                }
+
+                auto & frame = frames.back();
+                items.push_back({frame.key, v});
+
+                if (p == end)
+                    fail();
+
+                if (*p == ',') {
+                    ++p;
+                    skipWhitespace();
+                    if (frame.isObject)
+                        frame.key = parseKey();
+                    break;
+                }
+
+                expect(frame.isObject ? '}' : ']');
+                v = frame.isObject ? finishObject(frame) : finishList(frame);
+                frames.pop_back();
+            }
+        }
     }
 };
 
@@ -206,10 +609,8 @@ public:
 
 void parseJSON(EvalState & state, const std::string_view & s_, Value & v)
 {
-    JSONSax parser(state, v);
-    bool res = json::sax_parse(s_, &parser);
-    if (!res)
-        throw JSONParseError("Invalid JSON Value");
+    JSONParser parser(state, s_);
+    v = *parser.parse();
 }
 
 void JSONParseError::anchor() {}
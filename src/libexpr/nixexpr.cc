@@ -1,5 +1,7 @@
 #include "nix/expr/nixexpr.hh"
+#include "nix/expr/bytecode.hh"
 #include "nix/expr/eval.hh"
+#include "nix/expr/eval-settings.hh"
 #include "nix/expr/symbol-table.hh"
 #include "nix/util/util.hh"
 #include "nix/expr/print.hh"
@@ -13,6 +15,9 @@ namespace nix {
 
 Counter Expr::nrExprs;
 
+Counter AttrLookupCache::nrHits;
+Counter AttrLookupCache::nrMisses;
+
 ExprBlackHole eBlackHole;
 
 // FIXME: remove, because *symbols* are abstract and do not have a single
@@ -458,6 +463,74 @@ void ExprList::bindVars(EvalState & es, const std::shared_ptr<const StaticEnv> &
         i->bindVars(es, env);
 }
 
+/**
+ * Whether evaluating `e` might store a reference to the current `Env`
+ * anywhere (e.g. in a thunk or a closure), or, if `asThunk`, whether
+ * `e->maybeThunk()` might. This is conservative: it only returns
+ * false for expressions that evaluate their subexpressions directly.
+ */
+static bool capturesEnv(Expr * e, bool asThunk)
+{
+    if (dynamic_cast<ExprInt *>(e) || dynamic_cast<ExprFloat *>(e) || dynamic_cast<ExprString *>(e)
+        || dynamic_cast<ExprPath *>(e))
+        return false;
+
+    if (auto e2 = dynamic_cast<ExprVar *>(e))
+        /* maybeThunk() creates a thunk if the variable comes from a
+           `with` or isn't initialised yet, which can't happen for the
+           function's own arguments. */
+        return asThunk && (e2->fromWith || e2->level != 0);
+
+    if (asThunk)
+        return true;
+
+    auto attrPathCaptures = [](std::span<const AttrName> attrPath) {
+        return std::ranges::any_of(attrPath, [](auto & i) { return i.expr && capturesEnv(i.expr, false); });
+    };
+
+    if (auto e2 = dynamic_cast<ExprSelect *>(e))
+        return capturesEnv(e2->e, false) || (e2->def && capturesEnv(e2->def, false))
+               || attrPathCaptures(e2->getAttrPath());
+
+    if (auto e2 = dynamic_cast<ExprOpHasAttr *>(e))
+        return capturesEnv(e2->e, false) || attrPathCaptures(e2->attrPath);
+
+    if (auto e2 = dynamic_cast<ExprIf *>(e))
+        return capturesEnv(e2->cond, false) || capturesEnv(e2->then, false) || capturesEnv(e2->else_, false);
+
+    if (auto e2 = dynamic_cast<ExprAssert *>(e))
+        return capturesEnv(e2->cond, false) || capturesEnv(e2->body, false);
+
+    if (auto e2 = dynamic_cast<ExprOpNot *>(e))
+        return capturesEnv(e2->e, false);
+
+    auto binOpCaptures = [](auto * e2) { return capturesEnv(e2->e1, false) || capturesEnv(e2->e2, false); };
+
+    if (auto e2 = dynamic_cast<ExprOpEq *>(e))
+        return binOpCaptures(e2);
+    if (auto e2 = dynamic_cast<ExprOpNEq *>(e))
+        return binOpCaptures(e2);
+    if (auto e2 = dynamic_cast<ExprOpAnd *>(e))
+        return binOpCaptures(e2);
+    if (auto e2 = dynamic_cast<ExprOpOr *>(e))
+        return binOpCaptures(e2);
+    if (auto e2 = dynamic_cast<ExprOpImpl *>(e))
+        return binOpCaptures(e2);
+    if (auto e2 = dynamic_cast<ExprOpConcatLists *>(e))
+        return binOpCaptures(e2);
+    if (auto e2 = dynamic_cast<ExprOpUpdate *>(e))
+        return binOpCaptures(e2);
+
+    if (auto e2 = dynamic_cast<ExprConcatStrings *>(e))
+        return std::ranges::any_of(e2->es, [](auto & i) { return capturesEnv(i.second, false); });
+
+    if (auto e2 = dynamic_cast<ExprCall *>(e))
+        return capturesEnv(e2->fun, false)
+               || std::ranges::any_of(*e2->args, [](auto * arg) { return capturesEnv(arg, true); });
+
+    return true;
+}
+
 void ExprLambda::bindVars(EvalState & es, const std::shared_ptr<const StaticEnv> & env)
 {
     if (es.debugRepl)
@@ -483,6 +556,20 @@ void ExprLambda::bindVars(EvalState & es, const std::shared_ptr<const StaticEnv>
     }
 
     body->bindVars(es, newEnv);
+
+    if (es.settings.evalBytecode)
+        bytecode = Bytecode::compile(es, *body);
+
+    /* Default values of formals may refer to formals that haven't
+       been filled in yet, in which case `maybeThunk()` creates a
+       thunk. So only allow constants. */
+    if (es.settings.reuseEnvs)
+        reuseEnv = std::ranges::all_of(
+                       std::span<const Formal>(formalsStart, nFormals),
+                       [](auto & formal) {
+                           return !formal.def || (!dynamic_cast<ExprVar *>(formal.def) && !capturesEnv(formal.def, true));
+                       })
+                   && !capturesEnv(body, false);
 }
 
 void ExprCall::moveDataToAllocator(std::pmr::polymorphic_allocator<char> & alloc)
@@ -2704,10 +2704,10 @@ static RegisterPrimOp primop_toXML({
    represented (e.g., functions). */
 static void prim_toJSON(EvalState & state, CallSite callSite, Value * const * args, Value & v)
 {
-    std::ostringstream out;
+    std::string out;
     NixStringContext context;
     printValueAsJSON(state, true, *args[0], noPos, out, context);
-    v.mkString(out.view(), context, state.mem);
+    v.mkString(out, context, state.mem);
 }
 
 static RegisterPrimOp primop_toJSON({
@@ -5101,20 +5101,59 @@ static void prim_concatStringsSep(EvalState & state, CallSite callSite, Value *
         noPos,
         "while evaluating the second argument (the list of strings to concat) passed to builtins.concatStringsSep");
 
+    auto list = args[1]->listView();
+
+    /* Don't look at the contents or the context of the elements that
+       are strings yet, as they may be concatenations that we don't
+       want to flatten. */
+    std::vector<BackedStringView> coerced;
+    size_t size = list.size() ? (list.size() - 1) * sep.size() : 0;
+
+    for (auto elem : list) {
+        state.forceValue(*elem, noPos);
+        if (elem->type() == nString)
+            size += elem->stringSize();
+        else {
+            coerced.push_back(state.coerceToString(
+                noPos,
+                *elem,
+                context,
+                "while evaluating one element of the list of strings to concat passed to builtins.concatStringsSep"));
+            size += coerced.back()->size();
+        }
+    }
+
+    auto nextCoerced = coerced.begin();
+
+    if (size >= Value::StringConcat::minSize) {
+        SmallTemporaryValueVector<conservativeStackReservation> parts;
+        parts.reserve(list.size() * 2);
+        for (auto elem : list) {
+            if (!parts.empty() && !sep.empty())
+                parts.push_back(*args[0]);
+            if (elem->type() == nString)
+                parts.push_back(*elem);
+            else
+                parts.emplace_back().mkString(**nextCoerced++, state.mem);
+        }
+        v.mkStringConcat({parts.data(), parts.size()}, context, state.mem);
+        return;
+    }
+
     std::string res;
-    res.reserve((args[1]->listSize() + 32) * sep.size());
+    res.reserve(size);
     bool first = true;
 
-    for (auto elem : args[1]->listView()) {
+    for (auto elem : list) {
         if (first)
             first = false;
         else
             res += sep;
-        res += *state.coerceToString(
-            noPos,
-            *elem,
-            context,
-            "while evaluating one element of the list of strings to concat passed to builtins.concatStringsSep");
+        if (elem->type() == nString) {
+            copyContext(*elem, context);
+            res += elem->string_view();
+        } else
+            res += **nextCoerced++;
     }
 
     v.mkString(res, context, state.mem);
@@ -3,9 +3,15 @@
 #include "nix/store/store-api.hh"
 #include "nix/util/signals.hh"
 
+#include <bit>
+#include <charconv>
 #include <cstdlib>
 #include <nlohmann/json.hpp>
 
+#if defined(__x86_64__) && defined(__SSE2__)
+#  include <emmintrin.h>
+#endif
+
 namespace nix {
 using json = nlohmann::json;
 
@@ -112,6 +118,311 @@ json printValueAsJSON(
 
 void JSONSerializationError::anchor() {}
 
+namespace {
+
+/**
+ * Serialises a value as compact JSON into a string buffer while
+ * traversing it, without building an `nlohmann::json` tree first. The
+ * output is the same as that of `printValueAsJSON(...).dump()`.
+ */
+struct JSONWriter
+{
+    EvalState & state;
+    bool strict;
+    NixStringContext & context;
+
+    std::string & out;
+
+    /**
+     * `nlohmann::json::dump()` only rejected invalid UTF-8 once the
+     * whole value had been evaluated, so evaluation errors take
+     * precedence over this.
+     */
+    std::optional<std::string> serialisationError;
+
+    void invalidUTF8(std::string_view reason, unsigned char byte)
+    {
+        if (!serialisationError)
+            serialisationError = fmt("[json.exception.type_error.316] %s: 0x%02X", reason, (unsigned int) byte);
+    }
+
+    /**
+     * Return the length of the UTF-8 sequence starting at `s[i]`, or
+     * 0 (after recording the error) if it is invalid.
+     */
+    size_t checkUTF8(std::string_view s, size_t i);
+
+    void writeString(std::string_view s);
+
+    void write(Value & v, const PosIdx pos, bool copyToStore);
+
+    void finish()
+    {
+        if (serialisationError)
+            throw JSONSerializationError("JSON serialization error: %s", *serialisationError);
+    }
+};
+
+/**
+ * Return the offset of the first byte of `s` at or after `i` that
+ * can't be copied verbatim into a JSON string, i.e. a control
+ * character, a quote, a backslash or a non-ASCII byte (which needs
+ * to be validated).
+ */
+static size_t findSpecialByte(std::string_view s, size_t i)
+{
+#if defined(__x86_64__) && defined(__SSE2__)
+    /* Bytes >= 0x80 are negative as signed chars, so a single signed
+       comparison catches them together with the control characters. */
+    auto space = _mm_set1_epi8(0x20);
+    auto quote = _mm_set1_epi8('"');
+    auto backslash = _mm_set1_epi8('\\');
+    for (; i + 16 <= s.size(); i += 16) {
+        auto chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s.data() + i));
+        auto special = _mm_or_si128(
+            _mm_cmplt_epi8(chunk, space),
+            _mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, backslash)));
+        if (auto mask = _mm_movemask_epi8(special))
+            return i + std::countr_zero((unsigned int) mask);
+    }
+#endif
+    for (; i < s.size(); ++i) {
+        auto c = (unsigned char) s[i];
+        if (c < 0x20 || c >= 0x80 || c == '"' || c == '\\')
+            return i;
+    }
+    return i;
+}
+
+size_t JSONWriter::checkUTF8(std::string_view s, size_t i)
+{
+    /* Report errors at the same byte as `nlohmann::json::dump()`. */
+    auto c = (unsigned char) s[i];
+    size_t len;
+    unsigned char lo = 0x80, hi = 0xbf;
+    if (c >= 0xc2 && c <= 0xdf)
+        len = 2;
+    else if (c >= 0xe0 && c <= 0xef) {
+        len = 3;
+        if (c == 0xe0)
+            lo = 0xa0;
+        else if (c == 0xed)
+            hi = 0x9f;
+    } else if (c >= 0xf0 && c <= 0xf4) {
+        len = 4;
+        if (c == 0xf0)
+            lo = 0x90;
+        else if (c == 0xf4)
+            hi = 0x8f;
+    } else {
+        invalidUTF8(fmt("invalid UTF-8 byte at index %d", i), c);
+        return 0;
+    }
+    for (size_t k = 1; k < len; ++k) {
+        if (i + k == s.size()) {
+            invalidUTF8("incomplete UTF-8 string; last byte", s.back());
+            return 0;
+        }
+        auto c2 = (unsigned char) s[i + k];
+        if (c2 < lo || c2 > hi) {
+            invalidUTF8(fmt("invalid UTF-8 byte at index %d", i + k), c2);
+            return 0;
+        }
+        lo = 0x80;
+        hi = 0xbf;
+    }
+    return len;
+}
+
+void JSONWriter::writeString(std::string_view s)
+{
+    out.reserve(out.size() + s.size() + 2);
+    out.push_back('"');
+
+    size_t i = 0;
+    while (true) {
+        auto j = findSpecialByte(s, i);
+        out.append(s.substr(i, j - i));
+        if (j == s.size())
+            break;
+        i = j;
+
+        auto c = (unsigned char) s[i];
+
+        if (c >= 0x80) {
+            auto len = checkUTF8(s, i);
+            /* The output is discarded anyway, but keep it well-formed. */
+            if (!len)
+                break;
+            out.append(s.substr(i, len));
+            i += len;
+            continue;
+        }
+
+        switch (c) {
+        case '"':
+            out += "\\\"";
+            break;
+        case '\\':
+            out += "\\\\";
+            break;
+        case '\b':
+            out += "\\b";
+            break;
+        case '\f':
+            out += "\\f";
+            break;
+        case '\n':
+            out += "\\n";
+            break;
+        case '\r':
+            out += "\\r";
+            break;
+        case '\t':
+            out += "\\t";
+            break;
+        default:
+            out += fmt("\\u%04x", (unsigned int) c);
+        }
+        ++i;
+    }
+
+    out.push_back('"');
+}
+
+void JSONWriter::write(Value & v, const PosIdx pos, bool copyToStore)
+{
+    checkInterrupt();
+
+    auto _level = state.addCallDepth(pos);
+
+    if (strict)
+        state.forceValue(v, pos);
+
+    switch (v.type()) {
+
+    case nInt: {
+        char buf[24];
+        auto [end, ec] = std::to_chars(buf, buf + sizeof(buf), v.integer().value);
+        out.append(buf, end);
+        break;
+    }
+
+    case nBool:
+        out += v.boolean() ? "true" : "false";
+        break;
+
+    case nString:
+        copyContext(v, context);
+        writeString(v.string_view());
+        break;
+
+    case nPath:
+        if (copyToStore)
+            writeString(state.store->printStorePath(state.copyPathToStore(context, v.path())));
+        else
+            writeString(v.path().path.abs());
+        break;
+
+    case nNull:
+        out += "null";
+        break;
+
+    case nAttrs: {
+        state.peelToStringOutPath(pos, v, /*checkToStringReturn=*/true, [&](Value * peeled, bool cameThroughToString) {
+            if (peeled->type() != nAttrs) {
+                // See printValueAsJSON() above.
+                auto copyToStore2 = copyToStore && !cameThroughToString;
+                write(*peeled, pos, copyToStore2);
+                return;
+            }
+            out.push_back('{');
+            bool first = true;
+            for (auto & a : peeled->attrs()->lexicographicOrder(state.symbols)) {
+                if (!first)
+                    out.push_back(',');
+                first = false;
+                writeString(state.symbols[a->name]);
+                out.push_back(':');
+                try {
+                    write(*a->value, a->pos, copyToStore);
+                } catch (Error & e) {
+                    e.addTrace(
+                        state.positions[a->pos], HintFmt("while evaluating attribute '%1%'", state.symbols[a->name]));
+                    throw;
+                }
+            }
+            out.push_back('}');
+        });
+        break;
+    }
+
+    case nList: {
+        out.push_back('[');
+        int i = 0;
+        for (auto elem : v.listView()) {
+            if (i)
+                out.push_back(',');
+            try {
+                write(*elem, pos, copyToStore);
+            } catch (Error & e) {
+                e.addTrace(state.positions[pos], HintFmt("while evaluating list element at index %1%", i));
+                throw;
+            }
+            i++;
+        }
+        out.push_back(']');
+        break;
+    }
+
+    case nExternal:
+        try {
+            out += v.external()->printValueAsJSON(state, strict, context, copyToStore).dump();
+        } catch (nlohmann::json::exception & e) {
+            if (!serialisationError)
+                serialisationError = e.what();
+        }
+        break;
+
+    case nFloat:
+        /* Let nlohmann format floats, so that they round-trip in the
+           same way as before. */
+        out += json(v.fpoint()).dump();
+        break;
+
+    case nThunk:
+    case nFailed:
+    case nFunction:
+        state.error<TypeError>("cannot convert %1% to JSON", showType(v)).atPos(v.determinePos(pos)).debugThrow();
+    }
+}
+
+} // namespace
+
+void printValueAsJSON(
+    EvalState & state,
+    bool strict,
+    Value & v,
+    const PosIdx pos,
+    std::string & out,
+    NixStringContext & context,
+    bool copyToStore)
+{
+    JSONWriter writer{.state = state, .strict = strict, .context = context, .out = out};
+    writer.write(v, pos, copyToStore);
+    writer.finish();
+}
+
+void printValueAsJSON(
+    EvalState & state, bool strict, Value & v, const PosIdx pos, Sink & sink, NixStringContext & context, bool copyToStore)
+{
+    /* Don't write anything before the whole value has been
+       serialised, so that errors don't leave truncated JSON behind. */
+    std::string buf;
+    printValueAsJSON(state, strict, v, pos, buf, context, copyToStore);
+    sink(buf);
+}
+
 void printValueAsJSON(
     EvalState & state,
     bool strict,
@@ -121,11 +432,8 @@ void printValueAsJSON(
     NixStringContext & context,
     bool copyToStore)
 {
-    try {
-        str << printValueAsJSON(state, strict, v, pos, context, copyToStore);
-    } catch (nlohmann::json::exception & e) {
-        throw JSONSerializationError("JSON serialization error: %s", e.what());
-    }
+    LambdaSink sink([&](std::string_view data) { str << data; });
+    printValueAsJSON(state, strict, v, pos, sink, context, copyToStore);
 }
 
 json ExternalValueBase::printValueAsJSON(
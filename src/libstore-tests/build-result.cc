@@ -90,6 +90,33 @@ INSTANTIATE_TEST_SUITE_P(
                 .cpuUser = std::chrono::seconds(500),
                 .cpuSystem = std::chrono::seconds(604),
             },
+        },
+        std::pair{
+            "success-resources",
+            BuildResult{
+                .inner{BuildResult::Success{
+                    .status = BuildResult::Success::Built,
+                    .builtOutputs{
+                        {
+                            "out",
+                            {
+                                .outPath = StorePath{"g1w7hy3qg1w7hy3qg1w7hy3qg1w7hy3q-foo"},
+                            },
+                        },
+                    },
+                }},
+                .timesBuilt = 1,
+                .startTime = 30,
+                .stopTime = 50,
+                .cpuUser = std::chrono::seconds(500),
+                .cpuSystem = std::chrono::seconds(604),
+                .memoryPeak = 2147483648,
+                .ioRead = 1048576,
+                .ioWrite = 536870912,
+                .cpuPressure = std::chrono::seconds(12),
+                .memoryPressure = std::chrono::milliseconds(250),
+                .ioPressure = std::chrono::seconds(3),
+            },
         }));
 
 } // namespace nix
@@ -0,0 +1,97 @@
+#include <gtest/gtest.h>
+
+#include "nix/store/daemon-stats.hh"
+
+#include <nlohmann/json.hpp>
+
+namespace nix::daemon {
+
+using namespace std::chrono_literals;
+
+TEST(DaemonStats, latencyPercentile)
+{
+    Stats::Op op;
+    EXPECT_EQ(op.latencyPercentile(0.5), 0);
+
+    /* 90 fast operations (< 2^4 µs) and 10 slow ones (< 2^10 µs). */
+    op.count = 100;
+    op.latencyBuckets[4] = 90;
+    op.latencyBuckets[10] = 10;
+
+    EXPECT_EQ(op.latencyPercentile(0), 16);
+    EXPECT_EQ(op.latencyPercentile(0.5), 16);
+    EXPECT_EQ(op.latencyPercentile(0.9), 16);
+    EXPECT_EQ(op.latencyPercentile(0.91), 1024);
+    EXPECT_EQ(op.latencyPercentile(1), 1024);
+}
+
+TEST(DaemonStats, record)
+{
+    auto before = getStats();
+
+    recordOp(WorkerProto::Op::IsValidPath, 5us, 100, 8);
+    recordOp(WorkerProto::Op::IsValidPath, 3000us, 200, 8);
+    recordOp(WorkerProto::Op::AddMultipleToStore, 1s, 1000, 0);
+    recordSQLiteBusyRetry();
+    recordStateLockWait(2ms);
+
+    auto after = getStats();
+
+    auto & isValidPath = after.ops.at("IsValidPath");
+    auto & isValidPath0 = before.ops["IsValidPath"];
+    EXPECT_EQ(isValidPath.count - isValidPath0.count, 2);
+    EXPECT_EQ(isValidPath.bytesIn - isValidPath0.bytesIn, 300);
+    EXPECT_EQ(isValidPath.bytesOut - isValidPath0.bytesOut, 16);
+    EXPECT_EQ(isValidPath.totalMicros - isValidPath0.totalMicros, 3005);
+    EXPECT_EQ(isValidPath.latencyBuckets[3] - isValidPath0.latencyBuckets[3], 1);
+    EXPECT_EQ(isValidPath.latencyBuckets[12] - isValidPath0.latencyBuckets[12], 1);
+
+    EXPECT_EQ(after.ops.at("AddMultipleToStore").count - before.ops["AddMultipleToStore"].count, 1);
+
+    EXPECT_EQ(after.sqliteBusyRetries - before.sqliteBusyRetries, 1);
+    EXPECT_EQ(after.stateLockWaits - before.stateLockWaits, 1);
+    EXPECT_EQ(after.stateLockWaitMicros - before.stateLockWaitMicros, 2000);
+}
+
+TEST(DaemonStats, json)
+{
+    Stats stats;
+    auto & op = stats.ops["QueryPathInfo"];
+    op.count = 3;
+    op.bytesIn = 120;
+    op.bytesOut = 2048;
+    op.totalMicros = 40;
+    op.latencyBuckets[3] = 2;
+    op.latencyBuckets[5] = 1;
+    stats.sqliteBusyRetries = 7;
+    stats.stateLockWaits = 2;
+    stats.stateLockWaitMicros = 15;
+
+    nlohmann::json json = stats;
+    EXPECT_EQ(json["ops"]["QueryPathInfo"]["p50Micros"], 8);
+    EXPECT_EQ(json["ops"]["QueryPathInfo"]["p99Micros"], 32);
+    EXPECT_EQ(json.get<Stats>(), stats);
+}
+
+TEST(DaemonStats, prometheus)
+{
+    Stats stats;
+    auto & op = stats.ops["QueryPathInfo"];
+    op.count = 3;
+    op.totalMicros = 1500000;
+    op.latencyBuckets[0] = 1;
+    op.latencyBuckets[2] = 2;
+
+    auto text = stats.toPrometheus();
+
+    EXPECT_NE(text.find("# TYPE nix_daemon_op_latency_seconds histogram\n"), std::string::npos);
+    EXPECT_NE(text.find("nix_daemon_op_latency_seconds_bucket{op=\"QueryPathInfo\",le=\"1e-06\"} 1\n"), std::string::npos);
+    EXPECT_NE(text.find("nix_daemon_op_latency_seconds_bucket{op=\"QueryPathInfo\",le=\"2e-06\"} 1\n"), std::string::npos);
+    EXPECT_NE(text.find("nix_daemon_op_latency_seconds_bucket{op=\"QueryPathInfo\",le=\"4e-06\"} 3\n"), std::string::npos);
+    EXPECT_NE(text.find("nix_daemon_op_latency_seconds_bucket{op=\"QueryPathInfo\",le=\"+Inf\"} 3\n"), std::string::npos);
+    EXPECT_NE(text.find("nix_daemon_op_latency_seconds_sum{op=\"QueryPathInfo\"} 1.5\n"), std::string::npos);
+    EXPECT_NE(text.find("nix_daemon_op_latency_seconds_count{op=\"QueryPathInfo\"} 3\n"), std::string::npos);
+    EXPECT_NE(text.find("nix_daemon_sqlite_busy_retries_total 0\n"), std::string::npos);
+}
+
+} // namespace nix::daemon
@@ -2,7 +2,10 @@
 #include <regex>
 
 #include "nix/store/http-binary-cache-store.hh"
+#include "nix/store/build/worker.hh"
+#include "nix/store/dummy-store-impl.hh"
 #include "nix/store/tests/https-store.hh"
+#include "nix/util/finally.hh"
 
 namespace nix {
 
@@ -65,6 +68,60 @@ TEST_F(HttpsBinaryCacheStoreTest, queryPathInfo)
     EXPECT_NO_THROW(store->queryPathInfo(path));
 }
 
+TEST_F(HttpsBinaryCacheStoreTest, substituteWithSmallBuffer)
+{
+    /* Incompressible contents, so that only a couple of NARs fit in
+       the buffer at once and the others have to wait for room. The
+       last one doesn't fit at all and is downloaded while it's
+       imported. */
+    auto makeContents = [](int seed, size_t size) {
+        std::string s;
+        uint32_t x = seed * 2654435761U + 1;
+        while (s.size() < size) {
+            x = x * 1664525 + 1013904223;
+            s.push_back(char(x >> 24));
+        }
+        return s;
+    };
+
+    StorePathSet paths;
+    for (int i = 0; i < 16; ++i) {
+        StringSource dump{makeContents(i, 16 << 10)};
+        paths.insert(localCacheStore->addToStoreFromDump(dump, fmt("path-%d", i), FileSerialisationMethod::Flat));
+    }
+    StringSource largeDump{makeContents(-1, 128 << 10)};
+    paths.insert(localCacheStore->addToStoreFromDump(largeDump, "large", FileSerialisationMethod::Flat));
+
+    auto & workerSettings = settings.getWorkerSettings();
+    auto oldBufferSize = workerSettings.substitutionBufferSize.get();
+    Finally restore([&]() { workerSettings.substitutionBufferSize = oldBufferSize; });
+    workerSettings.substitutionBufferSize = 40 << 10;
+
+    auto config = makeConfig();
+    config->isTrusted = true;
+    ref<Store> substituter = openStore(config);
+
+    auto dstConfig = make_ref<DummyStoreConfig>(DummyStoreConfig::Params{});
+    dstConfig->readOnly = false;
+    auto dstStore = dstConfig->openDummyStore();
+
+    Worker worker{*dstStore, *dstStore};
+    worker.getSubstituters = [substituter]() -> std::list<ref<Store>> { return {substituter}; };
+
+    Goals goals;
+    for (auto & path : paths)
+        goals.insert(upcast_goal(worker.makePathSubstitutionGoal(path)));
+    worker.run(goals);
+
+    for (auto & goal : goals)
+        EXPECT_EQ(goal->exitCode, Goal::ecSuccess);
+
+    for (auto & path : paths) {
+        ASSERT_TRUE(dstStore->isValidPath(path));
+        EXPECT_EQ(dstStore->queryPathInfo(path)->narHash, localCacheStore->queryPathInfo(path)->narHash);
+    }
+}
+
 TEST_F(HttpsBinaryCacheStoreMtlsTest, queryPathInfo)
 {
     auto config = makeConfig();
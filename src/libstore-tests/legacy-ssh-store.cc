@@ -40,4 +40,16 @@ TEST(LegacySSHStore, constructConfig)
     EXPECT_EQ(config.getReference().render(/*withParams=*/true), "ssh://me@localhost:2222?remote-program=foo%20bar");
     EXPECT_EQ(config.getReference().render(/*withParams=*/false), "ssh://me@localhost:2222");
 }
+
+TEST(LegacySSHStore, controlPersist)
+{
+    LegacySSHStoreConfig config(
+        ParsedURL::Authority::parse("me@localhost"),
+        StoreConfig::Params{
+            {"control-persist", "60"},
+        });
+
+    EXPECT_EQ(config.controlPersist.get(), 60u);
+    EXPECT_EQ(config.getReference().render(/*withParams=*/true), "ssh://me@localhost?control-persist=60");
+}
 } // namespace nix
@@ -0,0 +1,68 @@
+#include <gtest/gtest.h>
+
+#include "nix/store/nar-info-index.hh"
+#include "nix/util/file-system.hh"
+
+namespace nix {
+
+static NarInfoIndexEntry entry(char c, uint64_t narSize, uint64_t fileSize)
+{
+    return {.hashPart = std::string(32, c), .narSize = narSize, .fileSize = fileSize};
+}
+
+TEST(NarInfoIndexShard, shardPath)
+{
+    EXPECT_EQ(NarInfoIndexShard::shardPath("g1w7hy3qg1w7hy3qg1w7hy3qg1w7hy3q"), "index/g1.idx");
+}
+
+TEST(NarInfoIndexShard, empty)
+{
+    auto shard = NarInfoIndexShard::parse(NarInfoIndexShard::serialise({}));
+    EXPECT_TRUE(shard.entries().empty());
+    EXPECT_EQ(shard.lookup(std::string(32, 'a')), std::nullopt);
+}
+
+TEST(NarInfoIndexShard, roundTrip)
+{
+    auto shard = NarInfoIndexShard::parse(NarInfoIndexShard::serialise({
+        entry('z', 1, 2),
+        entry('a', 3, 4),
+        entry('m', 5, 6),
+    }));
+
+    EXPECT_EQ(shard.entries(), (std::vector{entry('a', 3, 4), entry('m', 5, 6), entry('z', 1, 2)}));
+
+    EXPECT_EQ(shard.lookup(std::string(32, 'a')), entry('a', 3, 4));
+    EXPECT_EQ(shard.lookup(std::string(32, 'm')), entry('m', 5, 6));
+    EXPECT_EQ(shard.lookup(std::string(32, 'z')), entry('z', 1, 2));
+    EXPECT_EQ(shard.lookup(std::string(32, 'b')), std::nullopt);
+    EXPECT_EQ(shard.lookup(std::string(32, '0')), std::nullopt);
+}
+
+TEST(NarInfoIndexShard, lastEntryWins)
+{
+    auto shard = NarInfoIndexShard::parse(NarInfoIndexShard::serialise({entry('a', 1, 1), entry('a', 2, 2)}));
+    EXPECT_EQ(shard.entries(), std::vector{entry('a', 2, 2)});
+}
+
+TEST(NarInfoIndexShard, rejectsCorrupt)
+{
+    EXPECT_THROW(NarInfoIndexShard::parse(""), Error);
+    EXPECT_THROW(NarInfoIndexShard::parse("not an index"), Error);
+    EXPECT_THROW(NarInfoIndexShard::parse(NarInfoIndexShard::serialise({entry('a', 1, 1)}) + "x"), Error);
+    EXPECT_THROW(NarInfoIndexShard::serialise({{.hashPart = "short"}}), Error);
+}
+
+TEST(NarInfoIndexShard, open)
+{
+    auto tmpDir = createTempDir();
+    AutoDelete delTmpDir(tmpDir, true);
+
+    auto path = tmpDir / "aa.idx";
+    writeFile(path, NarInfoIndexShard::serialise({entry('a', 7, 8)}));
+
+    auto shard = NarInfoIndexShard::open(path);
+    EXPECT_EQ(shard.lookup(std::string(32, 'a')), entry('a', 7, 8));
+}
+
+} // namespace nix
@@ -0,0 +1,75 @@
+#include "nix/store/reference-graph.hh"
+
+#include <gtest/gtest.h>
+
+namespace nix {
+
+/**
+ * ```
+ * a -> b -> d
+ * a -> c -> d
+ * c -> c
+ * e -> d
+ * ```
+ */
+class ReferenceGraphTest : public ::testing::Test
+{
+protected:
+    StorePath a{"a5zxlbjp6wsmlnbbvs3qml0q3b1m23qr-a"}, b{"b5zxlbjp6wsmlnbbvs3qml0q3b1m23qr-b"},
+        c{"c5zxlbjp6wsmlnbbvs3qml0q3b1m23qr-c"}, d{"d5zxlbjp6wsmlnbbvs3qml0q3b1m23qr-d"},
+        e{"f5zxlbjp6wsmlnbbvs3qml0q3b1m23qr-e"};
+
+    std::vector<ReferenceGraph::Edge> edges{{0, 1}, {0, 2}, {1, 3}, {2, 3}, {2, 2}, {4, 3}};
+
+    ReferenceGraph graph{{a, b, c, d, e}, {1, 10, 100, 1000, 10000}, edges};
+
+    ReferenceGraph::Index index(const StorePath & path)
+    {
+        auto i = graph.lookup(path);
+        EXPECT_TRUE(i);
+        return i.value_or(0);
+    }
+};
+
+TEST_F(ReferenceGraphTest, lookup)
+{
+    for (auto & path : {a, b, c, d, e})
+        ASSERT_EQ(graph.path(index(path)), path);
+    ASSERT_FALSE(graph.lookup(StorePath{"g5zxlbjp6wsmlnbbvs3qml0q3b1m23qr-g"}));
+}
+
+TEST_F(ReferenceGraphTest, adjacency)
+{
+    auto refs = graph.referencesOf(index(a));
+    ASSERT_EQ(std::set<ReferenceGraph::Index>(refs.begin(), refs.end()), (std::set{index(b), index(c)}));
+
+    auto referrers = graph.referrersOf(index(d));
+    ASSERT_EQ(
+        std::set<ReferenceGraph::Index>(referrers.begin(), referrers.end()), (std::set{index(b), index(c), index(e)}));
+
+    ASSERT_TRUE(graph.referencesOf(index(d)).empty());
+    ASSERT_TRUE(graph.referrersOf(index(a)).empty());
+}
+
+TEST_F(ReferenceGraphTest, closure)
+{
+    ReferenceGraph::Index roots[] = {index(a)};
+    ASSERT_EQ(graph.toPaths(graph.closure(roots)), (StorePathSet{a, b, c, d}));
+    ASSERT_EQ(graph.closureSize(roots), 1111u);
+    ASSERT_EQ(graph.totalNarSize(graph.closure(roots)), 1111u);
+
+    ReferenceGraph::Index roots2[] = {index(c), index(e)};
+    ASSERT_EQ(graph.toPaths(graph.closure(roots2)), (StorePathSet{c, d, e}));
+    ASSERT_EQ(graph.closureSize(roots2), 11100u);
+}
+
+TEST_F(ReferenceGraphTest, referrersClosure)
+{
+    ReferenceGraph::Index roots[] = {index(d)};
+    ASSERT_EQ(graph.toPaths(graph.closure(roots, true)), (StorePathSet{a, b, c, d, e}));
+
+    ReferenceGraph::Index roots2[] = {index(b)};
+    ASSERT_EQ(graph.toPaths(graph.closure(roots2, true)), (StorePathSet{a, b}));
+}
+
+} // namespace nix
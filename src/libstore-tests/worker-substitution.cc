@@ -175,6 +175,44 @@ TEST_F(WorkerSubstitutionTest, singleRootStoreObjectWithSingleDepStoreObject)
     ASSERT_EQ(upcast_goal(goal)->exitCode, Goal::ecSuccess);
 }
 
+TEST_F(WorkerSubstitutionTest, manyStoreObjects)
+{
+    // Add more store paths than there are substitution slots or
+    // import threads, so that they have to queue
+    StorePathSet paths;
+    for (int i = 0; i < 64; ++i)
+        paths.insert(substituter->addToStore(
+            fmt("path-%d", i),
+            SourcePath{
+                [i] {
+                    auto sc = make_ref<MemorySourceAccessor>();
+                    sc->root = MemorySourceAccessor::File{MemorySourceAccessor::File::Regular{
+                        .executable = false,
+                        .contents = fmt("contents %d", i),
+                    }};
+                    return sc;
+                }(),
+            },
+            ContentAddressMethod::Raw::NixArchive,
+            HashAlgorithm::SHA256));
+
+    Worker worker{*dummyStore, *dummyStore};
+
+    ref<Store> substituterAsStore = substituter;
+    worker.getSubstituters = [substituterAsStore]() -> std::list<ref<Store>> { return {substituterAsStore}; };
+
+    Goals goals;
+    for (auto & path : paths)
+        goals.insert(upcast_goal(worker.makePathSubstitutionGoal(path)));
+    worker.run(goals);
+
+    for (auto & path : paths)
+        ASSERT_TRUE(dummyStore->isValidPath(path));
+
+    for (auto & goal : goals)
+        ASSERT_EQ(goal->exitCode, Goal::ecSuccess);
+}
+
 TEST_F(WorkerSubstitutionTest, floatingDerivationOutput)
 {
     EnableExperimentalFeature enableCA{"ca-derivations"};
@@ -12,9 +12,15 @@
 #include "nix/util/callback.hh"
 #include "nix/util/signals.hh"
 #include "nix/util/archive.hh"
+#include "nix/util/chunking.hh"
+#include "nix/util/users.hh"
+#include "nix/util/finally.hh"
+#include "nix/util/file-system.hh"
 #include "nix/util/util.hh"
+#include "nix/store/globals.hh"
 
 #include <chrono>
+#include <deque>
 #include <future>
 #include <array>
 #include <regex>
@@ -50,18 +56,31 @@ BinaryCacheStore::BinaryCacheStore(Config & config)
     narMagic = sink.s;
 }
 
+static StringMap parseNixCacheInfo(const std::string & cacheInfo)
+{
+    StringMap res;
+    for (auto & line : tokenizeString<Strings>(cacheInfo, "\n")) {
+        size_t colon = line.find(':');
+        if (colon == std::string::npos)
+            continue;
+        res.insert_or_assign(line.substr(0, colon), trim(line.substr(colon + 1, std::string::npos)));
+    }
+    return res;
+}
+
 void BinaryCacheStore::init()
 {
     auto cacheInfo = getNixCacheInfo();
     if (!cacheInfo) {
-        upsertFile(cacheInfoFile, "StoreDir: " + storeDir + "\n", "text/x-nix-cache-info");
+        std::string s = "StoreDir: " + storeDir + "\n";
+        /* A new cache is trivially completely indexed. */
+        if (config.writeNarInfoIndex)
+            s += "NarInfoIndex: 1\n";
+        upsertFile(cacheInfoFile, std::move(s), "text/x-nix-cache-info");
+        *hasNarInfoIndex_.lock() = config.writeNarInfoIndex;
     } else {
-        for (auto & line : tokenizeString<Strings>(*cacheInfo, "\n")) {
-            size_t colon = line.find(':');
-            if (colon == std::string::npos)
-                continue;
-            auto name = line.substr(0, colon);
-            auto value = trim(line.substr(colon + 1, std::string::npos));
+        auto fields = parseNixCacheInfo(*cacheInfo);
+        for (auto & [name, value] : fields) {
             if (name == "StoreDir") {
                 if (value != storeDir)
                     throw Error(
@@ -75,6 +94,24 @@ void BinaryCacheStore::init()
                 config.priority.setDefault(std::stoi(value));
             }
         }
+
+        auto i = fields.find("NarInfoIndex");
+        bool indexed = i != fields.end() && i->second == "1";
+        if (config.writeNarInfoIndex && !indexed) {
+            try {
+                generateNarInfoIndex();
+                auto newCacheInfo = *cacheInfo;
+                if (!newCacheInfo.empty() && !newCacheInfo.ends_with('\n'))
+                    newCacheInfo += '\n';
+                upsertFile(cacheInfoFile, newCacheInfo + "NarInfoIndex: 1\n", "text/x-nix-cache-info");
+                indexed = true;
+            } catch (Unsupported &) {
+                warn(
+                    "cannot list the contents of binary cache '%s', so its narinfo index will be incomplete",
+                    config.getHumanReadableURI());
+            }
+        }
+        *hasNarInfoIndex_.lock() = indexed;
     }
 }
 
@@ -144,6 +181,122 @@ void BinaryCacheStore::writeNarInfo(ref<NarInfo> narInfo)
             std::shared_ptr<NarInfo>(narInfo));
 }
 
+static std::string compressionExtension(CompressionAlgo compression)
+{
+    return compression == CompressionAlgo::xz       ? ".xz"
+           : compression == CompressionAlgo::bzip2  ? ".bz2"
+           : compression == CompressionAlgo::zstd   ? ".zst"
+           : compression == CompressionAlgo::lzip   ? ".lzip"
+           : compression == CompressionAlgo::lz4    ? ".lz4"
+           : compression == CompressionAlgo::brotli ? ".br"
+                                                    : "";
+}
+
+/**
+ * Chunked NARs are stored as a manifest, compressed like the chunks
+ * themselves, at `nar/<file-hash>.chunks<ext>`. Each line of the
+ * manifest is the Nix32 SHA-256 hash and the size of an uncompressed
+ * chunk, which is stored at `chunks/<hash><ext>`.
+ */
+bool BinaryCacheStore::isChunkManifest(const NarInfo & narInfo)
+{
+    return hasSuffix(
+        narInfo.url, ".chunks" + compressionExtension(narInfo.compression.value_or(CompressionAlgo::none)));
+}
+
+static std::string chunkPath(std::string_view hash, CompressionAlgo compression)
+{
+    return "chunks/" + std::string(hash) + compressionExtension(compression);
+}
+
+/**
+ * Number of chunks that `narFromChunks()` fetches concurrently.
+ */
+static constexpr size_t chunkFetchWindow = 16;
+
+/**
+ * Number of chunks that `uploadData()` uploads concurrently. Checking
+ * whether the cache already has a chunk takes a round trip, so doing
+ * that for one chunk at a time would make uploads latency-bound.
+ */
+static constexpr size_t chunkUploadWindow = 16;
+
+uint64_t BinaryCacheStore::uploadChunk(std::string_view hash, std::string_view chunk, RepairFlag repair)
+{
+    auto path = chunkPath(hash, config.compression);
+    auto compressed = compress(config.compression, chunk, false, config.compressionLevel);
+    auto size = compressed.size();
+
+    /* Only upload chunks that the cache doesn't have yet. */
+    if (repair || !fileExists(path))
+        upsertFile(path, std::move(compressed), "application/x-nix-nar-chunk");
+
+    return size;
+}
+
+void BinaryCacheStore::narFromChunks(const NarInfo & narInfo, Sink & sink)
+{
+    auto compression = narInfo.compression.value_or(CompressionAlgo::none);
+
+    auto manifest = getFile(narInfo.url);
+    if (!manifest)
+        throw SubstituteGone(
+            "chunk manifest '%s' does not exist in binary cache '%s'", narInfo.url, config.getHumanReadableURI());
+
+    std::vector<std::pair<std::string, uint64_t>> chunks;
+    for (auto & line : tokenizeString<std::vector<std::string>>(decompress(compression, *manifest), "\n")) {
+        auto fields = tokenizeString<std::vector<std::string>>(line, " ");
+        auto size = fields.size() == 2 ? string2Int<uint64_t>(fields[1]) : std::nullopt;
+        if (!size)
+            throw Error("invalid line '%s' in chunk manifest '%s'", line, narInfo.url);
+        chunks.emplace_back(fields[0], *size);
+    }
+
+    /* Keep a bounded number of chunk downloads in flight, and write
+       the chunks to the sink in order as they complete. */
+    std::deque<std::future<std::optional<std::string>>> inflight;
+    size_t next = 0;
+
+    for (auto & [hash, size] : chunks) {
+        for (; next < chunks.size() && inflight.size() < chunkFetchWindow; ++next) {
+            auto promise = std::make_shared<std::promise<std::optional<std::string>>>();
+            inflight.push_back(promise->get_future());
+            getFile(
+                chunkPath(chunks[next].first, compression),
+                {[promise](std::future<std::optional<std::string>> result) {
+                    try {
+                        promise->set_value(result.get());
+                    } catch (...) {
+                        promise->set_exception(std::current_exception());
+                    }
+                }});
+        }
+
+        auto data = inflight.front().get();
+        inflight.pop_front();
+
+        checkInterrupt();
+
+        if (!data)
+            throw SubstituteGone(
+                "chunk '%s' of '%s' does not exist in binary cache '%s'",
+                hash,
+                printStorePath(narInfo.path),
+                config.getHumanReadableURI());
+
+        auto chunk = decompress(compression, *data);
+        if (chunk.size() != size
+            || hashString(HashAlgorithm::SHA256, chunk).to_string(HashFormat::Nix32, false) != hash)
+            throw Error(
+                "chunk '%s' of '%s' in binary cache '%s' is corrupt",
+                hash,
+                printStorePath(narInfo.path),
+                config.getHumanReadableURI());
+
+        sink(chunk);
+    }
+}
+
 ref<NarInfo> BinaryCacheStore::uploadData(Source & narSource, RepairFlag repair, fun<ValidPathInfo(HashResult)> mkInfo)
 {
     auto fdTemp = createAnonymousTempFile();
@@ -152,11 +305,64 @@ ref<NarInfo> BinaryCacheStore::uploadData(Source & narSource, RepairFlag repair,
 
     /* Read the NAR simultaneously into a CompressionSink+FileSink (to
        write the compressed NAR to disk), into a HashSink (to get the
-       NAR hash), and into a NarAccessor (to get the NAR listing). */
+       NAR hash), and into a NarAccessor (to get the NAR listing). If
+       the NAR is chunked, the chunks are uploaded as we go and the
+       file is the chunk manifest instead. */
     HashSink fileHashSink{HashAlgorithm::SHA256};
     std::shared_ptr<NarAccessor> narAccessor;
     HashSink narHashSink{HashAlgorithm::SHA256};
-    {
+    /* The compressed size of the chunks of a chunked NAR, counting
+       each chunk as often as the manifest lists it. */
+    uint64_t chunksSize = 0;
+    if (config.chunkNars) {
+        std::string manifest;
+        std::vector<std::string> chunkHashes;
+        std::map<std::string, uint64_t> compressedSizes;
+
+        std::deque<std::pair<std::string, std::future<uint64_t>>> uploads;
+        Finally waitForUploads([&]() {
+            for (auto & [_, f] : uploads)
+                f.wait();
+        });
+        auto finishUpload = [&]() {
+            auto [hash, f] = std::move(uploads.front());
+            uploads.pop_front();
+            compressedSizes[hash] = f.get();
+        };
+
+        ChunkingSink chunker(ChunkingSink::Params::fromAverage(config.narChunkSize), [&](std::string_view chunk) {
+            checkInterrupt();
+            auto hash = hashString(HashAlgorithm::SHA256, chunk).to_string(HashFormat::Nix32, false);
+            manifest += fmt("%s %d\n", hash, chunk.size());
+            chunkHashes.push_back(hash);
+            if (compressedSizes.emplace(hash, 0).second) {
+                if (uploads.size() >= chunkUploadWindow)
+                    finishUpload();
+                uploads.emplace_back(
+                    hash,
+                    getSharedThreadPool().enqueue(
+                        chunkUploadWindow, [this, hash, chunk = std::string(chunk), repair]() {
+                            return uploadChunk(hash, chunk, repair);
+                        }));
+            }
+        });
+        {
+            TeeSink teeSinkUncompressed{chunker, narHashSink};
+            TeeSource teeSource{narSource, teeSinkUncompressed};
+            narAccessor = makeNarAccessor(parseNarListing(teeSource));
+            chunker.finish();
+        }
+        while (!uploads.empty())
+            finishUpload();
+
+        for (auto & hash : chunkHashes)
+            chunksSize += compressedSizes[hash];
+        auto compressed = compress(config.compression, manifest, false, config.compressionLevel);
+        FdSink fileSink(fdTemp.get());
+        TeeSink teeSinkCompressed{fileSink, fileHashSink};
+        teeSinkCompressed(compressed);
+        fileSink.flush();
+    } else {
         FdSink fileSink(fdTemp.get());
         TeeSink teeSinkCompressed{fileSink, fileHashSink};
         bool parallel = config.parallelCompression.overridden ? config.parallelCompression.get()
@@ -177,15 +383,12 @@ ref<NarInfo> BinaryCacheStore::uploadData(Source & narSource, RepairFlag repair,
     narInfo->compression = config.compression;
     auto [fileHash, fileSize] = fileHashSink.finish();
     narInfo->fileHash = fileHash;
-    narInfo->fileSize = fileSize;
-    narInfo->url = "nar/" + narInfo->fileHash->to_string(HashFormat::Nix32, false) + ".nar"
-                   + (config.compression == CompressionAlgo::xz       ? ".xz"
-                      : config.compression == CompressionAlgo::bzip2  ? ".bz2"
-                      : config.compression == CompressionAlgo::zstd   ? ".zst"
-                      : config.compression == CompressionAlgo::lzip   ? ".lzip"
-                      : config.compression == CompressionAlgo::lz4    ? ".lz4"
-                      : config.compression == CompressionAlgo::brotli ? ".br"
-                                                                      : "");
+    /* For a chunked NAR, `FileHash` is that of the manifest, which
+       names it, but `FileSize` is what it takes to download the NAR:
+       the manifest and all its chunks. */
+    narInfo->fileSize = fileSize + chunksSize;
+    narInfo->url = "nar/" + narInfo->fileHash->to_string(HashFormat::Nix32, false)
+                   + (config.chunkNars ? ".chunks" : ".nar") + compressionExtension(config.compression);
 
     auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(now2 - now1).count();
     printMsg(
@@ -193,7 +396,7 @@ ref<NarInfo> BinaryCacheStore::uploadData(Source & narSource, RepairFlag repair,
         "copying path '%1%' (%2% bytes, compressed %3$.1f%% in %4% ms) to binary cache",
         printStorePath(narInfo->path),
         info.narSize,
-        ((1.0 - (double) fileSize / info.narSize) * 100.0),
+        ((1.0 - (double) narInfo->fileSize / info.narSize) * 100.0),
         duration);
 
     /* Optionally write a JSON file containing a listing of the
@@ -209,8 +412,10 @@ ref<NarInfo> BinaryCacheStore::uploadData(Source & narSource, RepairFlag repair,
 
     /* Optionally maintain an index of DWARF debug info files
        consisting of JSON files named 'debuginfo/<build-id>' that
-       specify the NAR file and member containing the debug info. */
-    if (config.writeDebugInfo) {
+       specify the NAR file and member containing the debug info.
+       This requires the NAR to be a single file, so it is not done
+       for chunked NARs. */
+    if (config.writeDebugInfo && !config.chunkNars) {
 
         CanonPath buildIdDir("lib/debug/.build-id");
 
@@ -267,7 +472,7 @@ ref<NarInfo> BinaryCacheStore::uploadData(Source & narSource, RepairFlag repair,
     if (repair || !fileExists(narInfo->url)) {
         FdSource source{fdTemp.get()};
         source.restart(); /* Seek back to the start of the file. */
-        upsertFile(narInfo->url, source, "application/x-nix-nar", narInfo->fileSize);
+        upsertFile(narInfo->url, source, "application/x-nix-nar", fileSize);
     }
 
     return narInfo;
@@ -292,6 +497,13 @@ void BinaryCacheStore::uploadNarInfo(ref<NarInfo> narInfo)
 
     /* Atomically write the NAR info file.*/
     writeNarInfo(narInfo);
+
+    if (config.writeNarInfoIndex || cacheHasNarInfoIndex())
+        pendingNarInfoIndexEntries.lock()->push_back({
+            .hashPart = std::string(narInfo->path.hashPart()),
+            .narSize = narInfo->narSize,
+            .fileSize = narInfo->fileSize,
+        });
 }
 
 ref<const ValidPathInfo> BinaryCacheStore::addToStoreCommon(
@@ -299,6 +511,7 @@ ref<const ValidPathInfo> BinaryCacheStore::addToStoreCommon(
 {
     auto narInfo = uploadData(narSource, repair, std::move(mkInfo));
     uploadNarInfo(narInfo);
+    flushNarInfoIndex();
     return narInfo;
 }
 
@@ -382,6 +595,18 @@ void BinaryCacheStore::addMultipleToStore(
         nodes.insert(UploadNarInfo{path});
     }
 
+    /* Make sure that the index covers the paths that were uploaded
+       even if some other path failed. */
+    Finally flushIndex([&]() {
+        if (!std::uncaught_exceptions())
+            return flushNarInfoIndex();
+        try {
+            flushNarInfoIndex();
+        } catch (...) {
+            ignoreExceptionInDestructor();
+        }
+    });
+
     processGraph<Node>(
         nodes,
 
@@ -523,8 +748,138 @@ StorePath BinaryCacheStore::addToStoreFromDump(
         ->path;
 }
 
+bool BinaryCacheStore::cacheHasNarInfoIndex()
+{
+    auto hasIndex(hasNarInfoIndex_.lock());
+    if (!*hasIndex) {
+        auto cacheInfo = getNixCacheInfo();
+        *hasIndex = cacheInfo && parseNixCacheInfo(*cacheInfo)["NarInfoIndex"] == "1";
+    }
+    return **hasIndex;
+}
+
+bool BinaryCacheStore::haveNarInfoIndex()
+{
+    return config.useNarInfoIndex && cacheHasNarInfoIndex();
+}
+
+std::filesystem::path BinaryCacheStore::narInfoIndexCachePath(const std::string & shardPath)
+{
+    auto cacheKey = hashString(HashAlgorithm::SHA256, config.getReference().render(/*withParams=*/false));
+    return getCacheDir() / "narinfo-index" / cacheKey.to_string(HashFormat::Nix32, false)
+           / std::filesystem::path(shardPath).filename();
+}
+
+/**
+ * Atomically replace a locally cached index shard.
+ */
+static void writeCachedShard(const std::filesystem::path & path, std::string_view data)
+{
+    createDirs(path.parent_path());
+    auto tmp = makeTempPath(path.parent_path(), ".tmp");
+    AutoDelete del(tmp, false);
+    writeFile(tmp, data);
+    std::filesystem::rename(tmp, path);
+    del.cancel();
+}
+
+ref<const NarInfoIndexShard> BinaryCacheStore::getNarInfoIndexShard(std::string_view hashPart)
+{
+    auto shardPath = NarInfoIndexShard::shardPath(hashPart);
+
+    {
+        auto shards(narInfoIndexShards.lock());
+        if (auto i = shards->find(shardPath); i != shards->end())
+            return ref(i->second);
+    }
+
+    auto localPath = narInfoIndexCachePath(shardPath);
+
+    std::error_code ec;
+    auto mtime = std::filesystem::last_write_time(localPath, ec);
+    auto ttl = std::chrono::seconds(settings.getNarInfoDiskCacheSettings().ttlNegative.get());
+    if (ec || mtime + ttl <= std::filesystem::file_time_type::clock::now()) {
+        debug("fetching narinfo index shard '%s' from '%s'", shardPath, config.getHumanReadableURI());
+        /* Since the index is complete, a missing shard means that
+           there are no paths with this prefix. */
+        auto data = getFile(shardPath).value_or(NarInfoIndexShard::serialise({}));
+        /* Check the shard before caching it. */
+        NarInfoIndexShard::parse(data);
+        writeCachedShard(localPath, data);
+    }
+
+    auto shard = std::make_shared<const NarInfoIndexShard>(NarInfoIndexShard::open(localPath));
+    narInfoIndexShards.lock()->insert_or_assign(shardPath, shard);
+    return ref(shard);
+}
+
+void BinaryCacheStore::flushNarInfoIndex()
+{
+    auto pending = std::exchange(*pendingNarInfoIndexEntries.lock(), {});
+
+    std::map<std::string, std::vector<NarInfoIndexEntry>> byShard;
+    for (auto & entry : pending) {
+        auto shardPath = NarInfoIndexShard::shardPath(entry.hashPart);
+        byShard[shardPath].push_back(std::move(entry));
+    }
+
+    /* Each shard is read, merged and rewritten as a whole, so a
+       concurrent writer can overwrite our entries (or we theirs)
+       between the read and the upload. Batching the entries keeps
+       that to one rewrite per shard per flush. */
+    for (auto & [shardPath, newEntries] : byShard) {
+        std::vector<NarInfoIndexEntry> entries;
+        if (auto data = getFile(shardPath))
+            entries = NarInfoIndexShard::parse(std::move(*data)).entries();
+        std::move(newEntries.begin(), newEntries.end(), std::back_inserter(entries));
+
+        auto data = NarInfoIndexShard::serialise(std::move(entries));
+        upsertFile(shardPath, std::string(data), "application/octet-stream");
+
+        /* Don't answer subsequent queries from a stale shard. */
+        if (config.useNarInfoIndex) {
+            writeCachedShard(narInfoIndexCachePath(shardPath), data);
+            narInfoIndexShards.lock()->erase(shardPath);
+        }
+    }
+}
+
+void BinaryCacheStore::generateNarInfoIndex()
+{
+    printInfo("generating narinfo index for binary cache '%s'...", config.getHumanReadableURI());
+
+    for (auto & path : queryAllValidPaths()) {
+        checkInterrupt();
+        auto info = queryPathInfo(path).cast<const NarInfo>();
+        pendingNarInfoIndexEntries.lock()->push_back({
+            .hashPart = std::string(path.hashPart()),
+            .narSize = info->narSize,
+            .fileSize = info->fileSize,
+        });
+    }
+
+    flushNarInfoIndex();
+}
+
+StorePathSet BinaryCacheStore::queryValidPaths(const StorePathSet & paths, SubstituteFlag maybeSubstitute)
+{
+    if (!haveNarInfoIndex())
+        return Store::queryValidPaths(paths, maybeSubstitute);
+
+    StorePathSet res;
+    for (auto & path : paths) {
+        checkInterrupt();
+        if (getNarInfoIndexShard(path.hashPart())->lookup(path.hashPart()))
+            res.insert(path);
+    }
+    return res;
+}
+
 bool BinaryCacheStore::isValidPathUncached(const StorePath & storePath)
 {
+    if (haveNarInfoIndex())
+        return getNarInfoIndexShard(storePath.hashPart())->lookup(storePath.hashPart()).has_value();
+
     // FIXME: this only checks whether a .narinfo with a matching hash
     // part exists. So ‘f4kb...-foo’ matches ‘f4kb...-bar’, even
     // though they shouldn't. Not easily fixed.
@@ -546,6 +901,9 @@ void BinaryCacheStore::narFromPath(const StorePath & storePath, Sink & sink)
 {
     auto info = queryPathInfo(storePath).cast<const NarInfo>();
 
+    if (isChunkManifest(*info))
+        return narFromChunks(*info, sink);
+
     /* makeDecompressionSink used to treat empty strings as "none". It seems
        impossible that it would actually end up here with an empty string though
        (since an empty `Compression: ' is treated as bzip2 when parsed from a
@@ -563,6 +921,26 @@ void BinaryCacheStore::narFromPath(const StorePath & storePath, Sink & sink)
     decompressor->finish();
 }
 
+void BinaryCacheStore::getNarFile(const NarInfo & narInfo, Callback<std::optional<std::string>> callback) noexcept
+{
+    if (isChunkManifest(narInfo))
+        return callback(std::nullopt);
+
+    auto callbackPtr = std::make_shared<decltype(callback)>(std::move(callback));
+
+    getFile(narInfo.url, {[callbackPtr, url = narInfo.url, this](std::future<std::optional<std::string>> fut) {
+                try {
+                    auto data = fut.get();
+                    if (!data)
+                        throw SubstituteGone(
+                            "file '%s' does not exist in binary cache '%s'", url, config.getHumanReadableURI());
+                    (*callbackPtr)(std::move(data));
+                } catch (...) {
+                    callbackPtr->rethrow();
+                }
+            }});
+}
+
 void BinaryCacheStore::queryPathInfoUncached(
     const StorePath & storePath, Callback<std::shared_ptr<const ValidPathInfo>> callback) noexcept
 {
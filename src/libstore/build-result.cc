@@ -162,6 +162,24 @@ void adl_serializer<nix::BuildResult>::to_json(json & res, const nix::BuildResul
     if (br.cpuSystem.has_value()) {
         res["cpuSystem"] = br.cpuSystem->count();
     }
+    if (br.memoryPeak.has_value()) {
+        res["memoryPeak"] = *br.memoryPeak;
+    }
+    if (br.ioRead.has_value()) {
+        res["ioRead"] = *br.ioRead;
+    }
+    if (br.ioWrite.has_value()) {
+        res["ioWrite"] = *br.ioWrite;
+    }
+    if (br.cpuPressure.has_value()) {
+        res["cpuPressure"] = br.cpuPressure->count();
+    }
+    if (br.memoryPressure.has_value()) {
+        res["memoryPressure"] = br.memoryPressure->count();
+    }
+    if (br.ioPressure.has_value()) {
+        res["ioPressure"] = br.ioPressure->count();
+    }
 
     // Handle success or failure variant
     std::visit(
@@ -200,6 +218,24 @@ nix::BuildResult adl_serializer<nix::BuildResult>::from_json(const json & _json)
     if (auto cpuSystem = optionalValueAt(json, "cpuSystem")) {
         br.cpuSystem = std::chrono::microseconds(getUnsigned(*cpuSystem));
     }
+    if (auto memoryPeak = optionalValueAt(json, "memoryPeak")) {
+        br.memoryPeak = getUnsigned(*memoryPeak);
+    }
+    if (auto ioRead = optionalValueAt(json, "ioRead")) {
+        br.ioRead = getUnsigned(*ioRead);
+    }
+    if (auto ioWrite = optionalValueAt(json, "ioWrite")) {
+        br.ioWrite = getUnsigned(*ioWrite);
+    }
+    if (auto cpuPressure = optionalValueAt(json, "cpuPressure")) {
+        br.cpuPressure = std::chrono::microseconds(getUnsigned(*cpuPressure));
+    }
+    if (auto memoryPressure = optionalValueAt(json, "memoryPressure")) {
+        br.memoryPressure = std::chrono::microseconds(getUnsigned(*memoryPressure));
+    }
+    if (auto ioPressure = optionalValueAt(json, "ioPressure")) {
+        br.ioPressure = std::chrono::microseconds(getUnsigned(*ioPressure));
+    }
 
     // Determine success or failure based on success field
     bool success = getBoolean(valueAt(json, "success"));
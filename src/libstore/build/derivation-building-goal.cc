@@ -232,6 +232,41 @@ struct LogFile
     ~LogFile();
 };
 
+#ifndef _WIN32 // TODO enable `DerivationBuilder` on Windows
+/**
+ * The lock files of the `global-max-jobs` build slots that are shared
+ * by all processes building in the store with state directory
+ * `stateDir`.
+ */
+static std::vector<std::filesystem::path>
+buildSlotLockFiles(const std::filesystem::path & stateDir, unsigned int globalMaxJobs)
+{
+    auto slotsDir = stateDir / "build-slots";
+    createDirs(slotsDir);
+
+    std::vector<std::filesystem::path> lockFiles;
+    for (unsigned int slot = 0; slot < globalMaxJobs; ++slot)
+        lockFiles.push_back(slotsDir / std::to_string(slot));
+    return lockFiles;
+}
+
+/**
+ * Lock one of the build slots without waiting. The slot is held until
+ * the returned descriptor is closed. Returns an invalid descriptor if
+ * all slots are taken.
+ */
+static AutoCloseFD acquireBuildSlot(const std::vector<std::filesystem::path> & lockFiles)
+{
+    for (auto & lockFile_ : lockFiles) {
+        auto fd = openLockFile(lockFile_, true);
+        if (lockFile(fd.get(), ltWrite, false))
+            return fd;
+    }
+
+    return {};
+}
+#endif
+
 struct LocalBuildRejection
 {
     bool maxJobsZero = false;
@@ -393,8 +428,8 @@ Goal::Co DerivationBuildingGoal::tryToBuild(StorePathSet inputPaths)
          *
          * The locks are automatically released when the caller's `PathLocks` goes
          * out of scope, including on exception unwinding.  If we can't acquire the lock, then
-         * continue; hopefully some other goal can start a build, and if not, the
-         * main loop will sleep a few seconds and then retry this goal.
+         * continue; hopefully some other goal can start a build, and this goal is
+         * woken up to retry once the holder of the lock releases it.
          */
         std::set<std::filesystem::path> lockFiles;
         /* FIXME: Should lock something like the drv itself so we don't build same
@@ -426,10 +461,11 @@ Goal::Co DerivationBuildingGoal::tryToBuild(StorePathSet inputPaths)
                 fmt("waiting for lock on %s",
                     Magenta(concatMapStringsSep(", ", lockFiles, [](auto & p) { return "'" + p.string() + "'"; }))));
 
-            /* Wait then try locking again, repeat until success (returned
-               boolean is true). */
+            /* Wait until the locks are released, then try locking
+               again, repeat until success (returned boolean is
+               true). */
             do {
-                co_await waitForAWhile();
+                co_await waitForLocks(lockFiles);
             } while (!outputLocks.lockPaths(lockFiles, "", false));
         }
 
@@ -854,6 +890,10 @@ Goal::Co DerivationBuildingGoal::buildLocally(
     DerivationBuilderUnique builder;
     Descriptor builderOut;
 
+    /* The build slot that counts this build towards
+       `global-max-jobs`. */
+    AutoCloseFD buildSlot;
+
     // Will continue here while waiting for a build user below
     while (true) {
 
@@ -976,9 +1016,28 @@ Goal::Co DerivationBuildingGoal::buildLocally(
                                 std::move(params));
         }
 
+        if (auto globalMaxJobs = localBuildCap.localStore.config->getLocalSettings().globalMaxJobs.get();
+            globalMaxJobs && !buildSlot) {
+            auto slotLockFiles = buildSlotLockFiles(localBuildCap.localStore.config->getStateDir(), globalMaxJobs);
+            buildSlot = acquireBuildSlot(slotLockFiles);
+            if (!buildSlot) {
+                if (!actLock)
+                    actLock = std::make_unique<Activity>(
+                        *logger,
+                        lvlWarn,
+                        actBuildWaiting,
+                        fmt("waiting for a free build slot for '%s'", Magenta(worker.store.printStorePath(drvPath))));
+                co_await waitForAnyLock(std::move(slotLockFiles), buildSlot);
+                continue;
+            }
+        }
+
         if (auto builderOutOpt = builder->startBuild()) {
             builderOut = *std::move(builderOutOpt);
         } else {
+            /* Don't keep other builds from running while we wait for
+               a build user. */
+            buildSlot.close();
             if (!actLock)
                 actLock = std::make_unique<Activity>(
                     *logger,
@@ -1024,11 +1083,32 @@ Goal::Co DerivationBuildingGoal::buildLocally(
 
     trace("build done");
 
+    /* Report the resources that the builder used in the JSON log,
+       so that schedulers can learn the footprint of a derivation. */
+    auto reportResources = [&]() {
+        if (!buildResult.memoryPeak && !buildResult.ioRead && !buildResult.cpuPressure)
+            return;
+        auto usec = [](const std::optional<std::chrono::microseconds> & t) -> uint64_t {
+            return t ? t->count() : 0;
+        };
+        buildLog->act->result(
+            resBuildResources,
+            buildResult.memoryPeak.value_or(0),
+            buildResult.ioRead.value_or(0),
+            buildResult.ioWrite.value_or(0),
+            usec(buildResult.cpuPressure),
+            usec(buildResult.memoryPressure),
+            usec(buildResult.ioPressure));
+    };
+
     SingleDrvOutputs builtOutputs;
     try {
         builtOutputs = builder->unprepareBuild();
+        reportResources();
     } catch (BuilderFailureError & e) {
+        reportResources();
         builder.reset();
+        buildSlot.close();
 
         /* External builder declined; build locally if this host can. */
         if (localBuildCap.externalBuilder && WIFEXITED(e.builderStatus)
@@ -1056,12 +1136,15 @@ Goal::Co DerivationBuildingGoal::buildLocally(
         outputLocks.unlock();
         co_return doneFailure(fixupBuilderFailureErrorMessage(std::move(e), *buildLog));
     } catch (BuildError & e) {
+        reportResources();
         builder.reset();
+        buildSlot.close();
         outputLocks.unlock();
         co_return doneFailure(std::move(e));
     }
     {
         builder.reset();
+        buildSlot.close();
         StorePathSet outputPaths;
         /* In the check case we install no store objects, and so
            `builtOutputs` is empty. However, per issue #14287, there is
@@ -1,6 +1,10 @@
 #include "nix/store/build/goal.hh"
 #include "nix/store/build/worker.hh"
 #include "nix/store/worker-settings.hh"
+#include "nix/store/pathlocks.hh"
+#include "nix/util/sync.hh"
+
+#include <thread>
 
 namespace nix {
 
@@ -313,6 +317,95 @@ Goal::Co Goal::waitForAWhile()
     co_return Return{};
 }
 
+Goal::Co Goal::waitForLocks(std::set<std::filesystem::path> paths)
+{
+    /* Blocking on a lock is the only way to be notified when another
+       process releases it, so do that in a thread. The thread is
+       detached, because it can't be cancelled: if the goal or the
+       Worker die first, it just exits once the locks are released. */
+    std::thread([paths = std::move(paths),
+                 weakGoal = weak_from_this(),
+                 maybeWaker = worker.getCrossThreadWaker()]() {
+        try {
+            for (auto & path : paths) {
+                auto lockPath = path;
+                lockPath += ".lock";
+                /* A shared lock doesn't block the other goals waiting
+                   for the same lock. A missing lock file isn't
+                   locked. */
+                if (auto fd = openLockFile(lockPath, false); fd && lockFile(fd.get(), ltRead, true))
+                    lockFile(fd.get(), ltNone, false);
+            }
+        } catch (...) {
+            /* No exception may leave the thread, not even
+               `Interrupted`. Wake the goal regardless: it finds out
+               about the failure (or the interrupt) by trying to lock
+               the paths itself. */
+            ignoreExceptionInDestructor(lvlDebug);
+        }
+
+        try {
+            if (auto waker = maybeWaker.lock())
+                waker->enqueue(weakGoal);
+        } catch (...) {
+            ignoreExceptionInDestructor();
+        }
+    }).detach();
+
+    co_await waitUntilWoken();
+    co_return Return{};
+}
+
+Goal::Co Goal::waitForAnyLock(std::vector<std::filesystem::path> lockFiles, AutoCloseFD & acquired)
+{
+    /* Block on every lock in its own thread, since there is no way
+       to block on several `flock`s at once. The first thread to get
+       its lock hands it over and wakes the goal; the others release
+       theirs straight away, so the goal is woken only once. Like in
+       `waitForLocks`, the threads are detached. */
+    struct State
+    {
+        AutoCloseFD acquired;
+        bool woken = false;
+    };
+
+    auto state = std::make_shared<Sync<State>>();
+
+    for (auto & lockFile_ : lockFiles) {
+        std::thread([lockFile_, state, weakGoal = weak_from_this(), maybeWaker = worker.getCrossThreadWaker()]() {
+            AutoCloseFD fd;
+            try {
+                fd = openLockFile(lockFile_, true);
+                if (!lockFile(fd.get(), ltWrite, true))
+                    fd.close();
+            } catch (...) {
+                /* Wake the goal regardless, it retries by itself. */
+                ignoreExceptionInDestructor(lvlDebug);
+                fd.close();
+            }
+
+            {
+                auto state_(state->lock());
+                if (state_->woken)
+                    return;
+                state_->woken = true;
+                state_->acquired = std::move(fd);
+            }
+
+            try {
+                if (auto waker = maybeWaker.lock())
+                    waker->enqueue(weakGoal);
+            } catch (...) {
+                ignoreExceptionInDestructor();
+            }
+        }).detach();
+    }
+
+    co_await waitUntilWoken();
+    acquired = std::move(state->lock()->acquired);
+    co_return Return{};
+}
+
 Goal::Co Goal::waitUntilWoken()
 {
     worker.waitForCompletion(shared_from_this());
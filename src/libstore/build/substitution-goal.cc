@@ -1,4 +1,5 @@
 #include "goal-impl.hh"
+#include "substitution-pipeline.hh"
 
 #include "nix/store/build/worker.hh"
 #include "nix/store/build/substitution-goal.hh"
@@ -206,59 +207,34 @@ Goal::Co PathSubstitutionGoal::tryToRun(
     auto maintainRunningSubstitutions = std::make_unique<MaintainCount<uint64_t>>(worker.runningSubstitutions);
     worker.updateProgress();
 
-    auto promise = std::promise<void>();
-    auto future = promise.get_future();
-
-    /* Be careful with ownership. cleanup() doesn't signal the worker thread
-       to cleanly shutdown, so the worker can die while the thread is still
-       running. That's why we use weak_ptr for everything that is owned by the
+    /* Be careful with ownership. cleanup() doesn't cancel the
+       substitution, so the worker can die while it is still running.
+       That's why we use weak_ptr for everything that is owned by the
        Worker. */
-    thr = std::thread([weakGoal = weak_from_this(),
-                       promise = std::move(promise),
-                       subPath,
-                       storePath = storePath,
-                       repair = repair,
-                       sub,
-                       maybeWaker = worker.getCrossThreadWaker(),
-                       maybeWorkerStore = worker.store.weak_from_this()]() mutable {
-        try {
-            ReceiveInterrupts receiveInterrupts;
-
-            /* The Worker might have died while we were starting up. */
-            auto workerStore = maybeWorkerStore.lock();
-            if (!workerStore)
-                return;
-
-            Activity act(
-                *logger,
-                actSubstitute,
-                std::to_array<Logger::Field>(
-                    {workerStore->printStorePath(storePath), sub->config.getHumanReadableURI()}));
-            PushActivity pact(act.id);
-
-            copyStorePath(*sub, *workerStore, subPath, repair, sub->config.isTrusted ? NoCheckSigs : CheckSigs);
-
-            promise.set_value();
-        } catch (...) {
-            promise.set_exception(std::current_exception());
-        }
-
-        /* The Worker might have already died (and the waker with it) by the
-           time we finished. N.B. if enqueueing to the waker throws, we better
-           std::terminate, since something has gone very wrong. This intentionally
-           lets the thread crash on exceptions for that reason. */
-        if (auto waker = maybeWaker.lock())
-            waker->enqueue(weakGoal);
-    });
+    substitution = worker.getSubstitutionPipeline().enqueue(
+        {
+            .sub = sub,
+            .subPath = subPath,
+            .storePath = storePath,
+            .info = info,
+            .dstStore = worker.store.weak_from_this(),
+            .repair = repair,
+        },
+        [weakGoal = weak_from_this(), maybeWaker = worker.getCrossThreadWaker()]() {
+            /* The Worker might have already died (and the waker with
+               it) by the time we finished. */
+            if (auto waker = maybeWaker.lock())
+                waker->enqueue(weakGoal);
+        });
 
     /* Use up the substitution slot. */
     worker.childStarted(shared_from_this(), /*channels=*/{}, /*inBuildSlot=*/true, /*respectTimeouts=*/false);
-    /* Suspend until the thread finishes. */
+    /* Suspend until the substitution finishes. */
     co_await waitUntilWoken();
 
     trace("substitute finished");
 
-    thr.join();
+    auto future = std::move(substitution);
     worker.childTerminated(this);
 
     try {
@@ -309,9 +285,9 @@ Goal::Co PathSubstitutionGoal::tryToRun(
 void PathSubstitutionGoal::cleanup()
 {
     try {
-        if (thr.joinable()) {
-            // FIXME: signal worker thread to quit.
-            thr.join();
+        if (substitution.valid()) {
+            // FIXME: cancel the substitution.
+            substitution = {};
             worker.childTerminated(this, JobCategory::Substitution);
         }
     } catch (...) {
@@ -0,0 +1,214 @@
+#include "substitution-pipeline.hh"
+
+#include "nix/store/http-binary-cache-store.hh"
+#include "nix/store/nar-info.hh"
+#include "nix/util/callback.hh"
+#include "nix/util/compression.hh"
+#include "nix/util/logging.hh"
+#include "nix/util/signals.hh"
+
+#include <boost/asio/post.hpp>
+
+#include <array>
+#include <thread>
+
+namespace nix {
+
+struct SubstitutionPipeline::Job
+{
+    Request request;
+
+    fun<void()> onDone;
+
+    std::promise<void> promise;
+
+    /**
+     * The `actSubstitute` activity. The download and the copy are
+     * its children.
+     */
+    std::unique_ptr<Activity> act;
+
+    /**
+     * Set if the NAR is fetched ahead of time, in which case it
+     * takes up `narInfo->fileSize` bytes of the buffer until the job
+     * is done.
+     */
+    std::shared_ptr<const NarInfo> narInfo;
+
+    /**
+     * The compressed NAR, or `std::nullopt` if it must be downloaded
+     * while it's imported after all.
+     */
+    std::optional<std::string> compressedNar;
+
+    std::exception_ptr fetchError;
+};
+
+SubstitutionPipeline::SubstitutionPipeline(unsigned int importJobs, uint64_t bufferSize)
+    : bufferSize(bufferSize)
+    , importers(importJobs ? importJobs : std::max(1U, std::thread::hardware_concurrency()))
+{
+}
+
+SubstitutionPipeline::~SubstitutionPipeline()
+{
+    shutdown();
+}
+
+void SubstitutionPipeline::shutdown()
+{
+    std::deque<std::shared_ptr<Job>> waiting;
+    {
+        auto state(state_.lock());
+        state->quit = true;
+        std::swap(waiting, state->waiting);
+    }
+
+    importers.stop();
+    importers.join();
+
+    auto state(state_.lock());
+    state.wait(streamersDone, [&] { return state->streamers == 0; });
+}
+
+std::future<void> SubstitutionPipeline::enqueue(Request request, fun<void()> onDone)
+{
+    auto job = std::make_shared<Job>(Job{.request = std::move(request), .onDone = std::move(onDone)});
+    auto future = job->promise.get_future();
+    auto & req = job->request;
+
+    if (auto dstStore = req.dstStore.lock())
+        job->act = std::make_unique<Activity>(
+            *logger,
+            actSubstitute,
+            std::to_array<Logger::Field>(
+                {dstStore->printStorePath(req.storePath), req.sub->config.getHumanReadableURI()}));
+
+    /* Only HTTP binary caches fetch files without blocking the
+       calling thread. Fetching from other substituters ahead of time
+       wouldn't gain anything over doing it while importing. Chunked
+       NARs are fetched chunk by chunk while importing, so they
+       wouldn't be buffered either. */
+    auto narInfo = std::dynamic_pointer_cast<const NarInfo>(req.info);
+    if (dynamic_cast<HttpBinaryCacheStore *>(&*req.sub) && narInfo && narInfo->path == req.subPath
+        && !BinaryCacheStore::isChunkManifest(*narInfo) && narInfo->fileSize && narInfo->fileSize <= bufferSize) {
+        job->narInfo = narInfo;
+        {
+            auto state(state_.lock());
+            if (!state->waiting.empty() || state->bytesBuffered + narInfo->fileSize > bufferSize) {
+                state->waiting.push_back(job);
+                return future;
+            }
+            state->bytesBuffered += narInfo->fileSize;
+        }
+        fetch(job);
+    } else
+        stream(job);
+
+    return future;
+}
+
+void SubstitutionPipeline::stream(std::shared_ptr<Job> job)
+{
+    /* The download blocks the thread for as long as it takes, so
+       don't hold up an import thread. The number of these threads is
+       limited by `max-substitution-jobs`, since each one uses up the
+       substitution slot of its goal. */
+    state_.lock()->streamers++;
+    std::thread([this, job] {
+        import(job);
+        auto state(state_.lock());
+        state->streamers--;
+        streamersDone.notify_all();
+    }).detach();
+}
+
+void SubstitutionPipeline::fetch(std::shared_ptr<Job> job)
+{
+    /* Make the download a child of the substitution, as it is when
+       the NAR is downloaded while importing it. */
+    std::optional<PushActivity> pact;
+    if (job->act)
+        pact.emplace(job->act->id);
+
+    auto & binaryCache = dynamic_cast<BinaryCacheStore &>(*job->request.sub);
+    binaryCache.getNarFile(
+        *job->narInfo, {[job, weakThis = weak_from_this()](std::future<std::optional<std::string>> fut) {
+            try {
+                job->compressedNar = fut.get();
+            } catch (...) {
+                job->fetchError = std::current_exception();
+            }
+            /* This runs on the download thread, so hand the job over
+               to an import thread. */
+            if (auto self = weakThis.lock())
+                boost::asio::post(self->importers, [self = self.get(), job] { self->import(job); });
+        }});
+}
+
+void SubstitutionPipeline::import(std::shared_ptr<Job> job)
+{
+    auto & req = job->request;
+    std::exception_ptr ex;
+
+    try {
+        ReceiveInterrupts receiveInterrupts;
+
+        if (job->fetchError)
+            std::rethrow_exception(job->fetchError);
+
+        /* The Worker might have died in the meantime. */
+        auto dstStore = req.dstStore.lock();
+        if (!dstStore)
+            throw Error("substitution of '%s' was cancelled", req.sub->printStorePath(req.subPath));
+
+        std::optional<PushActivity> pact;
+        if (job->act)
+            pact.emplace(job->act->id);
+
+        auto checkSigs = req.sub->config.isTrusted ? NoCheckSigs : CheckSigs;
+
+        if (job->compressedNar)
+            copyStorePath(*req.sub, *dstStore, req.subPath, req.repair, checkSigs, [&](Sink & sink) {
+                auto decompressor =
+                    makeDecompressionSink(job->narInfo->compression.value_or(CompressionAlgo::none), sink);
+                (*decompressor)(*job->compressedNar);
+                decompressor->finish();
+            });
+        else
+            copyStorePath(*req.sub, *dstStore, req.subPath, req.repair, checkSigs);
+    } catch (...) {
+        ex = std::current_exception();
+    }
+
+    /* Make room for the next fetches before waking up the goal. */
+    if (job->narInfo) {
+        job->compressedNar.reset();
+
+        std::vector<std::shared_ptr<Job>> ready;
+        {
+            auto state(state_.lock());
+            state->bytesBuffered -= job->narInfo->fileSize;
+            while (!state->quit && !state->waiting.empty()
+                   && state->bytesBuffered + state->waiting.front()->narInfo->fileSize <= bufferSize) {
+                state->bytesBuffered += state->waiting.front()->narInfo->fileSize;
+                ready.push_back(std::move(state->waiting.front()));
+                state->waiting.pop_front();
+            }
+        }
+
+        for (auto & job2 : ready)
+            fetch(job2);
+    }
+
+    job->act.reset();
+
+    if (ex)
+        job->promise.set_exception(ex);
+    else
+        job->promise.set_value();
+
+    job->onDone();
+}
+
+} // namespace nix
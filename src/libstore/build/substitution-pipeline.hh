@@ -0,0 +1,124 @@
+#pragma once
+///@file
+
+#include "nix/store/store-api.hh"
+#include "nix/util/sync.hh"
+
+#include <boost/asio/thread_pool.hpp>
+
+#include <deque>
+#include <future>
+
+namespace nix {
+
+/**
+ * Copies substitutes into the store in two stages, so that a
+ * substitution doesn't need a thread of its own:
+ *
+ * 1. Fetching: the compressed NAR is downloaded from an HTTP binary
+ *    cache into memory by `FileTransfer`, which doesn't block any
+ *    thread. The total size of the NARs being fetched or waiting to
+ *    be imported is limited by `substitution-buffer-size`.
+ *
+ * 2. Importing: the NAR is decompressed and added to the destination
+ *    store by a pool of `substitution-import-jobs` threads.
+ *
+ * Substitutes that can't be fetched ahead of time (from other kinds
+ * of substituters, or chunked or too large) skip both stages. They
+ * are downloaded while they're imported, like `copyStorePath()` does,
+ * in a thread of their own.
+ */
+struct SubstitutionPipeline : std::enable_shared_from_this<SubstitutionPipeline>
+{
+    struct Request
+    {
+        ref<Store> sub;
+
+        /**
+         * The path as the substituter calls it.
+         */
+        StorePath subPath;
+
+        /**
+         * The path in the destination store.
+         */
+        StorePath storePath;
+
+        std::shared_ptr<const ValidPathInfo> info;
+
+        /**
+         * The destination store. This is a weak pointer, because it
+         * is owned by the `Worker`.
+         */
+        std::weak_ptr<Store> dstStore;
+
+        RepairFlag repair;
+    };
+
+    /**
+     * @param importJobs The number of import threads, or 0 for the
+     * number of CPU cores.
+     *
+     * @param bufferSize The maximum total size of the NARs that have
+     * been fetched ahead of time.
+     */
+    SubstitutionPipeline(unsigned int importJobs, uint64_t bufferSize);
+
+    ~SubstitutionPipeline();
+
+    /**
+     * Start copying `request.subPath` from `request.sub` into
+     * `request.dstStore`. `onDone` is called from another thread
+     * when the returned future is ready.
+     */
+    std::future<void> enqueue(Request request, fun<void()> onDone);
+
+    /**
+     * Wait for the running imports and downloads to finish and
+     * discard the queued ones. Their futures are broken and their
+     * `onDone` isn't called.
+     */
+    void shutdown();
+
+private:
+
+    struct Job;
+
+    struct State
+    {
+        /**
+         * The total size of the NARs that are being fetched or that
+         * are waiting to be imported.
+         */
+        uint64_t bytesBuffered = 0;
+
+        /**
+         * Jobs waiting for room in the buffer.
+         */
+        std::deque<std::shared_ptr<Job>> waiting;
+
+        /**
+         * The number of threads started by `stream()` that are still
+         * running.
+         */
+        size_t streamers = 0;
+
+        bool quit = false;
+    };
+
+    const uint64_t bufferSize;
+
+    Sync<State> state_;
+
+    std::condition_variable streamersDone;
+
+    boost::asio::thread_pool importers;
+
+    void fetch(std::shared_ptr<Job> job);
+
+    void import(std::shared_ptr<Job> job);
+
+    void stream(std::shared_ptr<Job> job);
+};
+
+} // namespace nix
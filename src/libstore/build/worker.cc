@@ -8,6 +8,7 @@
 #include "nix/store/build/derivation-resolution-goal.hh"
 #include "nix/store/build/derivation-building-goal.hh"
 #include "nix/store/build/derivation-trampoline-goal.hh"
+#include "substitution-pipeline.hh"
 #ifndef _WIN32 // TODO Enable building on Windows
 #  include "nix/store/build/hook-instance.hh"
 #endif
@@ -50,6 +51,10 @@ Worker::~Worker()
        their destructors). */
     topGoals.clear();
 
+    /* Wait for the substitutions that the goals left behind. */
+    if (substitutionPipeline)
+        substitutionPipeline->shutdown();
+
     assert(expectedSubstitutions == 0);
     assert(expectedDownloadSize == 0);
     assert(expectedNarSize == 0);
@@ -521,6 +526,14 @@ std::weak_ptr<Worker::Waker> Worker::getCrossThreadWaker()
     return wakerState.get_ptr();
 }
 
+SubstitutionPipeline & Worker::getSubstitutionPipeline()
+{
+    if (!substitutionPipeline)
+        substitutionPipeline =
+            std::make_shared<SubstitutionPipeline>(settings.substitutionImportJobs, settings.substitutionBufferSize);
+    return *substitutionPipeline;
+}
+
 void Worker::Waker::wakeAll(Worker & worker)
 {
     /* Wake up all goals that have been enqueued by asynchronous completion callbacks. */
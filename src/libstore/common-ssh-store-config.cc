@@ -19,6 +19,7 @@ SSHMaster CommonSSHStoreConfig::createSSHMaster(bool useMaster, Descriptor logFD
         sshPublicHostKey.get(),
         useMaster,
         compress,
+        controlPersist,
         logFD,
     };
 }
@@ -0,0 +1,307 @@
+#include "nix/store/daemon-stats.hh"
+#include "nix/util/error.hh"
+#include "nix/util/json-utils.hh"
+
+#include <atomic>
+#include <bit>
+#include <cmath>
+#include <new>
+
+#ifndef _WIN32
+#  include <sys/mman.h>
+#endif
+
+namespace nix::daemon {
+
+std::string_view opName(WorkerProto::Op op)
+{
+    switch (op) {
+#define NIX_DAEMON_OP(name)      \
+    case WorkerProto::Op::name: \
+        return #name;
+        NIX_DAEMON_OP(IsValidPath)
+        NIX_DAEMON_OP(QueryReferrers)
+        NIX_DAEMON_OP(AddToStore)
+        NIX_DAEMON_OP(AddTextToStore)
+        NIX_DAEMON_OP(BuildPaths)
+        NIX_DAEMON_OP(EnsurePath)
+        NIX_DAEMON_OP(AddTempRoot)
+        NIX_DAEMON_OP(AddIndirectRoot)
+        NIX_DAEMON_OP(SyncWithGC)
+        NIX_DAEMON_OP(FindRoots)
+        NIX_DAEMON_OP(QueryDeriver)
+        NIX_DAEMON_OP(SetOptions)
+        NIX_DAEMON_OP(CollectGarbage)
+        NIX_DAEMON_OP(QuerySubstitutablePathInfo)
+        NIX_DAEMON_OP(QueryDerivationOutputs)
+        NIX_DAEMON_OP(QueryAllValidPaths)
+        NIX_DAEMON_OP(QueryPathInfo)
+        NIX_DAEMON_OP(QueryDerivationOutputNames)
+        NIX_DAEMON_OP(QueryPathFromHashPart)
+        NIX_DAEMON_OP(QuerySubstitutablePathInfos)
+        NIX_DAEMON_OP(QueryValidPaths)
+        NIX_DAEMON_OP(QuerySubstitutablePaths)
+        NIX_DAEMON_OP(QueryValidDerivers)
+        NIX_DAEMON_OP(OptimiseStore)
+        NIX_DAEMON_OP(VerifyStore)
+        NIX_DAEMON_OP(BuildDerivation)
+        NIX_DAEMON_OP(AddSignatures)
+        NIX_DAEMON_OP(NarFromPath)
+        NIX_DAEMON_OP(AddToStoreNar)
+        NIX_DAEMON_OP(QueryMissing)
+        NIX_DAEMON_OP(QueryDerivationOutputMap)
+        NIX_DAEMON_OP(RegisterDrvOutput)
+        NIX_DAEMON_OP(QueryRealisation)
+        NIX_DAEMON_OP(AddMultipleToStore)
+        NIX_DAEMON_OP(AddBuildLog)
+        NIX_DAEMON_OP(BuildPathsWithResults)
+        NIX_DAEMON_OP(AddPermRoot)
+        NIX_DAEMON_OP(SubmitOutput)
+        NIX_DAEMON_OP(AddToStoreScanning)
+        NIX_DAEMON_OP(QueryDaemonStats)
+#undef NIX_DAEMON_OP
+    }
+    return "Unknown";
+}
+
+namespace {
+
+/**
+ * Operations have small numbers, except for the ones that are only
+ * enabled by protocol features, which start at 1000. Map both ranges
+ * to a fixed number of slots.
+ */
+constexpr uint64_t nrBaseOps = 64, nrFeatureOps = 16, featureOpsStart = 1000;
+
+constexpr size_t nrOpSlots = nrBaseOps + nrFeatureOps;
+
+std::optional<size_t> opSlot(uint64_t op)
+{
+    if (op < nrBaseOps)
+        return op;
+    if (op >= featureOpsStart && op < featureOpsStart + nrFeatureOps)
+        return nrBaseOps + (op - featureOpsStart);
+    return std::nullopt;
+}
+
+uint64_t slotOp(size_t slot)
+{
+    return slot < nrBaseOps ? slot : featureOpsStart + (slot - nrBaseOps);
+}
+
+struct OpCounters
+{
+    std::atomic<uint64_t> count, bytesIn, bytesOut, totalMicros;
+    std::array<std::atomic<uint64_t>, Stats::nrLatencyBuckets> latencyBuckets;
+};
+
+/**
+ * Must be usable from several processes, so only lock-free atomics
+ * are allowed here.
+ */
+struct Counters
+{
+    std::array<OpCounters, nrOpSlots> ops;
+    std::atomic<uint64_t> sqliteBusyRetries, stateLockWaits, stateLockWaitMicros;
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free);
+
+Counters processCounters;
+
+Counters * counters = &processCounters;
+
+void add(std::atomic<uint64_t> & counter, uint64_t n)
+{
+    counter.fetch_add(n, std::memory_order_relaxed);
+}
+
+uint64_t get(const std::atomic<uint64_t> & counter)
+{
+    return counter.load(std::memory_order_relaxed);
+}
+
+uint64_t toMicros(std::chrono::steady_clock::duration duration)
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+}
+
+} // namespace
+
+uint64_t Stats::Op::latencyPercentile(double p) const
+{
+    if (!count)
+        return 0;
+    auto target = std::max<uint64_t>(1, std::ceil(p * count));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < nrLatencyBuckets; ++i) {
+        seen += latencyBuckets[i];
+        if (seen >= target)
+            return uint64_t(1) << i;
+    }
+    return uint64_t(1) << (nrLatencyBuckets - 1);
+}
+
+void initSharedStats()
+{
+#ifndef _WIN32
+    auto p = mmap(nullptr, sizeof(Counters), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED)
+        throw SysError("allocating shared memory for daemon statistics");
+    counters = new (p) Counters();
+#endif
+}
+
+void recordOp(WorkerProto::Op op, std::chrono::steady_clock::duration duration, uint64_t bytesIn, uint64_t bytesOut)
+{
+    auto slot = opSlot(static_cast<uint64_t>(op));
+    if (!slot)
+        return;
+    auto & c = counters->ops[*slot];
+    auto micros = toMicros(duration);
+    add(c.count, 1);
+    add(c.bytesIn, bytesIn);
+    add(c.bytesOut, bytesOut);
+    add(c.totalMicros, micros);
+    add(c.latencyBuckets[std::min<size_t>(std::bit_width(micros), Stats::nrLatencyBuckets - 1)], 1);
+}
+
+void recordSQLiteBusyRetry()
+{
+    add(counters->sqliteBusyRetries, 1);
+}
+
+void recordStateLockWait(std::chrono::steady_clock::duration duration)
+{
+    add(counters->stateLockWaits, 1);
+    add(counters->stateLockWaitMicros, toMicros(duration));
+}
+
+Stats getStats()
+{
+    Stats res;
+
+    for (size_t slot = 0; slot < nrOpSlots; ++slot) {
+        auto & c = counters->ops[slot];
+        if (!get(c.count))
+            continue;
+        auto & op = res.ops[std::string(opName(WorkerProto::Op(slotOp(slot))))];
+        op.count += get(c.count);
+        op.bytesIn += get(c.bytesIn);
+        op.bytesOut += get(c.bytesOut);
+        op.totalMicros += get(c.totalMicros);
+        for (size_t i = 0; i < Stats::nrLatencyBuckets; ++i)
+            op.latencyBuckets[i] += get(c.latencyBuckets[i]);
+    }
+
+    res.sqliteBusyRetries = get(counters->sqliteBusyRetries);
+    res.stateLockWaits = get(counters->stateLockWaits);
+    res.stateLockWaitMicros = get(counters->stateLockWaitMicros);
+
+    return res;
+}
+
+static std::string showSeconds(uint64_t micros)
+{
+    return fmt("%g", micros / 1e6);
+}
+
+std::string Stats::toPrometheus() const
+{
+    std::string res;
+
+    auto header = [&](std::string_view name, std::string_view type, std::string_view help) {
+        res += fmt("# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+    };
+
+    header("nix_daemon_op_latency_seconds", "histogram", "Time spent processing daemon operations.");
+    for (auto & [name, op] : ops) {
+        uint64_t cumulative = 0;
+        for (size_t i = 0; i + 1 < nrLatencyBuckets; ++i) {
+            cumulative += op.latencyBuckets[i];
+            res += fmt(
+                "nix_daemon_op_latency_seconds_bucket{op=\"%s\",le=\"%s\"} %d\n",
+                name,
+                showSeconds(uint64_t(1) << i),
+                cumulative);
+        }
+        res += fmt("nix_daemon_op_latency_seconds_bucket{op=\"%s\",le=\"+Inf\"} %d\n", name, op.count);
+        res += fmt("nix_daemon_op_latency_seconds_sum{op=\"%s\"} %s\n", name, showSeconds(op.totalMicros));
+        res += fmt("nix_daemon_op_latency_seconds_count{op=\"%s\"} %d\n", name, op.count);
+    }
+
+    header("nix_daemon_op_received_bytes_total", "counter", "Bytes received from clients by daemon operations.");
+    for (auto & [name, op] : ops)
+        res += fmt("nix_daemon_op_received_bytes_total{op=\"%s\"} %d\n", name, op.bytesIn);
+
+    header("nix_daemon_op_sent_bytes_total", "counter", "Bytes sent to clients by daemon operations.");
+    for (auto & [name, op] : ops)
+        res += fmt("nix_daemon_op_sent_bytes_total{op=\"%s\"} %d\n", name, op.bytesOut);
+
+    header("nix_daemon_sqlite_busy_retries_total", "counter", "SQLite transactions retried because the database was busy.");
+    res += fmt("nix_daemon_sqlite_busy_retries_total %d\n", sqliteBusyRetries);
+
+    header("nix_daemon_state_lock_waits_total", "counter", "Contended acquisitions of the local store state lock.");
+    res += fmt("nix_daemon_state_lock_waits_total %d\n", stateLockWaits);
+
+    header("nix_daemon_state_lock_wait_seconds_total", "counter", "Time spent waiting for the local store state lock.");
+    res += fmt("nix_daemon_state_lock_wait_seconds_total %s\n", showSeconds(stateLockWaitMicros));
+
+    return res;
+}
+
+} // namespace nix::daemon
+
+namespace nlohmann {
+
+using namespace nix;
+using nix::daemon::Stats;
+
+Stats adl_serializer<Stats>::from_json(const json & json0)
+{
+    auto & json = getObject(json0);
+
+    Stats res;
+
+    for (auto & [name, op0] : getObject(valueAt(json, "ops"))) {
+        auto & op1 = getObject(op0);
+        auto & op = res.ops[name];
+        op.count = getUnsigned(valueAt(op1, "count"));
+        op.bytesIn = getUnsigned(valueAt(op1, "bytesIn"));
+        op.bytesOut = getUnsigned(valueAt(op1, "bytesOut"));
+        op.totalMicros = getUnsigned(valueAt(op1, "totalMicros"));
+        auto & buckets = getArray(valueAt(op1, "latencyBuckets"));
+        for (size_t i = 0; i < std::min(buckets.size(), Stats::nrLatencyBuckets); ++i)
+            op.latencyBuckets[i] = getUnsigned(buckets[i]);
+    }
+
+    res.sqliteBusyRetries = getUnsigned(valueAt(json, "sqliteBusyRetries"));
+    res.stateLockWaits = getUnsigned(valueAt(json, "stateLockWaits"));
+    res.stateLockWaitMicros = getUnsigned(valueAt(json, "stateLockWaitMicros"));
+
+    return res;
+}
+
+void adl_serializer<Stats>::to_json(json & json, const Stats & stats)
+{
+    auto ops = json::object();
+    for (auto & [name, op] : stats.ops)
+        ops[name] = {
+            {"count", op.count},
+            {"bytesIn", op.bytesIn},
+            {"bytesOut", op.bytesOut},
+            {"totalMicros", op.totalMicros},
+            {"p50Micros", op.latencyPercentile(0.5)},
+            {"p99Micros", op.latencyPercentile(0.99)},
+            {"latencyBuckets", op.latencyBuckets},
+        };
+
+    json = {
+        {"ops", std::move(ops)},
+        {"sqliteBusyRetries", stats.sqliteBusyRetries},
+        {"stateLockWaits", stats.stateLockWaits},
+        {"stateLockWaitMicros", stats.stateLockWaitMicros},
+    };
+}
+
+} // namespace nlohmann
@@ -1,4 +1,5 @@
 #include "nix/store/daemon.hh"
+#include "nix/store/daemon-stats.hh"
 #include "nix/util/configuration.hh"
 #include "nix/util/file-content-address.hh"
 #include "nix/util/signals.hh"
@@ -29,6 +30,8 @@
 
 #include <sstream>
 
+#include <nlohmann/json.hpp>
+
 namespace nix::daemon {
 
 Sink & operator<<(Sink & sink, std::span<const Logger::Field> fields)
@@ -1103,6 +1106,14 @@ static void performOp(
         break;
     }
 
+    case WorkerProto::Op::QueryDaemonStats: {
+        logger->startWork();
+        auto stats = getStats();
+        logger->stopWork();
+        conn.to << nlohmann::json(stats).dump();
+        break;
+    }
+
     default:
         throw Error("invalid operation %1%", op);
     }
@@ -1206,6 +1217,10 @@ void processConnection(
 
             debug("performing daemon worker op: %d", op);
 
+            auto startTime = std::chrono::steady_clock::now();
+            auto bytesReadBefore = conn.from.read;
+            auto bytesWrittenBefore = conn.to.written;
+
             try {
                 performOp(tunnelLogger, store, trusted, recursive, conn, op, *builder);
             } catch (Error & e) {
@@ -1226,6 +1241,12 @@ void processConnection(
 
             conn.to.flush();
 
+            recordOp(
+                op,
+                std::chrono::steady_clock::now() - startTime,
+                conn.from.read - bytesReadBefore,
+                conn.to.written - bytesWrittenBefore);
+
             assert(!tunnelLogger->state_.lock()->canSendStderr);
         };
 
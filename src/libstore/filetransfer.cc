@@ -204,6 +204,11 @@ struct curlFileTransfer : public FileTransfer
          */
         bool hasContentEncoding:1 = false;
 
+        /**
+         * Whether the `If-Range` header has been added to `requestHeaders`.
+         */
+        bool sentIfRange:1 = false;
+
         /**
          * Server-provided minimum retry delay, parsed from the `Retry-After`
          * response header. Reset on each new HTTP status line, and consumed
@@ -213,6 +218,36 @@ struct curlFileTransfer : public FileTransfer
 
         curl_off_t writtenToSink = 0;
 
+        /**
+         * The `Last-Modified` header of the current response.
+         */
+        std::string lastModified;
+
+        /**
+         * The first byte of the `Content-Range` of the current response.
+         */
+        std::optional<curl_off_t> contentRangeStart;
+
+        /**
+         * The validator (strong `ETag` or `Last-Modified`) of the response
+         * whose body is being written to the sink. Resumed downloads must
+         * have the same validator, so that they continue the same file.
+         */
+        std::string resumeValidator;
+
+        /**
+         * The number of bytes that the sink had already received when this
+         * attempt started.
+         */
+        curl_off_t resumeOffset = 0;
+
+        /**
+         * The number of bytes at the start of the response body that the
+         * sink already received in a previous attempt. This happens when the
+         * server ignores the range and sends the whole file.
+         */
+        curl_off_t skipBytes = 0;
+
         std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
 
         inline static const std::set<long> successfulStatuses{
@@ -261,6 +296,13 @@ struct curlFileTransfer : public FileTransfer
                     /* Only write data to the sink if this is a
                        successful response. */
                     if (successfulStatuses.count(httpStatus)) {
+                        if (skipBytes) {
+                            auto n = std::min<curl_off_t>(skipBytes, data.size());
+                            skipBytes -= n;
+                            data.remove_prefix(n);
+                            if (data.empty())
+                                return;
+                        }
                         writtenToSink += data.size();
                         PauseTransfer needsPause = this->request.dataCallback(data);
                         if (needsPause == PauseTransfer::Yes) {
@@ -393,6 +435,8 @@ struct curlFileTransfer : public FileTransfer
                 acceptRanges = false;
                 hasContentEncoding = false;
                 retryAfterMs = std::nullopt;
+                lastModified = "";
+                contentRangeStart = std::nullopt;
                 appendCurrentUrl();
             } else {
 
@@ -412,6 +456,17 @@ struct curlFileTransfer : public FileTransfer
                     else if (name == "accept-ranges" && toLower(trim(line.substr(i + 1))) == "bytes")
                         acceptRanges = true;
 
+                    else if (name == "last-modified")
+                        lastModified = trim(line.substr(i + 1));
+
+                    else if (name == "content-range") {
+                        auto value = trim(line.substr(i + 1));
+                        static std::regex contentRangeRegex(
+                            "bytes +([0-9]+)-.*", std::regex::extended | std::regex::icase);
+                        if (std::smatch match; std::regex_match(value, match, contentRangeRegex))
+                            contentRangeStart = string2Int<curl_off_t>(match.str(1));
+                    }
+
                     else if (name == "link" || name == "x-amz-meta-link") {
                         auto value = trim(line.substr(i + 1));
                         static std::regex linkRegex(
@@ -435,6 +490,9 @@ struct curlFileTransfer : public FileTransfer
                         }
                     }
                 }
+
+                else if (trim(line).empty())
+                    headersDone();
             }
             return realSize;
         } catch (...) {
@@ -444,6 +502,64 @@ struct curlFileTransfer : public FileTransfer
             return CURL_WRITEFUNC_ERROR;
         }
 
+        /**
+         * The strong validator of the current response, if any.
+         */
+        std::string currentValidator() const
+        {
+            if (!result.etag.empty() && !hasPrefix(result.etag, "W/"))
+                return result.etag;
+            return lastModified;
+        }
+
+        /**
+         * Called at the end of the headers of each response. Makes sure that
+         * the body of a resumed download continues what the sink has already
+         * received.
+         */
+        void headersDone()
+        {
+            if (!request.dataCallback)
+                return;
+
+            auto httpStatus = getHTTPStatus();
+
+            if (!resumeOffset) {
+                if (httpStatus == HttpStatus::Ok)
+                    resumeValidator = currentValidator();
+                return;
+            }
+
+            if (httpStatus == HttpStatus::PartialContent) {
+                if (contentRangeStart != resumeOffset || hasContentEncoding)
+                    throw FileTransferError(
+                        Misc,
+                        {},
+                        "cannot resume the %s of '%s': server did not resume it at offset %d",
+                        request.noun(),
+                        request.displayUri(),
+                        resumeOffset);
+            }
+
+            else if (httpStatus == HttpStatus::Ok) {
+                /* The server ignored the range, or the file has changed
+                   (with `If-Range`). If it is the same file, we can
+                   still continue by skipping what we already have. */
+                if (resumeValidator.empty() || currentValidator() != resumeValidator || hasContentEncoding)
+                    throw FileTransferError(
+                        Misc,
+                        {},
+                        "cannot resume the %s of '%s': the file has changed on the server",
+                        request.noun(),
+                        request.displayUri());
+                debug(
+                    "server ignored the range request for '%s', skipping the first %d bytes",
+                    request.displayUri(),
+                    resumeOffset);
+                skipBytes = resumeOffset;
+            }
+        }
+
         static size_t headerCallbackWrapper(void * contents, size_t size, size_t nmemb, void * userp)
         {
             return ((TransferItem *) userp)->headerCallback(contents, size, nmemb);
@@ -616,6 +732,13 @@ struct curlFileTransfer : public FileTransfer
             curl_easy_setopt(req, CURLOPT_XFERINFODATA, this);
             curl_easy_setopt(req, CURLOPT_NOPROGRESS, 0);
 
+            /* Make the server send the whole file if it has changed since
+               the previous attempt, rather than a range of the new file. */
+            if (writtenToSink && !resumeValidator.empty() && !sentIfRange) {
+                appendHeaders("If-Range: " + resumeValidator);
+                sentIfRange = true;
+            }
+
             curl_easy_setopt(req, CURLOPT_HTTPHEADER, requestHeaders.get());
 
             if (fileTransfer.settings.downloadSpeed.get() > 0)
@@ -680,8 +803,13 @@ struct curlFileTransfer : public FileTransfer
             curl_easy_setopt(req, CURLOPT_NETRC_FILE, fileTransfer.settings.netrcFile.get().string().c_str());
             curl_easy_setopt(req, CURLOPT_NETRC, CURL_NETRC_OPTIONAL);
 
+            /* Resume from where the previous attempt stopped. Unlike
+               CURLOPT_RESUME_FROM_LARGE, CURLOPT_RANGE lets us handle
+               servers that send the whole file in headersDone(). */
+            resumeOffset = writtenToSink;
+            skipBytes = 0;
             if (writtenToSink)
-                curl_easy_setopt(req, CURLOPT_RESUME_FROM_LARGE, writtenToSink);
+                curl_easy_setopt(req, CURLOPT_RANGE, fmt("%d-", writtenToSink).c_str());
 
             /* Note that the underlying strings get copied by libcurl, so the path -> string conversion is ok:
                > The application does not have to keep the string around after setting this option.
@@ -912,11 +1040,13 @@ struct curlFileTransfer : public FileTransfer
                 if (attempt >= effAttempts)
                     return false;
                 // If we've already streamed bytes to the callback, we can only
-                // resume via a Range request. That requires the server to accept
-                // byte ranges AND the response to be uncompressed (the Range
+                // resume via a Range request, or by skipping the bytes we already
+                // have if we can tell that the server sends the same file again.
+                // That requires the server to accept byte ranges or to send a
+                // validator, AND the response to be uncompressed (the Range
                 // applies to the encoded stream, but the sink saw decoded bytes).
                 if (request.dataCallback && writtenToSink != 0)
-                    return acceptRanges && !hasContentEncoding;
+                    return (acceptRanges || !resumeValidator.empty()) && !hasContentEncoding;
                 return true;
             }();
 
@@ -915,7 +915,7 @@ void LocalStore::autoGC(bool sync)
     std::shared_future<void> future;
 
     {
-        auto state(_state->lock());
+        auto state(lockState());
 
         if (state->gcRunning) {
             future = state->gcFuture;
@@ -953,7 +953,7 @@ void LocalStore::autoGC(bool sync)
 
                 /* Wake up any threads waiting for the auto-GC to finish. */
                 Finally wakeup([&]() {
-                    auto state(_state->lock());
+                    auto state(lockState());
                     state->gcRunning = false;
                     state->lastGCCheck = std::chrono::steady_clock::now();
                     promise.set_value();
@@ -968,7 +968,7 @@ void LocalStore::autoGC(bool sync)
 
                 collectGarbage(options, results);
 
-                _state->lock()->availAfterGC = getAvail();
+                lockState()->availAfterGC = getAvail();
 
             } catch (...) {
                 // FIXME: we could propagate the exception to the
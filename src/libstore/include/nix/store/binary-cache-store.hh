@@ -4,8 +4,10 @@
 #include "nix/util/compression-settings.hh"
 #include "nix/store/store-api.hh"
 #include "nix/store/log-store.hh"
+#include "nix/store/nar-info-index.hh"
 
 #include "nix/util/pool.hh"
+#include "nix/util/sync.hh"
 
 #include <atomic>
 
@@ -68,6 +70,53 @@ public:
           If not set explicitly, defaults to `true` when `compression` is `zstd` and `false` otherwise.
         )"};
 
+    Setting<bool> chunkNars{
+        this,
+        false,
+        "chunk-nars",
+        R"(
+          Whether to split NARs into content-defined chunks that are stored (and uploaded) only once, under `chunks/`.
+          The `.narinfo` file then refers to a list of chunks instead of a single compressed NAR, so that paths that differ only in a few bytes share most of their storage.
+
+          The `FileHash` field of the `.narinfo` file is the hash of this list, and `FileSize` is the compressed size of the list and all its chunks, i.e. the number of bytes needed to download the NAR.
+
+          Binary caches written with this setting can only be read by versions of Nix that support chunked NARs.
+        )"};
+
+    Setting<uint64_t> narChunkSize{
+        this,
+        64 * 1024,
+        "nar-chunk-size",
+        R"(
+          The average size in bytes of NAR chunks if `chunk-nars` is enabled.
+          It must be a power of two. Chunks are between a quarter and eight times this size.
+        )"};
+
+    Setting<bool> writeNarInfoIndex{
+        this,
+        false,
+        "write-narinfo-index",
+        R"(
+          Whether to maintain an index of the store paths in this binary cache under `index/`.
+          Clients use it to check the presence of many paths at once (e.g. when determining what can be substituted) without fetching a `.narinfo` file for each of them.
+
+          When enabled on an existing binary cache whose contents can be listed (such as a `file://` cache), the index is first generated from the existing `.narinfo` files.
+          Once a binary cache has an index, uploads to it update the index whether or not this setting is enabled.
+
+          The index is updated by reading and rewriting its files, one file per group of paths whose hashes start with the same characters.
+          If several processes upload to the same binary cache at the same time, the last one to rewrite a file wins, and paths uploaded by the others may be missing from the index.
+          Clients then won't substitute them.
+        )"};
+
+    Setting<bool> useNarInfoIndex{
+        this,
+        true,
+        "narinfo-index",
+        R"(
+          Whether to use the index of store paths published by the binary cache (see `write-narinfo-index`), if any, to answer validity queries.
+          Index files are cached locally for [`narinfo-cache-negative-ttl`](@docroot@/command-ref/conf-file.md#conf-narinfo-cache-negative-ttl) seconds.
+        )"};
+
     Setting<int> compressionLevel{
         this,
         -1,
@@ -171,10 +220,27 @@ public:
 
     std::optional<std::string> getFile(const std::string & path);
 
+    /**
+     * Fetch the compressed NAR file described by `narInfo`, and call
+     * `callback` with its contents. Calls `callback` with
+     * `std::nullopt` if the NAR is stored in chunks rather than in a
+     * single file, in which case `narFromPath()` must be used
+     * instead. Throws `SubstituteGone` if the file doesn't exist.
+     */
+    void getNarFile(const NarInfo & narInfo, Callback<std::optional<std::string>> callback) noexcept;
+
 public:
 
     virtual void init() override;
 
+    /**
+     * Whether the file that `narInfo` points to is the manifest of a
+     * chunked NAR (see `chunk-nars`) rather than the compressed NAR
+     * itself. `FileHash` is then that of the manifest, but `FileSize`
+     * includes the compressed chunks.
+     */
+    static bool isChunkManifest(const NarInfo & narInfo);
+
 private:
 
     std::string narMagic;
@@ -183,6 +249,57 @@ private:
 
     void writeNarInfo(ref<NarInfo> narInfo);
 
+    /**
+     * Whether the cache publishes a complete narinfo index, as
+     * advertised by `NarInfoIndex: 1` in `nix-cache-info`. Determined
+     * lazily since `init()` may not have fetched `nix-cache-info`.
+     */
+    Sync<std::optional<bool>> hasNarInfoIndex_;
+
+    /**
+     * Index shards that have been opened, keyed by their path in the
+     * binary cache.
+     */
+    Sync<std::map<std::string, std::shared_ptr<const NarInfoIndexShard>>> narInfoIndexShards;
+
+    /**
+     * Index entries of paths uploaded since the last call to
+     * `flushNarInfoIndex()`.
+     */
+    Sync<std::vector<NarInfoIndexEntry>> pendingNarInfoIndexEntries;
+
+    /**
+     * Whether the cache publishes a narinfo index. If so, uploads
+     * must add to it even if `write-narinfo-index` isn't set, since
+     * clients take a path that is missing from the index to be
+     * missing from the cache.
+     */
+    bool cacheHasNarInfoIndex();
+
+    /**
+     * Whether to answer validity queries from the narinfo index.
+     */
+    bool haveNarInfoIndex();
+
+    /**
+     * Return the index shard containing `hashPart`, fetching it into
+     * the local cache if necessary.
+     */
+    ref<const NarInfoIndexShard> getNarInfoIndexShard(std::string_view hashPart);
+
+    std::filesystem::path narInfoIndexCachePath(const std::string & shardPath);
+
+    /**
+     * Merge the pending index entries into the index shards in the
+     * binary cache.
+     */
+    void flushNarInfoIndex();
+
+    /**
+     * Generate a complete index of an existing binary cache.
+     */
+    void generateNarInfoIndex();
+
     /**
      * Upload the NAR for a path and everything else *except* the
      * `.narinfo` file (i.e. the compressed NAR, an optional NAR
@@ -192,6 +309,18 @@ private:
      */
     ref<NarInfo> uploadData(Source & narSource, RepairFlag repair, fun<ValidPathInfo(HashResult)> mkInfo);
 
+    /**
+     * Upload one chunk of a chunked NAR (see `chunk-nars`) unless the
+     * cache already has it. Returns the size of the compressed chunk.
+     */
+    uint64_t uploadChunk(std::string_view hash, std::string_view chunk, RepairFlag repair);
+
+    /**
+     * Reassemble a NAR from the chunks listed in the manifest at
+     * `narInfo.url`, fetching several chunks at once.
+     */
+    void narFromChunks(const NarInfo & narInfo, Sink & sink);
+
     /**
      * Sign and publish the `.narinfo` file for a path whose NAR has
      * already been uploaded by `uploadData()`. This is what establishes
@@ -212,6 +341,8 @@ public:
 
     bool isValidPathUncached(const StorePath & path) override;
 
+    StorePathSet queryValidPaths(const StorePathSet & paths, SubstituteFlag maybeSubstitute = NoSubstitute) override;
+
     void queryPathInfoUncached(
         const StorePath & path, Callback<std::shared_ptr<const ValidPathInfo>> callback) noexcept override;
 
@@ -193,6 +193,22 @@ struct BuildResult
      */
     std::optional<std::chrono::microseconds> cpuUser, cpuSystem;
 
+    /**
+     * The peak memory usage of the build, in bytes.
+     */
+    std::optional<uint64_t> memoryPeak;
+
+    /**
+     * The bytes the build read from and wrote to block devices.
+     */
+    std::optional<uint64_t> ioRead, ioWrite;
+
+    /**
+     * The time during which some processes of the build were stalled
+     * waiting for CPU, memory or IO, respectively.
+     */
+    std::optional<std::chrono::microseconds> cpuPressure, memoryPressure, ioPressure;
+
     bool operator==(const BuildResult &) const noexcept;
     std::strong_ordering operator<=>(const BuildResult &) const noexcept;
 };
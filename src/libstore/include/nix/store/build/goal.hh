@@ -637,10 +637,27 @@ protected:
 
     /**
      * Awaiting on the resulting coroutine yields the goal for several seconds.
-     * Used for retrying goals blocked on acquiring lockfiles.
+     * Used for retrying goals blocked on resources that can only be polled.
      */
     Co waitForAWhile();
 
+    /**
+     * Awaiting on the resulting coroutine yields the goal until the
+     * locks on `paths` (see `PathLocks`) have been released by
+     * whoever held them, whether another process or a goal in this
+     * process. The locks aren't acquired; the caller should try again
+     * and wait again if that fails.
+     */
+    Co waitForLocks(std::set<std::filesystem::path> paths);
+
+    /**
+     * Awaiting on the resulting coroutine yields the goal until it
+     * holds an exclusive lock on one of `lockFiles`, which is then
+     * moved into `acquired`. If locking fails, `acquired` is left
+     * invalid and the caller should try again.
+     */
+    Co waitForAnyLock(std::vector<std::filesystem::path> lockFiles, AutoCloseFD & acquired);
+
     /**
      * Awaiting on the resulting coroutine yields the goal until it is
      * explicitly woken up via Worker::wakeUp. Wakeup can be queued from another
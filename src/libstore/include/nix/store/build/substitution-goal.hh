@@ -23,9 +23,9 @@ struct PathSubstitutionGoal : public Goal
     RepairFlag repair;
 
     /**
-     * The substituter thread.
+     * The result of the running substitution, if any.
      */
-    std::thread thr;
+    std::future<void> substitution;
 
     std::unique_ptr<MaintainCount<uint64_t>> maintainExpectedSubstitutions, maintainRunningSubstitutions,
         maintainExpectedNar, maintainExpectedDownload;
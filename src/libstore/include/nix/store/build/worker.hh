@@ -25,6 +25,7 @@ struct DerivationResolutionGoal;
 struct DerivationBuildingGoal;
 struct PathSubstitutionGoal;
 class DrvOutputSubstitutionGoal;
+struct SubstitutionPipeline;
 
 /**
  * Workaround for not being able to declare a something like
@@ -217,6 +218,11 @@ private:
      */
     ref<Waker> wakerState;
 
+    /**
+     * Created on demand by `getSubstitutionPipeline()`.
+     */
+    std::shared_ptr<SubstitutionPipeline> substitutionPipeline;
+
 public:
 
     const Activity act;
@@ -340,6 +346,12 @@ public:
      */
     std::weak_ptr<Waker> getCrossThreadWaker();
 
+    /**
+     * The pipeline that copies substitutes into the store, shared by
+     * all `PathSubstitutionGoal`s.
+     */
+    SubstitutionPipeline & getSubstitutionPipeline();
+
     /**
      * Return the number of local build processes currently running (but not
      * remote builds via the build hook).
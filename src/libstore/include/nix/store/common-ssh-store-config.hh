@@ -29,6 +29,22 @@ public:
 
     Setting<bool> compress{this, false, "compress", "Whether to enable SSH compression."};
 
+    Setting<unsigned int> controlPersist{
+        this,
+        0,
+        "control-persist",
+        R"(
+          If non-zero, share a single SSH master connection to the remote
+          machine between all Nix processes using the same SSH settings,
+          and keep it open for this many seconds after the last
+          connection using it has been closed.
+
+          This avoids paying for an SSH handshake every time a
+          short-lived process such as the [remote build hook](@docroot@/advanced-topics/distributed-builds.md)
+          connects to the same machine.
+          The control socket is stored in `$XDG_CACHE_HOME/nix/ssh`.
+        )"};
+
     Setting<std::string> remoteStore{
         this,
         "",
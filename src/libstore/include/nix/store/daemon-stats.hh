@@ -0,0 +1,94 @@
+#pragma once
+///@file
+
+#include "nix/store/worker-protocol.hh"
+#include "nix/util/json-impls.hh"
+
+#include <array>
+#include <chrono>
+#include <map>
+
+namespace nix::daemon {
+
+/**
+ * Statistics about the load on the Nix daemon, as reported by `nix
+ * store daemon-stats`.
+ *
+ * The counters are kept in memory that is shared by all daemon worker
+ * processes (see `initSharedStats()`), and are only updated with
+ * relaxed atomic additions, so recording them is cheap. A snapshot is
+ * taken by `getStats()`.
+ */
+struct Stats
+{
+    /**
+     * Latencies are recorded in power-of-two buckets: bucket `i`
+     * counts operations that took less than 2^i microseconds. The last
+     * bucket counts all slower operations.
+     */
+    static constexpr size_t nrLatencyBuckets = 32;
+
+    struct Op
+    {
+        uint64_t count = 0;
+        uint64_t bytesIn = 0;
+        uint64_t bytesOut = 0;
+        uint64_t totalMicros = 0;
+        std::array<uint64_t, nrLatencyBuckets> latencyBuckets{};
+
+        /**
+         * An upper bound (with bucket resolution) of the given latency
+         * percentile, in microseconds. `p` is between 0 and 1.
+         */
+        uint64_t latencyPercentile(double p) const;
+
+        bool operator==(const Op &) const = default;
+    };
+
+    /**
+     * Per-operation statistics, indexed by the name of the operation.
+     * Operations that haven't been performed are omitted.
+     */
+    std::map<std::string, Op> ops;
+
+    /**
+     * Number of times an SQLite transaction was retried because the
+     * database was busy.
+     */
+    uint64_t sqliteBusyRetries = 0;
+
+    /**
+     * Number of times a thread had to wait for the lock on the local
+     * store's state, and the total time spent waiting.
+     */
+    uint64_t stateLockWaits = 0;
+    uint64_t stateLockWaitMicros = 0;
+
+    bool operator==(const Stats &) const = default;
+
+    /**
+     * Render the statistics in the Prometheus text exposition format.
+     */
+    std::string toPrometheus() const;
+};
+
+std::string_view opName(WorkerProto::Op op);
+
+/**
+ * Move the counters into shared memory, so that they're shared with
+ * the processes forked afterwards. Called by the daemon before
+ * accepting connections. Otherwise the counters are per-process.
+ */
+void initSharedStats();
+
+void recordOp(WorkerProto::Op op, std::chrono::steady_clock::duration duration, uint64_t bytesIn, uint64_t bytesOut);
+
+void recordSQLiteBusyRetry();
+
+void recordStateLockWait(std::chrono::steady_clock::duration duration);
+
+Stats getStats();
+
+} // namespace nix::daemon
+
+JSON_IMPL(nix::daemon::Stats)
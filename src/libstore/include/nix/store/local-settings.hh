@@ -226,6 +226,21 @@ public:
         )",
         {"build-cores"}};
 
+    Setting<unsigned int> globalMaxJobs{
+        this,
+        0,
+        "global-max-jobs",
+        R"(
+          The maximum number of local builds that all Nix processes using this store run at the same time.
+
+          [`max-jobs`](#conf-max-jobs) only limits the builds of a single Nix process, and clients of the Nix daemon can set it themselves.
+          Since the daemon handles each client connection in a separate process, several clients that build at the same time can together run many more than `max-jobs` builds.
+          This setting limits the total number of builds across all of them.
+          Builds that would exceed it wait until another build finishes.
+
+          If set to `0` (the default), there is no such limit.
+        )"};
+
     Setting<bool> fsyncMetadata{
         this,
         true,
@@ -348,6 +363,55 @@ public:
 
           Cgroups are required and enabled automatically for derivations
           that require the `uid-range` system feature.
+
+          When a build runs in a cgroup, its peak memory usage, the bytes
+          it read from and wrote to disk, and the time it was stalled on
+          CPU, memory or IO are recorded in its build result, as far as
+          the kernel provides them.
+        )"};
+
+    Setting<std::string> buildMemoryMax{
+        this,
+        "",
+        "build-memory-max",
+        R"(
+          The memory limit of each build, written to the `memory.max` file
+          of its cgroup, e.g. `8G`. A build that exceeds it is killed by
+          the kernel's OOM killer instead of putting the memory of the
+          rest of the system under pressure. If empty, builds have no
+          memory limit of their own.
+
+          This requires [`use-cgroups`](#conf-use-cgroups) and the
+          `memory` cgroup controller.
+        )"};
+
+    Setting<std::string> buildCpuMax{
+        this,
+        "",
+        "build-cpu-max",
+        R"(
+          The CPU bandwidth limit of each build, written to the `cpu.max`
+          file of its cgroup. It has the form `quota period` in
+          microseconds; e.g. `400000 100000` allows a build to use up to
+          four CPUs. If empty, builds have no CPU limit of their own.
+
+          This requires [`use-cgroups`](#conf-use-cgroups) and the `cpu`
+          cgroup controller.
+        )"};
+
+    Setting<std::string> buildIoMax{
+        this,
+        "",
+        "build-io-max",
+        R"(
+          The IO limit of each build, written to the `io.max` file of its
+          cgroup. It has the form `major:minor key=value...` for one block
+          device; e.g. `259:0 rbps=104857600 wbps=104857600` limits reads
+          and writes on device 259:0 to 100 MiB/s. If empty, builds have
+          no IO limit of their own.
+
+          This requires [`use-cgroups`](#conf-use-cgroups) and the `io`
+          cgroup controller.
         )"};
 #endif
 
@@ -454,6 +518,29 @@ public:
             description of the `size` option of `tmpfs` in mount(8). The default
             is `50%`.
         )"};
+
+    Setting<bool> sandboxStoreOverlay{
+        this,
+        false,
+        "sandbox-store-overlay",
+        R"(
+            *Linux only*
+
+            If set to `true`, the input store paths of a sandboxed build
+            are made visible through a single overlay file system on the
+            store directory, instead of through a bind mount for every
+            input. This makes setting up and tearing down the sandbox much
+            cheaper for builds with large closures.
+
+            The overlay hides all store paths that aren't inputs of the
+            build, so the build sees the same store as with bind mounts.
+            Inputs that aren't directories are still bind-mounted.
+
+            This requires Nix to run as root, and the store to be on a
+            file system that supports trusted extended attributes and can
+            be the upper layer of an overlay file system. If the overlay
+            can't be set up, Nix falls back to bind mounts.
+        )"};
 #endif
 
 #if defined(__linux__) || defined(__FreeBSD__)
@@ -32,6 +32,7 @@ struct OptimiseStats
 };
 
 struct LocalSettings;
+struct ReferenceGraph;
 
 struct LocalBuildStoreConfig : virtual LocalFSStoreConfig
 {
@@ -158,6 +159,28 @@ public:
         Xp::LocalOverlayStore,
     };
 
+    Setting<unsigned int> verifyJobs{
+        this,
+        0,
+        "verify-jobs",
+        R"(
+          The number of store objects whose contents are read and hashed in parallel by
+          [`nix-store --verify --check-contents`](@docroot@/command-ref/nix-store/verify.md).
+          `0` means the number of CPU cores.
+        )"};
+
+    Setting<uint64_t> verifyMaxBytesPerSecond{
+        this,
+        0,
+        "verify-max-bytes-per-second",
+        R"(
+          The maximum rate, in bytes per second, at which
+          [`nix-store --verify --check-contents`](@docroot@/command-ref/nix-store/verify.md)
+          reads the contents of the store, summed over all threads.
+          This allows verifying a store on a machine that is in use without starving other I/O.
+          `0` means no limit.
+        )"};
+
     std::filesystem::path getRootsSocketPath() const;
 
     static const std::string name()
@@ -229,6 +252,13 @@ private:
         uint64_t availAfterGC = std::numeric_limits<uint64_t>::max();
 
         std::unique_ptr<PublicKeys> publicKeys;
+
+        /**
+         * The snapshot returned by `getReferenceGraph()`, and the
+         * database version it was loaded from.
+         */
+        std::shared_ptr<const ReferenceGraph> referenceGraph;
+        std::pair<int64_t, int64_t> referenceGraphVersion;
     };
 
     /**
@@ -237,6 +267,11 @@ private:
      */
     ref<Sync<State>> _state;
 
+    /**
+     * Lock `_state`, recording contention in the daemon statistics.
+     */
+    Sync<State>::WriteLock lockState();
+
 public:
 
     const std::filesystem::path dbDir;
@@ -275,6 +310,14 @@ public:
 
     StorePathSet queryAllValidPaths() override;
 
+    /**
+     * Return a snapshot of the references between all valid paths,
+     * for queries that visit many paths, like computing the closure
+     * sizes of many paths. It is loaded with a single scan of the
+     * database, and reused until the database changes.
+     */
+    ref<const ReferenceGraph> getReferenceGraph();
+
     void queryPathInfoUncached(
         const StorePath & path, Callback<std::shared_ptr<const ValidPathInfo>> callback) noexcept override;
 
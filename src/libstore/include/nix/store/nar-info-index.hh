@@ -0,0 +1,87 @@
+#pragma once
+///@file
+
+#include "nix/util/types.hh"
+
+#include <filesystem>
+#include <memory>
+
+namespace nix {
+
+/**
+ * An entry of the narinfo index.
+ */
+struct NarInfoIndexEntry
+{
+    /**
+     * The hash part of the store path.
+     */
+    std::string hashPart;
+
+    uint64_t narSize = 0;
+
+    /**
+     * Size of the (compressed) NAR file in the binary cache.
+     */
+    uint64_t fileSize = 0;
+
+    bool operator==(const NarInfoIndexEntry &) const = default;
+};
+
+/**
+ * A shard of the narinfo index that a binary cache can publish to
+ * answer mass validity queries without a `.narinfo` request per path.
+ *
+ * The index is split by the first `prefixLength` characters of the
+ * hash part into files named `index/<prefix>.idx`. Each file consists
+ * of an 8-byte magic followed by fixed-size entries sorted by hash
+ * part: the 32-character hash part, then the NAR size and the file size
+ * as little-endian 64-bit integers. This allows shards to be memory
+ * mapped and searched without parsing.
+ */
+class NarInfoIndexShard
+{
+    /**
+     * Keeps the memory backing `data` alive.
+     */
+    std::shared_ptr<const void> storage;
+
+    std::string_view data;
+
+    size_t size() const;
+
+    std::string_view hashPartAt(size_t i) const;
+
+    NarInfoIndexEntry entryAt(size_t i) const;
+
+    NarInfoIndexShard(std::shared_ptr<const void> storage, std::string_view data);
+
+public:
+
+    static constexpr size_t prefixLength = 2;
+
+    /**
+     * The path of the shard containing `hashPart`, relative to the root
+     * of the binary cache.
+     */
+    static std::string shardPath(std::string_view hashPart);
+
+    /**
+     * Memory-map a shard stored in a local file.
+     */
+    static NarInfoIndexShard open(const std::filesystem::path & path);
+
+    static NarInfoIndexShard parse(std::string data);
+
+    /**
+     * Serialise a shard. The entries need not be sorted; if there are
+     * several entries for the same hash part, the last one wins.
+     */
+    static std::string serialise(std::vector<NarInfoIndexEntry> entries);
+
+    std::optional<NarInfoIndexEntry> lookup(std::string_view hashPart) const;
+
+    std::vector<NarInfoIndexEntry> entries() const;
+};
+
+} // namespace nix
@@ -0,0 +1,105 @@
+#pragma once
+///@file
+
+#include "nix/store/path.hh"
+
+#include <boost/unordered/unordered_flat_map.hpp>
+
+#include <optional>
+#include <span>
+#include <vector>
+
+namespace nix {
+
+/**
+ * An immutable snapshot of the references between a set of store
+ * objects, stored as adjacency arrays in compressed sparse row form
+ * and indexed by integers rather than store paths.
+ *
+ * This makes queries that visit a large part of the graph, like
+ * computing the closures of many paths, much cheaper than querying
+ * the references of every path from the store.
+ */
+struct ReferenceGraph
+{
+    /**
+     * Store objects are identified by their position in `paths`.
+     */
+    using Index = uint32_t;
+
+    /**
+     * A set of store objects, as a bitset indexed by `Index`.
+     */
+    using Set = std::vector<bool>;
+
+    struct Edge
+    {
+        Index referrer, reference;
+    };
+
+    /**
+     * Build a graph of the store objects `paths` with NAR sizes
+     * `narSizes`, and `edges` between them.
+     */
+    ReferenceGraph(std::vector<StorePath> && paths, std::vector<uint64_t> && narSizes, std::span<const Edge> edges);
+
+    size_t size() const
+    {
+        return paths.size();
+    }
+
+    const StorePath & path(Index i) const
+    {
+        return paths[i];
+    }
+
+    uint64_t narSize(Index i) const
+    {
+        return narSizes[i];
+    }
+
+    std::optional<Index> lookup(const StorePath & path) const;
+
+    std::span<const Index> referencesOf(Index i) const
+    {
+        return {references.data() + referenceStart[i], references.data() + referenceStart[i + 1]};
+    }
+
+    std::span<const Index> referrersOf(Index i) const
+    {
+        return {referrers.data() + referrerStart[i], referrers.data() + referrerStart[i + 1]};
+    }
+
+    /**
+     * @return The closure of `roots` under the references relation,
+     * or under the referrers relation if `flipDirection` is set, like
+     * `Store::computeFSClosure()`.
+     */
+    Set closure(std::span<const Index> roots, bool flipDirection = false) const;
+
+    /**
+     * @return The sum of the NAR sizes of the store objects in the
+     * closure of `roots` under the references relation. This only
+     * takes time proportional to the size of the closure, not of the
+     * graph, apart from allocating a bitset.
+     */
+    uint64_t closureSize(std::span<const Index> roots) const;
+
+    /**
+     * @return The sum of the NAR sizes of the store objects in `set`.
+     */
+    uint64_t totalNarSize(const Set & set) const;
+
+    StorePathSet toPaths(const Set & set) const;
+
+private:
+
+    std::vector<StorePath> paths;
+    std::vector<uint64_t> narSizes;
+    boost::unordered_flat_map<StorePath, Index> indices;
+
+    std::vector<Index> referenceStart, references;
+    std::vector<Index> referrerStart, referrers;
+};
+
+} // namespace nix
@@ -11,6 +11,7 @@
 #include "nix/util/file-descriptor.hh"
 #include "nix/store/gc-store.hh"
 #include "nix/store/log-store.hh"
+#include "nix/store/stats-store.hh"
 
 namespace nix {
 
@@ -47,7 +48,11 @@ public:
  * \todo RemoteStore is a misnomer - should be something like
  * DaemonStore.
  */
-struct RemoteStore : public virtual Store, public virtual GcStore, public virtual LogStore, public virtual SubmitStore
+struct RemoteStore : public virtual Store,
+                     public virtual GcStore,
+                     public virtual LogStore,
+                     public virtual SubmitStore,
+                     public virtual StatsStore
 {
 private:
     void anchor() override;
@@ -158,6 +163,8 @@ public:
 
     std::optional<TrustedFlag> isTrustedClient() override;
 
+    daemon::Stats queryDaemonStats() override;
+
     void flushBadConnections();
 
     /**
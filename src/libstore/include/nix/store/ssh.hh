@@ -25,6 +25,13 @@ private:
     const std::string sshPublicHostKey;
     const bool useMaster;
     const bool compress;
+    /**
+     * If non-zero, the master connection is shared with other
+     * processes through a control socket in the user's cache
+     * directory, and kept alive for this many seconds after its last
+     * client disconnects (see `ControlPersist` in `ssh_config(5)`).
+     */
+    const unsigned int controlPersist;
     const Descriptor logFD;
 
     const ref<const AutoDelete> tmpDir;
@@ -40,7 +47,19 @@ private:
     Sync<State> state_;
 
     void addCommonSSHOpts(OsStrings & args);
-    bool isMasterRunning();
+
+    /**
+     * Check whether a master is accepting connections on
+     * `socketPath`, or on the `ControlPath` from the user's SSH
+     * configuration if `socketPath` is empty.
+     */
+    bool isMasterRunning(const std::filesystem::path & socketPath = {});
+
+    /**
+     * The control socket shared by all processes connecting to this
+     * host with the same options. Only used if `controlPersist` is set.
+     */
+    std::filesystem::path getPersistentSocketPath();
 
 #ifndef _WIN32 // TODO re-enable on Windows, once we can start processes.
     std::filesystem::path startMaster();
@@ -54,6 +73,7 @@ public:
         std::string_view sshPublicHostKey,
         bool useMaster,
         bool compress,
+        unsigned int controlPersist = 0,
         Descriptor logFD = INVALID_DESCRIPTOR);
 
     struct Connection
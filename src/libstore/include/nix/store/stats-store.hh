@@ -0,0 +1,26 @@
+#pragma once
+///@file
+
+#include "nix/store/store-api.hh"
+
+namespace nix {
+
+namespace daemon {
+struct Stats;
+}
+
+struct StatsStore : public virtual Store
+{
+private:
+    void anchor() override;
+
+public:
+    inline static std::string operationName = "Querying daemon statistics";
+
+    /**
+     * Get the operation statistics of the daemon.
+     */
+    virtual daemon::Stats queryDaemonStats() = 0;
+};
+
+} // namespace nix
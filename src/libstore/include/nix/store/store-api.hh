@@ -15,6 +15,7 @@
 #include "nix/store/store-dir-config.hh"
 #include "nix/store/store-reference.hh"
 #include "nix/util/source-path.hh"
+#include "nix/util/fun.hh"
 
 #include <nlohmann/json_fwd.hpp>
 #include <atomic>
@@ -1037,6 +1038,20 @@ void copyStorePath(
     RepairFlag repair = NoRepair,
     CheckSigsFlag checkSigs = CheckSigs);
 
+/**
+ * Like `copyStorePath()`, but get the NAR from `nar`, which writes it
+ * to a sink, rather than from `srcStore.narFromPath()`. This is for
+ * callers that already have the NAR, e.g. because they downloaded it
+ * ahead of time.
+ */
+void copyStorePath(
+    Store & srcStore,
+    Store & dstStore,
+    const StorePath & storePath,
+    RepairFlag repair,
+    CheckSigsFlag checkSigs,
+    fun<void(Sink &)> nar);
+
 /**
  * Copy store paths from one store to another. The paths may be copied
  * in parallel. They are copied in a topologically sorted order (i.e. if
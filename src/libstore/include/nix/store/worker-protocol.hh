@@ -151,6 +151,17 @@ struct WorkerProto
      */
     static constexpr std::string_view featureSubmitOutput = "submit-output";
 
+    /**
+     * Feature for enabling the `QueryDaemonStats` operation
+     */
+    static constexpr std::string_view featureQueryDaemonStats = "query-daemon-stats";
+
+    /**
+     * Feature for transmitting the memory, IO and pressure stall
+     * statistics of a `BuildResult`
+     */
+    static constexpr std::string_view featureBuildResourceStats = "build-resource-stats";
+
     /**
      * A unidirectional read connection, to be used by the read half of the
      * canonical serializers below.
@@ -277,6 +288,7 @@ enum struct WorkerProto::Op : uint64_t {
     // QueryPathInfos = 50, // reserved for https://github.com/DeterminateSystems/nix-src/pull/539
     SubmitOutput = 1000, // Only used within derivations with feature
     AddToStoreScanning = 1001,
+    QueryDaemonStats = 1002,
 };
 
 struct WorkerProto::ClientHandshakeInfo
@@ -372,6 +384,8 @@ DECLARE_WORKER_SERIALISER(std::optional<TrustedFlag>);
 template<>
 DECLARE_WORKER_SERIALISER(std::optional<std::chrono::microseconds>);
 template<>
+DECLARE_WORKER_SERIALISER(std::optional<uint64_t>);
+template<>
 DECLARE_WORKER_SERIALISER(WorkerProto::ClientHandshakeInfo);
 
 template<>
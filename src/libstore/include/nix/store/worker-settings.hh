@@ -81,9 +81,52 @@ public:
           This option defines the maximum number of substitution jobs that Nix
           tries to run in parallel. The default is `16`. The minimum value
           one can choose is `1` and lower values are interpreted as `1`.
+
+          Substitution jobs from HTTP binary caches don't have a thread
+          each, so this can be set much higher than the number of CPU
+          cores to make better use of the network. The work that does
+          need a thread is limited by
+          [`substitution-import-jobs`](#conf-substitution-import-jobs).
+          Substitutions from other substituters, and NARs larger than
+          [`substitution-buffer-size`](#conf-substitution-buffer-size),
+          use a thread each.
         )",
         {"substitution-max-jobs"}};
 
+    Setting<unsigned int> substitutionImportJobs{
+        this,
+        0,
+        "substitution-import-jobs",
+        R"(
+          The maximum number of threads that decompress substituted NARs
+          and add them to the Nix store. `0` means the number of CPU
+          cores.
+        )"};
+
+    Setting<uint64_t> substitutionBufferSize{
+        this,
+        256 * 1024 * 1024,
+        "substitution-buffer-size",
+        R"(
+          The maximum total size, in bytes, of the compressed NARs that
+          are downloaded from HTTP binary caches ahead of being imported
+          into the Nix store. This lets downloads proceed while other
+          paths are being imported. NARs that don't fit are downloaded
+          while they are imported instead.
+        )"};
+
+    Setting<unsigned int> maxSubstituterQueries{
+        this,
+        1024,
+        "max-substituter-queries",
+        R"(
+          The maximum number of store paths that Nix looks up in the
+          substituters at the same time while it determines what needs
+          to be built or substituted. Each store path is looked up in
+          all substituters at once, and the answers are used in the
+          order of the substituters' priorities.
+        )"};
+
     Setting<time_t> maxSilentTime{
         this,
         0,
@@ -260,6 +303,17 @@ public:
         {},
         false};
 
+    Setting<unsigned int> buildersSshControlPersist{
+        this,
+        0,
+        "builders-ssh-control-persist",
+        R"(
+          If non-zero, SSH connections to [remote build machines](#conf-builders) are kept open for this many seconds after their last use, and reused by subsequent remote builds on the same machine.
+          This is equivalent to adding `control-persist` to every `ssh://` and `ssh-ng://` builder URL that does not already set it.
+
+          Without this, every remote build performs a full SSH handshake, which can dominate the build time of small derivations.
+        )"};
+
     Setting<bool> alwaysAllowSubstitutes{
         this,
         false,
@@ -322,7 +376,11 @@ public:
         )",
         {"build-max-log-size"}};
 
-    Setting<unsigned int> pollInterval{this, 5, "build-poll-interval", "How often (in seconds) to poll for locks."};
+    Setting<unsigned int> pollInterval{
+        this,
+        5,
+        "build-poll-interval",
+        "How often (in seconds) to poll for free build users and remote build machines."};
 
     Setting<std::string> postBuildHook{
         this,
@@ -30,6 +30,14 @@ struct ChrootLinuxDerivationBuilder : ChrootDerivationBuilder, LinuxDerivationBu
      */
     std::optional<std::filesystem::path> cgroup;
 
+    /**
+     * If `sandbox-store-overlay` is enabled, a detached mount of the
+     * store directory of an overlay file system that only shows the
+     * input directories of the build. The child moves it onto the
+     * store directory of the chroot.
+     */
+    AutoCloseFD storeOverlay;
+
     ChrootLinuxDerivationBuilder(
         LocalStore & store, std::shared_ptr<DerivationBuilderCallbacks> miscMethods, DerivationBuilderParams params)
         : DerivationBuilderImpl{store, miscMethods, params}
@@ -48,6 +56,12 @@ struct ChrootLinuxDerivationBuilder : ChrootDerivationBuilder, LinuxDerivationBu
 
     void prepareSandbox() override;
 
+    /**
+     * Set `storeOverlay` and remove the inputs it shows from
+     * `pathsInChroot`.
+     */
+    void setupStoreOverlay();
+
     void startChild() override;
 
     void enterChroot() override;
@@ -30,6 +30,7 @@
 #include <sys/mount.h>
 #include <sys/syscall.h>
 #include <sys/prctl.h>
+#include <sys/xattr.h>
 #include <grp.h>
 
 #if HAVE_SECCOMP
@@ -74,6 +75,49 @@ static int move_mount(int sourceDirFd, const char * source, int destDirFd, const
 
 #endif
 
+#if !HAVE_FSOPEN
+
+#  ifndef FSOPEN_CLOEXEC
+#    define FSOPEN_CLOEXEC 0x00000001
+#  endif
+
+static int fsopen(const char * fsName, unsigned int flags)
+{
+    return ::syscall(__NR_fsopen, fsName, flags);
+}
+
+#endif
+
+#if !HAVE_FSCONFIG
+
+#  ifndef FSCONFIG_SET_STRING
+#    define FSCONFIG_SET_STRING 1
+#  endif
+
+#  ifndef FSCONFIG_CMD_CREATE
+#    define FSCONFIG_CMD_CREATE 6
+#  endif
+
+static int fsconfig(int fsFd, unsigned int cmd, const char * key, const void * value, int aux)
+{
+    return ::syscall(__NR_fsconfig, fsFd, cmd, key, value, aux);
+}
+
+#endif
+
+#if !HAVE_FSMOUNT
+
+#  ifndef FSMOUNT_CLOEXEC
+#    define FSMOUNT_CLOEXEC 0x00000001
+#  endif
+
+static int fsmount(int fsFd, unsigned int flags, unsigned int attrFlags)
+{
+    return ::syscall(__NR_fsmount, fsFd, flags, attrFlags);
+}
+
+#endif
+
 namespace nix {
 
 void setupSeccomp(const LocalSettings & localSettings)
@@ -459,6 +503,36 @@ void ChrootLinuxDerivationBuilder::prepareUser()
         if (!pathExists(rootCgroupPath))
             throw Error("expected cgroup directory %s", PathFmt(rootCgroupPath));
 
+        /* Enable the controllers that the build's cgroup needs for
+           memory and IO accounting and for the configured limits.
+           Accounting is best-effort, but a limit that can't be
+           applied is an error. Enabling controllers fails if this
+           process is in `rootCgroupPath` itself, which is the case
+           when we're not running in the daemon. */
+        auto & localSettings = store.config->getLocalSettings();
+        StringSet controllers{"memory", "io"}, required;
+        if (!localSettings.buildMemoryMax.get().empty())
+            required.insert("memory");
+        if (!localSettings.buildCpuMax.get().empty())
+            required.insert("cpu");
+        if (!localSettings.buildIoMax.get().empty())
+            required.insert("io");
+        controllers.insert(required.begin(), required.end());
+        try {
+            for (auto & controller : linux::enableCgroupControllers(rootCgroupPath, controllers))
+                if (required.contains(controller))
+                    throw Error(
+                        "cannot limit builds because the '%s' cgroup controller is not available in %s",
+                        controller,
+                        PathFmt(rootCgroupPath));
+        } catch (SysError & e) {
+            if (!required.empty()) {
+                e.addTrace({}, "while enabling cgroup controllers for the build limits");
+                throw;
+            }
+            debug("cannot enable cgroup controllers in %s: %s", PathFmt(rootCgroupPath), e.msg());
+        }
+
         static std::atomic<unsigned int> counter{0};
 
         cgroup = rootCgroupPath
@@ -500,9 +574,128 @@ void ChrootLinuxDerivationBuilder::prepareSandbox()
         chownToBuilder(*cgroup / "cgroup.procs");
         chownToBuilder(*cgroup / "cgroup.threads");
         // chownToBuilder(*cgroup / "cgroup.subtree_control");
+
+        /* The limit files stay owned by root, so the builder can't
+           raise them. */
+        auto & localSettings = store.config->getLocalSettings();
+        for (auto & [file, limit] :
+             {std::pair{"memory.max", localSettings.buildMemoryMax.get()},
+              std::pair{"cpu.max", localSettings.buildCpuMax.get()},
+              std::pair{"io.max", localSettings.buildIoMax.get()}})
+            if (!limit.empty())
+                writeFile(*cgroup / file, limit);
+    }
+
+    if (store.config->getLocalSettings().sandboxStoreOverlay) {
+        try {
+            setupStoreOverlay();
+        } catch (SysError & e) {
+            static std::atomic_flag warned{};
+            if (!warned.test_and_set())
+                warn("cannot set up the store overlay of the sandbox, falling back to bind mounts: %s", e.msg());
+            else
+                debug("cannot set up the store overlay of the sandbox: %s", e.msg());
+        }
     }
 }
 
+void ChrootLinuxDerivationBuilder::setupStoreOverlay()
+{
+    auto start = std::chrono::steady_clock::now();
+
+    /* The store directory of the chroot becomes the upper layer of
+       an overlay whose lower layer is the host store. It is marked
+       opaque, which hides the host store, and gets a directory for
+       every input that redirects to the input in the host store.
+       The upper layer must be a subdirectory of the overlay's root,
+       because the root of an overlay can't be opaque. Outputs are
+       written to the upper layer, i.e. where they'd be without the
+       overlay. */
+    auto realStoreDir = store.getRealStoreDir();
+    auto chrootStoreDir = chrootRootDir / std::filesystem::path(store.storeDir).relative_path();
+
+    AutoCloseFD storeDirFd = openDirectory(chrootStoreDir, FinalSymlink::DontFollow);
+    if (!storeDirFd)
+        throw SysError("opening directory %s", PathFmt(chrootStoreDir));
+
+    /* Files and symlinks can't be redirected to without `metacopy`,
+       so those are still bind-mounted. */
+    std::vector<std::string> inputDirs;
+    for (auto & i : inputPaths) {
+        auto it = pathsInChroot.find(store.printStorePath(i));
+        if (it == pathsInChroot.end() || it->second.source != store.toRealPath(i))
+            continue;
+
+        std::string name(i.to_string());
+        auto st = lstat(realStoreDir / name);
+        if (!S_ISDIR(st.st_mode))
+            continue;
+
+        if (::mkdirat(storeDirFd.get(), name.c_str(), 0700) == -1)
+            throw SysError("creating directory %s", PathFmt(chrootStoreDir / name));
+
+        auto redirect = "/" + name;
+        if (::lsetxattr(
+                (chrootStoreDir / name).c_str(), "trusted.overlay.redirect", redirect.data(), redirect.size(), 0)
+            == -1)
+            throw SysError("setting the overlay redirect of %s", PathFmt(chrootStoreDir / name));
+
+        /* The attributes of a merged directory are those of its upper
+           directory, so copy them from the input. */
+        if (::fchownat(storeDirFd.get(), name.c_str(), st.st_uid, st.st_gid, AT_SYMLINK_NOFOLLOW) == -1)
+            throw SysError("changing ownership of %s", PathFmt(chrootStoreDir / name));
+        if (::fchmodat(storeDirFd.get(), name.c_str(), st.st_mode & 07777, 0) == -1)
+            throw SysError("changing permissions of %s", PathFmt(chrootStoreDir / name));
+        const std::array<::timespec, 2> times = {st.st_atim, st.st_mtim};
+        if (::utimensat(storeDirFd.get(), name.c_str(), times.data(), AT_SYMLINK_NOFOLLOW) == -1)
+            throw SysError("changing write time of %s", PathFmt(chrootStoreDir / name));
+
+        inputDirs.push_back(std::move(name));
+    }
+
+    if (::fsetxattr(storeDirFd.get(), "trusted.overlay.opaque", "y", 1, 0) == -1)
+        throw SysError("making %s opaque", PathFmt(chrootStoreDir));
+
+    auto workDir = chrootRootDir.parent_path() / "overlay-work";
+    createDir(workDir, 0700);
+
+    AutoCloseFD fsFd = fsopen("overlay", FSOPEN_CLOEXEC);
+    if (!fsFd)
+        throw SysError("creating an overlay file system");
+
+    auto setOption = [&](const char * key, const std::string & value) {
+        if (fsconfig(fsFd.get(), FSCONFIG_SET_STRING, key, value.c_str(), 0) == -1)
+            throw SysError("setting overlay option '%s' to '%s'", key, value);
+    };
+
+    /* Colons separate lower layers, so escape them. */
+    setOption("lowerdir", replaceStrings(replaceStrings(realStoreDir.native(), "\\", "\\\\"), ":", "\\:"));
+    setOption("upperdir", chrootStoreDir.parent_path().native());
+    setOption("workdir", workDir.native());
+    setOption("redirect_dir", "on");
+
+    if (fsconfig(fsFd.get(), FSCONFIG_CMD_CREATE, nullptr, nullptr, 0) == -1)
+        throw SysError("creating the overlay of %s", PathFmt(realStoreDir));
+
+    AutoCloseFD mountFd = fsmount(fsFd.get(), FSMOUNT_CLOEXEC, 0);
+    if (!mountFd)
+        throw SysError("mounting the overlay of %s", PathFmt(realStoreDir));
+
+    /* Only the store directory of the chroot is exposed. The root of
+       the overlay shows the entire host store. */
+    storeOverlay = ::open_tree(mountFd.get(), chrootStoreDir.filename().c_str(), OPEN_TREE_CLONE | OPEN_TREE_CLOEXEC);
+    if (!storeOverlay)
+        throw SysError("opening the store directory of the overlay of %s", PathFmt(realStoreDir));
+
+    for (auto & name : inputDirs)
+        pathsInChroot.erase(store.storeDir + "/" + name);
+
+    debug(
+        "set up the store overlay with %d inputs in %.3f s",
+        inputDirs.size(),
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+}
+
 void ChrootLinuxDerivationBuilder::startChild()
 {
     RunChildArgs args{
@@ -596,6 +789,9 @@ void ChrootLinuxDerivationBuilder::startChild()
         throw Error("unable to start build process: %s", statusToString(status));
     }
 
+    /* The child has its own reference to the store overlay. */
+    storeOverlay.close();
+
     userNamespaceSync.readSide = -1;
 
     /* Make sure that we write *something* to the child in case of
@@ -729,6 +925,15 @@ void ChrootLinuxDerivationBuilder::enterChroot()
     if (mount(chrootRootDir.c_str(), chrootRootDir.c_str(), 0, MS_BIND, 0) == -1)
         throw SysError("unable to bind mount %1%", PathFmt(chrootRootDir));
 
+    std::filesystem::path chrootStoreDir = chrootRootDir / std::filesystem::path(store.storeDir).relative_path();
+
+    /* Mount the overlay that shows the inputs in the store. */
+    if (storeOverlay) {
+        if (::move_mount(storeOverlay.get(), "", AT_FDCWD, chrootStoreDir.c_str(), MOVE_MOUNT_F_EMPTY_PATH) == -1)
+            throw SysError("mounting the store overlay on %s", PathFmt(chrootStoreDir));
+        storeOverlay.close();
+    }
+
     /* Bind-mount the sandbox's Nix store onto itself so that
        we can mark it as a "shared" subtree, allowing bind
        mounts made in *this* mount namespace to be propagated
@@ -737,7 +942,6 @@ void ChrootLinuxDerivationBuilder::enterChroot()
 
        Marking chrootRootDir as MS_SHARED causes pivot_root()
        to fail with EINVAL. Don't know why. */
-    std::filesystem::path chrootStoreDir = chrootRootDir / std::filesystem::path(store.storeDir).relative_path();
 
     if (mount(chrootStoreDir.c_str(), chrootStoreDir.c_str(), 0, MS_BIND, 0) == -1)
         throw SysError("unable to bind mount the Nix store at %1%", PathFmt(chrootStoreDir));
@@ -948,6 +1152,12 @@ void ChrootLinuxDerivationBuilder::killSandbox(bool getStats)
         if (getStats) {
             buildResult.cpuUser = stats.cpuUser;
             buildResult.cpuSystem = stats.cpuSystem;
+            buildResult.memoryPeak = stats.memoryPeak;
+            buildResult.ioRead = stats.ioRead;
+            buildResult.ioWrite = stats.ioWrite;
+            buildResult.cpuPressure = stats.cpuPressure;
+            buildResult.memoryPressure = stats.memoryPressure;
+            buildResult.ioPressure = stats.ioPressure;
         }
         return;
     }
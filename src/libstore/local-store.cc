@@ -6,11 +6,14 @@
 #include "nix/util/archive.hh"
 #include "nix/store/pathlocks.hh"
 #include "nix/store/worker-protocol.hh"
+#include "nix/store/daemon-stats.hh"
 #include "nix/store/derivations.hh"
 #include "nix/store/realisation.hh"
+#include "nix/store/reference-graph.hh"
 #include "nix/store/references.hh"
 #include "nix/util/callback.hh"
 #include "nix/util/topo-sort.hh"
+#include "nix/util/thread-pool.hh"
 #include "nix/util/finally.hh"
 #include "nix/util/compression.hh"
 #include "nix/util/signals.hh"
@@ -21,6 +24,8 @@
 #include "nix/store/store-registration.hh"
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cstring>
 
 #include <memory>
@@ -33,6 +38,7 @@
 #include <fcntl.h>
 #include <stdio.h>
 #include <time.h>
+#include <thread>
 #include <variant>
 
 #ifndef _WIN32
@@ -63,6 +69,11 @@ void LocalBuildStoreConfig::anchor() {}
 
 void LocalStore::anchor() {}
 
+Sync<LocalStore::State>::WriteLock LocalStore::lockState()
+{
+    return _state->lock(daemon::recordStateLockWait);
+}
+
 void GcStore::anchor() {}
 
 LocalStoreConfig::LocalStoreConfig(const std::filesystem::path & path, const Params & params)
@@ -121,6 +132,9 @@ struct LocalStore::State::Stmts
     SQLiteStmt QueryRealisedOutput;
     SQLiteStmt QueryPathFromHashPart;
     SQLiteStmt QueryValidPaths;
+    SQLiteStmt QueryAllPathSizes;
+    SQLiteStmt QueryAllReferences;
+    SQLiteStmt QueryDataVersion;
 };
 
 LocalStore::LocalStore(ref<const Config> config)
@@ -135,7 +149,7 @@ LocalStore::LocalStore(ref<const Config> config)
     , tempRootsDir(config->stateDir.get() / "temproots")
     , fnTempRoots(tempRootsDir / std::to_string(getpid()))
 {
-    auto state(_state->lock());
+    auto state(lockState());
     state->stmts = std::make_unique<State::Stmts>();
 
     /* Create missing state directories if they don't already exist. */
@@ -375,6 +389,9 @@ LocalStore::LocalStore(ref<const Config> config)
     // ensure efficient lookup.
     state->stmts->QueryPathFromHashPart.create(state->db, "select path from ValidPaths where path >= ? limit 1;");
     state->stmts->QueryValidPaths.create(state->db, "select path from ValidPaths");
+    state->stmts->QueryAllPathSizes.create(state->db, "select id, path, narSize from ValidPaths;");
+    state->stmts->QueryAllReferences.create(state->db, "select referrer, reference from Refs;");
+    state->stmts->QueryDataVersion.create(state->db, "pragma data_version;");
     if (experimentalFeatureSettings.isEnabled(Xp::CaDerivations)) {
         state->stmts->RegisterRealisedOutput.create(
             state->db,
@@ -445,7 +462,7 @@ LocalStore::~LocalStore()
     std::shared_future<void> future;
 
     {
-        auto state(_state->lock());
+        auto state(lockState());
         if (state->gcRunning)
             future = state->gcFuture;
     }
@@ -456,7 +473,7 @@ LocalStore::~LocalStore()
     }
 
     {
-        auto state(_state->lock());
+        auto state(lockState());
         if (state->gcThread.joinable())
             state->gcThread.join();
     }
@@ -679,7 +696,7 @@ void LocalStore::registerDrvOutputUnchecked(const Realisation & info)
 {
     experimentalFeatureSettings.require(Xp::CaDerivations);
     retrySQLite<void>([&]() {
-        auto state(_state->lock());
+        auto state(lockState());
         if (auto oldR = queryRealisation_(*state, info.id)) {
             if (info.isCompatibleWith(*oldR)) {
                 auto combinedSignatures = oldR->signatures;
@@ -714,7 +731,7 @@ void LocalStore::deleteBuildTraces(const std::set<DrvOutput> & keys)
 {
     experimentalFeatureSettings.require(Xp::CaDerivations);
     retrySQLite<void>([&]() {
-        auto state(_state->lock());
+        auto state(lockState());
         SQLiteTxn txn(state->db);
         for (const auto & key : keys) {
             state->stmts->DeleteRealisedOutputByName.use().apply(key.drvPath.to_string()).apply(key.outputName).exec();
@@ -784,7 +801,7 @@ void LocalStore::queryPathInfoUncached(
 {
     try {
         callback(retrySQLite<std::shared_ptr<const ValidPathInfo>>([&]() {
-            return queryPathInfoInternal(*_state->lock(), path);
+            return queryPathInfoInternal(*lockState(), path);
         }));
 
     } catch (...) {
@@ -867,7 +884,7 @@ bool LocalStore::isValidPath_(State & state, const StorePath & path)
 
 bool LocalStore::isValidPathUncached(const StorePath & path)
 {
-    return retrySQLite<bool>([&]() { return isValidPath_(*_state->lock(), path); });
+    return retrySQLite<bool>([&]() { return isValidPath_(*lockState(), path); });
 }
 
 StorePathSet LocalStore::queryValidPaths(const StorePathSet & paths, SubstituteFlag maybeSubstitute)
@@ -882,7 +899,7 @@ StorePathSet LocalStore::queryValidPaths(const StorePathSet & paths, SubstituteF
 StorePathSet LocalStore::queryAllValidPaths()
 {
     return retrySQLite<StorePathSet>([&]() {
-        auto state(_state->lock());
+        auto state(lockState());
         auto use(state->stmts->QueryValidPaths.use());
         StorePathSet res;
         while (use.next())
@@ -891,6 +908,59 @@ StorePathSet LocalStore::queryAllValidPaths()
     });
 }
 
+ref<const ReferenceGraph> LocalStore::getReferenceGraph()
+{
+    return retrySQLite<ref<const ReferenceGraph>>([&]() {
+        auto state(lockState());
+
+        /* Read both tables from the same snapshot. */
+        SQLiteTxn txn(state->db);
+
+        /* `data_version` only changes when other connections commit,
+           so also take our own changes into account. */
+        std::pair<int64_t, int64_t> version;
+        {
+            auto use(state->stmts->QueryDataVersion.use());
+            if (!use.next())
+                throw Error("querying the database version");
+            version = {use.getInt(0), sqlite3_total_changes(state->db)};
+        }
+
+        if (state->referenceGraph && state->referenceGraphVersion == version)
+            return ref(state->referenceGraph);
+
+        std::vector<StorePath> paths;
+        std::vector<uint64_t> narSizes;
+        boost::unordered_flat_map<int64_t, ReferenceGraph::Index> indices;
+        {
+            auto use(state->stmts->QueryAllPathSizes.use());
+            while (use.next()) {
+                indices.emplace(use.getInt(0), paths.size());
+                paths.push_back(parseStorePath(use.getStr(1)));
+                narSizes.push_back(use.isNull(2) ? 0 : use.getInt(2));
+            }
+        }
+
+        std::vector<ReferenceGraph::Edge> edges;
+        {
+            auto use(state->stmts->QueryAllReferences.use());
+            while (use.next()) {
+                auto referrer = indices.find(use.getInt(0));
+                auto reference = indices.find(use.getInt(1));
+                if (referrer != indices.end() && reference != indices.end())
+                    edges.push_back({referrer->second, reference->second});
+            }
+        }
+
+        txn.commit();
+
+        auto graph = make_ref<const ReferenceGraph>(std::move(paths), std::move(narSizes), edges);
+        state->referenceGraph = graph.get_ptr();
+        state->referenceGraphVersion = version;
+        return graph;
+    });
+}
+
 void LocalStore::queryReferrers(State & state, const StorePath & path, StorePathSet & referrers)
 {
     auto useQueryReferrers(state.stmts->QueryReferrers.use().apply(printStorePath(path)));
@@ -901,13 +971,13 @@ void LocalStore::queryReferrers(State & state, const StorePath & path, StorePath
 
 void LocalStore::queryReferrers(const StorePath & path, StorePathSet & referrers)
 {
-    return retrySQLite<void>([&]() { queryReferrers(*_state->lock(), path, referrers); });
+    return retrySQLite<void>([&]() { queryReferrers(*lockState(), path, referrers); });
 }
 
 StorePathSet LocalStore::queryValidDerivers(const StorePath & path)
 {
     return retrySQLite<StorePathSet>([&]() {
-        auto state(_state->lock());
+        auto state(lockState());
 
         auto useQueryValidDerivers(state->stmts->QueryValidDerivers.use().apply(printStorePath(path)));
 
@@ -923,7 +993,7 @@ std::map<std::string, std::optional<StorePath>>
 LocalStore::queryStaticPartialDerivationOutputMap(const StorePath & path)
 {
     return retrySQLite<std::map<std::string, std::optional<StorePath>>>([&]() {
-        auto state(_state->lock());
+        auto state(lockState());
         std::map<std::string, std::optional<StorePath>> outputs;
         uint64_t drvId;
         drvId = queryValidPathId(*state, path);
@@ -964,7 +1034,7 @@ std::optional<StorePath> LocalStore::queryPathFromHashPart(const std::string & h
     std::string prefix = storeDir + "/" + hashPart;
 
     return retrySQLite<std::optional<StorePath>>([&]() -> std::optional<StorePath> {
-        auto state(_state->lock());
+        auto state(lockState());
 
         auto useQueryPathFromHashPart(state->stmts->QueryPathFromHashPart.use().apply(prefix));
 
@@ -995,7 +1065,7 @@ void LocalStore::registerValidPaths(const ValidPathInfos & infos)
 #endif
 
     return retrySQLite<void>([&]() {
-        auto state(_state->lock());
+        auto state(lockState());
 
         SQLiteTxn txn(state->db);
         StorePathSet paths;
@@ -1056,7 +1126,7 @@ void LocalStore::invalidatePath(State & state, const StorePath & path)
 
 const PublicKeys & LocalStore::getPublicKeys()
 {
-    auto state(_state->lock());
+    auto state(lockState());
     if (!state->publicKeys)
         state->publicKeys = std::make_unique<PublicKeys>(getDefaultPublicKeys());
     return *state->publicKeys;
@@ -1397,7 +1467,7 @@ void PathInUse::anchor() {}
 void LocalStore::invalidatePathChecked(const StorePath & path)
 {
     retrySQLite<void>([&]() {
-        auto state(_state->lock());
+        auto state(lockState());
 
         SQLiteTxn txn(state->db);
 
@@ -1417,6 +1487,123 @@ void LocalStore::invalidatePathChecked(const StorePath & path)
     });
 }
 
+namespace {
+
+/**
+ * Limits the rate at which `verifyStore()` reads store contents,
+ * summed over all threads, by making readers that get ahead of
+ * schedule sleep.
+ */
+struct ReadRateLimiter
+{
+    const uint64_t bytesPerSecond;
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::atomic<uint64_t> bytesRead = 0;
+
+    void operator()(size_t n)
+    {
+        if (!bytesPerSecond)
+            return;
+        auto total = bytesRead += n;
+        std::this_thread::sleep_until(
+            start
+            + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                std::chrono::duration<double>((double) total / bytesPerSecond)));
+    }
+};
+
+struct ThrottledSink : Sink
+{
+    Sink & next;
+    ReadRateLimiter & limiter;
+
+    ThrottledSink(Sink & next, ReadRateLimiter & limiter)
+        : next(next)
+        , limiter(limiter)
+    {
+    }
+
+    void operator()(std::string_view data) override
+    {
+        limiter(data.size());
+        next(data);
+    }
+};
+
+/**
+ * Records the names of the links and store paths whose contents have
+ * been checked successfully, so that an interrupted `verifyStore()`
+ * can skip them when it's run again. The first line holds the time
+ * the verification started; checkpoints older than `maxAge` are
+ * ignored, since the skipped paths may have changed in the meantime.
+ */
+struct VerifyCheckpoint
+{
+    static constexpr time_t maxAge = 7 * 24 * 60 * 60;
+
+    const std::filesystem::path path;
+    std::set<std::string, std::less<>> done;
+    Sync<AutoCloseFD> fd;
+
+    VerifyCheckpoint(std::filesystem::path path_)
+        : path(std::move(path_))
+    {
+        bool resume = false;
+
+        if (pathExists(path)) {
+            auto lines = tokenizeString<std::vector<std::string>>(readFile(path), "\n");
+            std::optional<time_t> started;
+            if (!lines.empty() && hasPrefix(lines[0], "started "))
+                started = string2Int<time_t>(lines[0].substr(8));
+            if (started && time(nullptr) - *started < maxAge) {
+                resume = true;
+                done.insert(lines.begin() + 1, lines.end());
+                printInfo(
+                    "resuming interrupted verification from %s, skipping %d checked paths",
+                    PathFmt(path),
+                    done.size());
+            } else
+                printInfo("ignoring stale verification checkpoint %s", PathFmt(path));
+        }
+
+        auto fd_(fd.lock());
+        *fd_ = toDescriptor(open(
+            path.string().c_str(),
+            O_WRONLY | O_APPEND | O_CREAT | (resume ? 0 : O_TRUNC)
+#ifndef _WIN32
+                | O_CLOEXEC
+#endif
+            ,
+            0600));
+        if (!*fd_)
+            throw SysError("opening verification checkpoint %s", PathFmt(path));
+
+        if (!resume)
+            writeFull(fd_->get(), fmt("started %d\n", time(nullptr)));
+    }
+
+    bool isDone(std::string_view name) const
+    {
+        return done.contains(name);
+    }
+
+    void markDone(std::string_view name)
+    {
+        writeFull(fd.lock()->get(), std::string(name) + "\n");
+    }
+
+    /**
+     * Delete the checkpoint, because verification is complete.
+     */
+    void remove()
+    {
+        fd.lock()->close();
+        unlinkIfExists(path);
+    }
+};
+
+} // namespace
+
 bool LocalStore::verifyStore(bool checkContents, RepairFlag repair)
 {
     printInfo("reading the Nix store...");
@@ -1428,89 +1615,137 @@ bool LocalStore::verifyStore(bool checkContents, RepairFlag repair)
 
     auto [errors, validPaths] = verifyAllValidPaths(repair);
 
-    /* Optionally, check the content hashes (slow). */
+    /* Optionally, check the content hashes (slow). This is I/O bound
+       on large stores, so read and hash several paths in parallel. */
     if (checkContents) {
 
+        VerifyCheckpoint checkpoint(config->stateDir.get() / "verify-contents.checkpoint");
+        ReadRateLimiter limiter{.bytesPerSecond = config->verifyMaxBytesPerSecond};
+        std::atomic<bool> contentErrors = false;
+
         printInfo("checking link hashes...");
 
-        for (auto & link : DirectoryIterator{linksDir}) {
-            checkInterrupt();
-            auto name = link.path().filename();
-            printMsg(lvlTalkative, "checking contents of %s", PathFmt(name));
-            std::string hash =
-                hashPath(makeFSSourceAccessor(link.path()), FileIngestionMethod::NixArchive, HashAlgorithm::SHA256)
-                    .first.to_string(HashFormat::Nix32, false);
-            if (hash != name.string()) {
-                printError(
-                    "link %s was modified! expected hash %s, got '%s'", PathFmt(link.path()), name.string(), hash);
-                if (repair) {
-                    unlinkIfExists(link.path());
-                    printInfo("removed link %s", PathFmt(link.path()));
-                } else {
-                    errors = true;
-                }
+        {
+            ThreadPool pool(config->verifyJobs);
+
+            for (auto & link : DirectoryIterator{linksDir}) {
+                checkInterrupt();
+                auto name = link.path().filename().string();
+                if (checkpoint.isDone(name))
+                    continue;
+                pool.enqueue([&, path = link.path(), name]() {
+                    printMsg(lvlTalkative, "checking contents of %s", PathFmt(path.filename()));
+                    HashSink hashSink(HashAlgorithm::SHA256);
+                    ThrottledSink sink(hashSink, limiter);
+                    dumpPathSequentially(path, sink);
+                    std::string hash = hashSink.finish().hash.to_string(HashFormat::Nix32, false);
+                    if (hash != name) {
+                        printError("link %s was modified! expected hash %s, got '%s'", PathFmt(path), name, hash);
+                        if (repair) {
+                            unlinkIfExists(path);
+                            printInfo("removed link %s", PathFmt(path));
+                        } else {
+                            contentErrors = true;
+                        }
+                    } else
+                        checkpoint.markDone(name);
+                });
             }
+
+            pool.process();
         }
 
         printInfo("checking store hashes...");
 
-        Hash nullHash(HashAlgorithm::SHA256);
+        /* Paths are repaired after hashing, since building them from
+           several threads at once isn't supported. */
+        Sync<StorePathSet> toRepair;
 
-        for (auto & i : validPaths) {
-            try {
-                auto info =
-                    std::const_pointer_cast<ValidPathInfo>(std::shared_ptr<const ValidPathInfo>(queryPathInfo(i)));
-
-                /* Check the content hash (optionally - slow). */
-                printMsg(lvlTalkative, "checking contents of '%s'", printStorePath(i));
-
-                auto hashSink = HashSink(info->narHash.algo);
-
-                dumpPath(toRealPath(i), hashSink);
-                auto current = hashSink.finish();
-
-                if (info->narHash != nullHash && info->narHash != current.hash) {
-                    printError(
-                        "path '%s' was modified! expected hash '%s', got '%s'",
-                        printStorePath(i),
-                        info->narHash.to_string(HashFormat::Nix32, true),
-                        current.hash.to_string(HashFormat::Nix32, true));
-                    if (repair)
-                        getBuilder()->repairPath(i);
-                    else
-                        errors = true;
-                } else {
-
-                    bool update = false;
-
-                    /* Fill in missing hashes. */
-                    if (info->narHash == nullHash) {
-                        printInfo("fixing missing hash on '%s'", printStorePath(i));
-                        info->narHash = current.hash;
-                        update = true;
-                    }
+        {
+            ThreadPool pool(config->verifyJobs);
+
+            for (auto & i : validPaths) {
+                if (checkpoint.isDone(i.to_string()))
+                    continue;
+                pool.enqueue([&]() {
+                    try {
+                        Hash nullHash(HashAlgorithm::SHA256);
+
+                        auto info = std::const_pointer_cast<ValidPathInfo>(
+                            std::shared_ptr<const ValidPathInfo>(queryPathInfo(i)));
+
+                        /* Check the content hash (optionally - slow). */
+                        printMsg(lvlTalkative, "checking contents of '%s'", printStorePath(i));
+
+                        auto hashSink = HashSink(info->narHash.algo);
+                        ThrottledSink sink(hashSink, limiter);
+
+                        dumpPathSequentially(toRealPath(i), sink);
+                        auto current = hashSink.finish();
+
+                        if (info->narHash != nullHash && info->narHash != current.hash) {
+                            printError(
+                                "path '%s' was modified! expected hash '%s', got '%s'",
+                                printStorePath(i),
+                                info->narHash.to_string(HashFormat::Nix32, true),
+                                current.hash.to_string(HashFormat::Nix32, true));
+                            if (repair)
+                                toRepair.lock()->insert(i);
+                            else
+                                contentErrors = true;
+                            return;
+                        }
+
+                        bool update = false;
+
+                        /* Fill in missing hashes. */
+                        if (info->narHash == nullHash) {
+                            printInfo("fixing missing hash on '%s'", printStorePath(i));
+                            info->narHash = current.hash;
+                            update = true;
+                        }
+
+                        /* Fill in missing narSize fields (from old stores). */
+                        if (info->narSize == 0) {
+                            printInfo(
+                                "updating size field on '%s' to %s", printStorePath(i), current.numBytesDigested);
+                            info->narSize = current.numBytesDigested;
+                            update = true;
+                        }
+
+                        if (update)
+                            updatePathInfo(*lockState(), *info);
+
+                        checkpoint.markDone(i.to_string());
 
-                    /* Fill in missing narSize fields (from old stores). */
-                    if (info->narSize == 0) {
-                        printInfo("updating size field on '%s' to %s", printStorePath(i), current.numBytesDigested);
-                        info->narSize = current.numBytesDigested;
-                        update = true;
+                    } catch (Error & e) {
+                        /* It's possible that the path got GC'ed, so ignore
+                           errors on invalid paths. */
+                        if (isValidPath(i))
+                            logError(e.info());
+                        else
+                            logWarning(e.info());
+                        contentErrors = true;
                     }
+                });
+            }
 
-                    if (update)
-                        updatePathInfo(*_state->lock(), *info);
-                }
+            pool.process();
+        }
 
+        for (auto & i : *toRepair.lock()) {
+            try {
+                getBuilder()->repairPath(i);
             } catch (Error & e) {
-                /* It's possible that the path got GC'ed, so ignore
-                   errors on invalid paths. */
-                if (isValidPath(i))
-                    logError(e.info());
-                else
-                    logWarning(e.info());
-                errors = true;
+                logError(e.info());
+                contentErrors = true;
             }
         }
+
+        checkpoint.remove();
+
+        if (contentErrors)
+            errors = true;
     }
 
     return errors;
@@ -1585,7 +1820,7 @@ void LocalStore::verifyPath(
 
         if (canInvalidate) {
             printInfo("path '%s' disappeared, removing from database...", pathS);
-            invalidatePath(*_state->lock(), path);
+            invalidatePath(*lockState(), path);
         } else {
             printError("path '%s' disappeared, but it still has valid referrers!", pathS);
             if (repair)
@@ -1617,13 +1852,13 @@ std::optional<TrustedFlag> LocalStore::isTrustedClient()
 
 void LocalStore::vacuumDB()
 {
-    _state->lock()->db.exec("vacuum");
+    lockState()->db.exec("vacuum");
 }
 
 void LocalStore::addSignatures(const StorePath & storePath, const std::set<Signature> & sigs)
 {
     retrySQLite<void>([&]() {
-        auto state(_state->lock());
+        auto state(lockState());
 
         SQLiteTxn txn(state->db);
 
@@ -1671,7 +1906,7 @@ void LocalStore::queryRealisationUncached(
 {
     try {
         auto maybeRealisation = retrySQLite<std::optional<const UnkeyedRealisation>>(
-            [&]() { return queryRealisation_(*_state->lock(), id); });
+            [&]() { return queryRealisation_(*lockState(), id); });
         if (maybeRealisation)
             callback(std::make_shared<const UnkeyedRealisation>(maybeRealisation.value()));
         else
@@ -1,6 +1,7 @@
 #include "nix/util/base-n.hh"
 #include "nix/store/machines.hh"
 #include "nix/store/store-open.hh"
+#include "nix/store/globals.hh"
 
 #include <algorithm>
 
@@ -72,6 +73,8 @@ StoreReference Machine::completeStoreReference() const
             storeUri.params["ssh-key"] = sshKey->string();
         if (sshPublicHostKey != "")
             storeUri.params["base64-ssh-public-host-key"] = sshPublicHostKey;
+        if (auto persist = settings.getWorkerSettings().buildersSshControlPersist.get())
+            storeUri.params.try_emplace("control-persist", std::to_string(persist));
     }
 
     {
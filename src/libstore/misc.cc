@@ -94,13 +94,15 @@ querySubstitutablePathInfosAsync(Store & store, const StorePathCAMap & paths, Su
         co_return;
 
     co_await forEachAsync(paths, [&store, &infos](auto path) -> asio::awaitable<void> {
-        std::optional<Error> lastStoresException = std::nullopt;
-        for (auto & sub : getDefaultSubstituters()) {
-            if (lastStoresException.has_value()) {
-                logError(lastStoresException->info());
-                lastStoresException.reset();
-            }
+        /* Ask all substituters at once, so that the substituters that
+           don't have the path don't delay asking the next one. The
+           answers are still used in priority order. Once a substituter
+           has the path, the queries of the lower-priority ones are
+           abandoned when `queries` goes out of scope, so that waiting
+           for their answers doesn't hold up the caller. */
+        std::vector<std::pair<ref<Store>, StartedAsync<ref<const ValidPathInfo>>>> queries;
 
+        for (auto & sub : getDefaultSubstituters()) {
             auto subPath(path.first);
 
             // Recompute store path so that we can use a different store root.
@@ -122,11 +124,22 @@ querySubstitutablePathInfosAsync(Store & store, const StorePathCAMap & paths, Su
                 "checking substituter '%s' for path '%s'",
                 sub->config.getHumanReadableURI(),
                 sub->printStorePath(subPath));
+            queries.emplace_back(
+                sub,
+                co_await startAsync<ref<const ValidPathInfo>>([subPath, sub](Callback<ref<const ValidPathInfo>> cb) {
+                    sub->queryPathInfo(subPath, std::move(cb));
+                }));
+        }
+
+        std::optional<Error> lastStoresException = std::nullopt;
+        for (auto & [sub, query] : queries) {
+            if (lastStoresException.has_value()) {
+                logError(lastStoresException->info());
+                lastStoresException.reset();
+            }
+
             try {
-                auto info = co_await callbackToAwaitable<ref<const ValidPathInfo>>(
-                    [subPath, &sub](Callback<ref<const ValidPathInfo>> cb) {
-                        sub->queryPathInfo(subPath, std::move(cb));
-                    });
+                auto info = co_await query.get();
 
                 if (sub->storeDir != store.storeDir && !(info->isContentAddressed(*sub) && info->references.empty()))
                     continue;
@@ -249,8 +262,12 @@ MissingPaths Store::queryMissing(const std::vector<DerivedPath> & targets)
 
                             bool found = false;
                             for (auto & sub : getDefaultSubstituters()) {
-                                /* TODO: Asyncify this. */
-                                auto realisation = sub->queryRealisation({drvPath, outputName});
+                                auto realisation =
+                                    co_await callbackToAwaitable<std::shared_ptr<const UnkeyedRealisation>>(
+                                        [sub, id = DrvOutput{drvPath, outputName}](
+                                            Callback<std::shared_ptr<const UnkeyedRealisation>> cb) {
+                                            sub->queryRealisation(id, std::move(cb));
+                                        });
                                 if (!realisation)
                                     continue;
                                 found = true;
@@ -327,7 +344,8 @@ MissingPaths Store::queryMissing(const std::vector<DerivedPath> & targets)
 
     std::set<DerivedPath> startElts(targets.begin(), targets.end());
     std::set<DerivedPath> visited;
-    computeClosure(std::move(startElts), visited, std::move(getEdges));
+    computeClosure(
+        std::move(startElts), visited, std::move(getEdges), settings.getWorkerSettings().maxSubstituterQueries);
 
     return res;
 }
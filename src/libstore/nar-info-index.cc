@@ -0,0 +1,117 @@
+#include "nix/store/nar-info-index.hh"
+#include "nix/store/path.hh"
+#include "nix/util/serialise.hh"
+#include "nix/util/util.hh"
+
+#include <algorithm>
+#include <map>
+
+#include <boost/iostreams/device/mapped_file.hpp>
+#include <boost/filesystem/path.hpp>
+
+namespace nix {
+
+static constexpr std::string_view indexMagic{"nixidx\x00\x01", 8};
+
+static constexpr size_t entrySize = StorePath::HashLen + 2 * sizeof(uint64_t);
+
+NarInfoIndexShard::NarInfoIndexShard(std::shared_ptr<const void> storage, std::string_view data)
+    : storage(std::move(storage))
+    , data(data)
+{
+    if (!data.starts_with(indexMagic) || (data.size() - indexMagic.size()) % entrySize != 0)
+        throw Error("narinfo index shard is corrupt");
+}
+
+std::string NarInfoIndexShard::shardPath(std::string_view hashPart)
+{
+    return "index/" + std::string(hashPart.substr(0, prefixLength)) + ".idx";
+}
+
+NarInfoIndexShard NarInfoIndexShard::open(const std::filesystem::path & path)
+{
+    try {
+        /* mapped_file_source can't be constructed from a std::filesystem::path. */
+        auto mapping = std::make_shared<boost::iostreams::mapped_file_source>(boost::filesystem::path(path.native()));
+        if (!mapping->is_open())
+            throw Error("cannot memory-map narinfo index shard %s", PathFmt(path));
+        std::string_view data{mapping->data(), mapping->size()};
+        return {std::move(mapping), data};
+    } catch (std::ios_base::failure & e) {
+        throw Error("cannot memory-map narinfo index shard %s: %s", PathFmt(path), e.what());
+    }
+}
+
+NarInfoIndexShard NarInfoIndexShard::parse(std::string data)
+{
+    auto storage = std::make_shared<const std::string>(std::move(data));
+    std::string_view view{*storage};
+    return {std::move(storage), view};
+}
+
+std::string NarInfoIndexShard::serialise(std::vector<NarInfoIndexEntry> entries)
+{
+    std::map<std::string, NarInfoIndexEntry> sorted;
+    for (auto & entry : entries) {
+        if (entry.hashPart.size() != StorePath::HashLen)
+            throw Error("invalid hash part '%s' in narinfo index", entry.hashPart);
+        auto hashPart = entry.hashPart;
+        sorted.insert_or_assign(std::move(hashPart), std::move(entry));
+    }
+
+    StringSink sink;
+    sink.s.reserve(indexMagic.size() + sorted.size() * entrySize);
+    sink(indexMagic);
+    for (auto & [hashPart, entry] : sorted) {
+        sink(hashPart);
+        sink << entry.narSize << entry.fileSize;
+    }
+    return std::move(sink.s);
+}
+
+size_t NarInfoIndexShard::size() const
+{
+    return (data.size() - indexMagic.size()) / entrySize;
+}
+
+std::string_view NarInfoIndexShard::hashPartAt(size_t i) const
+{
+    return data.substr(indexMagic.size() + i * entrySize, StorePath::HashLen);
+}
+
+NarInfoIndexEntry NarInfoIndexShard::entryAt(size_t i) const
+{
+    auto p = (unsigned char *) data.data() + indexMagic.size() + i * entrySize + StorePath::HashLen;
+    return {
+        .hashPart = std::string(hashPartAt(i)),
+        .narSize = readLittleEndian<uint64_t>(p),
+        .fileSize = readLittleEndian<uint64_t>(p + sizeof(uint64_t)),
+    };
+}
+
+std::optional<NarInfoIndexEntry> NarInfoIndexShard::lookup(std::string_view hashPart) const
+{
+    size_t lo = 0, hi = size();
+    while (lo < hi) {
+        auto mid = lo + (hi - lo) / 2;
+        auto cmp = hashPartAt(mid).compare(hashPart);
+        if (cmp == 0)
+            return entryAt(mid);
+        if (cmp < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return std::nullopt;
+}
+
+std::vector<NarInfoIndexEntry> NarInfoIndexShard::entries() const
+{
+    std::vector<NarInfoIndexEntry> res;
+    res.reserve(size());
+    for (size_t i = 0; i < size(); ++i)
+        res.push_back(entryAt(i));
+    return res;
+}
+
+} // namespace nix
@@ -0,0 +1,118 @@
+#include "nix/store/reference-graph.hh"
+
+namespace nix {
+
+/**
+ * Build the adjacency arrays of the edges from `from` to `to` by
+ * counting sort.
+ */
+static void buildCSR(
+    size_t nodes,
+    std::span<const ReferenceGraph::Edge> edges,
+    ReferenceGraph::Index ReferenceGraph::Edge::*from,
+    ReferenceGraph::Index ReferenceGraph::Edge::*to,
+    std::vector<ReferenceGraph::Index> & start,
+    std::vector<ReferenceGraph::Index> & targets)
+{
+    start.assign(nodes + 1, 0);
+    for (auto & edge : edges)
+        start[edge.*from + 1]++;
+    for (size_t i = 0; i < nodes; ++i)
+        start[i + 1] += start[i];
+
+    targets.resize(edges.size());
+    auto next = start;
+    for (auto & edge : edges)
+        targets[next[edge.*from]++] = edge.*to;
+}
+
+ReferenceGraph::ReferenceGraph(
+    std::vector<StorePath> && paths_, std::vector<uint64_t> && narSizes_, std::span<const Edge> edges)
+    : paths(std::move(paths_))
+    , narSizes(std::move(narSizes_))
+{
+    assert(narSizes.size() == paths.size());
+
+    indices.reserve(paths.size());
+    for (Index i = 0; i < paths.size(); ++i)
+        indices.emplace(paths[i], i);
+
+    buildCSR(paths.size(), edges, &Edge::referrer, &Edge::reference, referenceStart, references);
+    buildCSR(paths.size(), edges, &Edge::reference, &Edge::referrer, referrerStart, referrers);
+}
+
+std::optional<ReferenceGraph::Index> ReferenceGraph::lookup(const StorePath & path) const
+{
+    auto i = indices.find(path);
+    if (i == indices.end())
+        return std::nullopt;
+    return i->second;
+}
+
+/**
+ * Depth-first search from `roots`, calling `visit` on every node
+ * reached exactly once.
+ */
+template<typename GetEdges, typename Visit>
+static ReferenceGraph::Set
+search(size_t size, std::span<const ReferenceGraph::Index> roots, GetEdges && getEdges, Visit && visit)
+{
+    ReferenceGraph::Set res(size);
+    std::vector<ReferenceGraph::Index> todo;
+
+    auto enqueue = [&](ReferenceGraph::Index i) {
+        if (!res[i]) {
+            res[i] = true;
+            visit(i);
+            todo.push_back(i);
+        }
+    };
+
+    for (auto root : roots)
+        enqueue(root);
+
+    while (!todo.empty()) {
+        auto i = todo.back();
+        todo.pop_back();
+        for (auto j : getEdges(i))
+            enqueue(j);
+    }
+
+    return res;
+}
+
+ReferenceGraph::Set ReferenceGraph::closure(std::span<const Index> roots, bool flipDirection) const
+{
+    return search(
+        size(),
+        roots,
+        [&](Index i) { return flipDirection ? referrersOf(i) : referencesOf(i); },
+        [](Index) {});
+}
+
+uint64_t ReferenceGraph::closureSize(std::span<const Index> roots) const
+{
+    uint64_t res = 0;
+    search(size(), roots, [&](Index i) { return referencesOf(i); }, [&](Index i) { res += narSizes[i]; });
+    return res;
+}
+
+uint64_t ReferenceGraph::totalNarSize(const Set & set) const
+{
+    uint64_t res = 0;
+    for (Index i = 0; i < size(); ++i)
+        if (set[i])
+            res += narSizes[i];
+    return res;
+}
+
+StorePathSet ReferenceGraph::toPaths(const Set & set) const
+{
+    StorePathSet res;
+    for (Index i = 0; i < size(); ++i)
+        if (set[i])
+            res.insert(paths[i]);
+    return res;
+}
+
+} // namespace nix
@@ -9,6 +9,7 @@
 #include "nix/store/remote-fs-accessor.hh"
 #include "nix/store/build-result.hh"
 #include "nix/store/remote-store.hh"
+#include "nix/store/daemon-stats.hh"
 #include "nix/store/remote-store-connection.hh"
 #include "nix/store/worker-protocol.hh"
 #include "nix/store/worker-protocol-impl.hh"
@@ -869,6 +870,16 @@ void RemoteStore::addBuildLog(const StorePath & drvPath, std::string_view log)
     readInt(conn->from);
 }
 
+daemon::Stats RemoteStore::queryDaemonStats()
+{
+    auto conn(getConnection());
+    if (!conn->protoVersion.features.contains(WorkerProto::featureQueryDaemonStats))
+        throw Error("the daemon of store '%s' does not support reporting statistics", config.getHumanReadableURI());
+    conn->to << WorkerProto::Op::QueryDaemonStats;
+    conn.processStderr();
+    return nlohmann::json::parse(readString(conn->from)).get<daemon::Stats>();
+}
+
 std::optional<std::string> RemoteStore::getVersion()
 {
     auto conn(getConnection());
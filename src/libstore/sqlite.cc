@@ -1,4 +1,5 @@
 #include "nix/store/sqlite.hh"
+#include "nix/store/daemon-stats.hh"
 #include "nix/util/environment-variables.hh"
 #include "nix/util/util.hh"
 #include "nix/util/url.hh"
@@ -282,6 +283,8 @@ SQLiteTxn::~SQLiteTxn()
 
 void handleSQLiteBusy(const SQLiteBusy & e, time_t & nextWarning)
 {
+    daemon::recordSQLiteBusyRetry();
+
     time_t now = time(nullptr);
     if (now > nextWarning) {
         nextWarning = now + 10;
@@ -5,6 +5,9 @@
 #include "nix/util/util.hh"
 #include "nix/util/exec.hh"
 #include "nix/util/base-n.hh"
+#include "nix/util/hash.hh"
+#include "nix/util/users.hh"
+#include "nix/store/pathlocks.hh"
 
 namespace nix {
 
@@ -72,6 +75,7 @@ SSHMaster::SSHMaster(
     std::string_view sshPublicHostKey,
     bool useMaster,
     bool compress,
+    unsigned int controlPersist,
     Descriptor logFD)
     : authority(authority)
     , hostnameAndUser([authority]() {
@@ -84,8 +88,9 @@ SSHMaster::SSHMaster(
     , fakeSSH(authority.to_string() == "localhost")
     , keyFile(std::move(keyFile))
     , sshPublicHostKey(parsePublicHostKey(authority.host, sshPublicHostKey))
-    , useMaster(useMaster && !fakeSSH)
+    , useMaster((useMaster || controlPersist > 0) && !fakeSSH)
     , compress(compress)
+    , controlPersist(fakeSSH ? 0 : controlPersist)
     , logFD(logFD)
     , tmpDir(make_ref<AutoDelete>(createTempDir("", "nix", 0700)))
 {
@@ -118,15 +123,34 @@ void SSHMaster::addCommonSSHOpts(OsStrings & args)
     args.push_back(OS_STR("-oLocalCommand=echo started"));
 }
 
-bool SSHMaster::isMasterRunning()
+bool SSHMaster::isMasterRunning(const std::filesystem::path & socketPath)
 {
     OsStrings args = {OS_STR("-O"), OS_STR("check"), string_to_os_string(hostnameAndUser)};
     addCommonSSHOpts(args);
+    if (!socketPath.empty())
+        args.insert(args.end(), {OS_STR("-S"), socketPath.native()});
 
     auto res = runProgram(RunOptions{.program = "ssh", .args = std::move(args), .mergeStderrToStdout = true});
     return res.first == 0;
 }
 
+std::filesystem::path SSHMaster::getPersistentSocketPath()
+{
+    /* Everything that affects how the master connection is set up
+       goes into the name, so that stores with e.g. different keys
+       don't share a connection. The name is kept short because
+       `sun_path` is. */
+    auto key = fmt(
+        "%s\n%s\n%s\n%s\n%d",
+        hostnameAndUser,
+        authority.port ? std::to_string(*authority.port) : "",
+        keyFile ? keyFile->string() : "",
+        sshPublicHostKey,
+        compress);
+    auto hash = compressHash(hashString(HashAlgorithm::SHA256, key), 12);
+    return getCacheDir() / "ssh" / (hash.to_string(HashFormat::Nix32, false) + ".sock");
+}
+
 Strings createSSHEnv()
 {
     // Copy the environment and set SHELL=/bin/sh
@@ -241,7 +265,27 @@ std::filesystem::path SSHMaster::startMaster()
     if (state->sshMaster != INVALID_DESCRIPTOR)
         return state->socketPath;
 
-    state->socketPath = tmpDir->path() / "ssh.sock";
+    /* A persistent master outlives this process and is shared with
+       other Nix processes (e.g. subsequent invocations of the build
+       hook), so it lives at a well-known location. The lock prevents
+       concurrent processes from racing to start it. */
+    AutoCloseFD persistLock;
+    if (controlPersist) {
+        state->socketPath = getPersistentSocketPath();
+        createDirs(state->socketPath.parent_path());
+        persistLock = openLockFile(state->socketPath.string() + ".lock", true);
+        lockFile(persistLock.get(), ltWrite, true);
+
+        if (isMasterRunning(state->socketPath)) {
+            debug("reusing SSH master connection %s", PathFmt(state->socketPath));
+            return state->socketPath;
+        }
+
+        /* A socket left behind by a master that died or timed out
+           would make the new master refuse to listen. */
+        tryUnlink(state->socketPath);
+    } else
+        state->socketPath = tmpDir->path() / "ssh.sock";
 
     Pipe out;
     out.create();
@@ -251,7 +295,7 @@ std::filesystem::path SSHMaster::startMaster()
 
     auto suspension = logger->suspend();
 
-    if (isMasterRunning())
+    if (!controlPersist && isMasterRunning())
         return state->socketPath;
 
     state->sshMaster = startProcess(
@@ -263,7 +307,14 @@ std::filesystem::path SSHMaster::startMaster()
             if (dup2(out.writeSide.get(), STDOUT_FILENO) == -1)
                 throw SysError("duping over stdout");
 
+            /* Don't get killed together with our process group
+               (e.g. the build hook's) when we're meant to persist. */
+            if (controlPersist && setsid() == -1)
+                throw SysError("creating a new session");
+
             OsStrings args = {"ssh", hostnameAndUser.c_str(), "-M", "-N", "-S", state->socketPath.string()};
+            if (controlPersist)
+                args.push_back(fmt("-oControlPersist=%d", controlPersist));
             if (verbosity >= lvlChatty)
                 args.push_back("-v");
             addCommonSSHOpts(args);
@@ -0,0 +1,7 @@
+#include "nix/store/stats-store.hh"
+
+namespace nix {
+
+void StatsStore::anchor() {}
+
+} // namespace nix
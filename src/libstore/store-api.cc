@@ -919,6 +919,18 @@ makeCopyPathMessage(const StoreConfig & srcCfg, const StoreConfig & dstCfg, std:
 
 void copyStorePath(
     Store & srcStore, Store & dstStore, const StorePath & storePath, RepairFlag repair, CheckSigsFlag checkSigs)
+{
+    copyStorePath(
+        srcStore, dstStore, storePath, repair, checkSigs, [&](Sink & sink) { srcStore.narFromPath(storePath, sink); });
+}
+
+void copyStorePath(
+    Store & srcStore,
+    Store & dstStore,
+    const StorePath & storePath,
+    RepairFlag repair,
+    CheckSigsFlag checkSigs,
+    fun<void(Sink &)> nar)
 {
     /* Bail out early (before starting a download from srcStore) if
        dstStore already has this path. */
@@ -966,7 +978,7 @@ void copyStorePath(
                 act.progress(total, info->narSize);
             });
             TeeSink tee{sink, progressSink};
-            srcStore.narFromPath(storePath, tee);
+            nar(tee);
         },
         [&]() {
             throw EndOfFile(
@@ -1433,10 +1433,9 @@ SingleDrvOutputs DerivationBuilderImpl::registerOutputs()
 
             auto tmpOutput = tempDir / "x";
 
-            /* Serialise and create a fresh copy of the output to break
-               any stale writable file descriptors. Copy through the
-               serialisation/deserialisation. TODO: Use copyRecursive here and
-               make use of reflinking. */
+            /* Create a fresh copy of the output to break any stale
+               writable file descriptors. File contents are copied by the
+               kernel (with reflinks where the file system supports them). */
             auto pathAccessor = makeFSSourceAccessor(actualPath);
             RestoreSink restoreSink{store.config->getLocalSettings().fsyncStorePaths};
             restoreSink.dstPath = tmpOutput;
@@ -27,6 +27,8 @@ const WorkerProto::Version WorkerProto::latest = {
         {
             std::string{WorkerProto::featureRealisationWithPath},
             std::string{WorkerProto::featureDeleteDeadSpecificReferrers},
+            std::string{WorkerProto::featureQueryDaemonStats},
+            std::string{WorkerProto::featureBuildResourceStats},
         },
 };
 
@@ -204,6 +206,30 @@ void WorkerProto::Serialise<std::optional<std::chrono::microseconds>>::write(
     }
 }
 
+std::optional<uint64_t>
+WorkerProto::Serialise<std::optional<uint64_t>>::read(const StoreDirConfig & store, WorkerProto::ReadConn conn)
+{
+    auto tag = readNum<uint8_t>(conn.from);
+    switch (tag) {
+    case 0:
+        return std::nullopt;
+    case 1:
+        return readNum<uint64_t>(conn.from);
+    default:
+        throw Error("Invalid optional tag from remote");
+    }
+}
+
+void WorkerProto::Serialise<std::optional<uint64_t>>::write(
+    const StoreDirConfig & store, WorkerProto::WriteConn conn, const std::optional<uint64_t> & optNum)
+{
+    if (!optNum.has_value()) {
+        conn.to << uint8_t{0};
+    } else {
+        conn.to << uint8_t{1} << *optNum;
+    }
+}
+
 DerivedPath WorkerProto::Serialise<DerivedPath>::read(const StoreDirConfig & store, WorkerProto::ReadConn conn)
 {
     auto s = readString(conn.from);
@@ -316,6 +342,14 @@ BuildResult WorkerProto::Serialise<BuildResult>::read(const StoreDirConfig & sto
         res.cpuUser = WorkerProto::Serialise<std::optional<std::chrono::microseconds>>::read(store, conn);
         res.cpuSystem = WorkerProto::Serialise<std::optional<std::chrono::microseconds>>::read(store, conn);
     }
+    if (conn.version.features.contains(WorkerProto::featureBuildResourceStats)) {
+        res.memoryPeak = WorkerProto::Serialise<std::optional<uint64_t>>::read(store, conn);
+        res.ioRead = WorkerProto::Serialise<std::optional<uint64_t>>::read(store, conn);
+        res.ioWrite = WorkerProto::Serialise<std::optional<uint64_t>>::read(store, conn);
+        res.cpuPressure = WorkerProto::Serialise<std::optional<std::chrono::microseconds>>::read(store, conn);
+        res.memoryPressure = WorkerProto::Serialise<std::optional<std::chrono::microseconds>>::read(store, conn);
+        res.ioPressure = WorkerProto::Serialise<std::optional<std::chrono::microseconds>>::read(store, conn);
+    }
 
     if (conn.version.features.contains(WorkerProto::featureRealisationWithPath)) {
         success.builtOutputs = WorkerProto::Serialise<std::map<OutputName, UnkeyedRealisation>>::read(store, conn);
@@ -367,6 +401,14 @@ void WorkerProto::Serialise<BuildResult>::write(
             WorkerProto::write(store, conn, res.cpuUser);
             WorkerProto::write(store, conn, res.cpuSystem);
         }
+        if (conn.version.features.contains(WorkerProto::featureBuildResourceStats)) {
+            WorkerProto::write(store, conn, res.memoryPeak);
+            WorkerProto::write(store, conn, res.ioRead);
+            WorkerProto::write(store, conn, res.ioWrite);
+            WorkerProto::write(store, conn, res.cpuPressure);
+            WorkerProto::write(store, conn, res.memoryPressure);
+            WorkerProto::write(store, conn, res.ioPressure);
+        }
 
         if (conn.version.features.contains(WorkerProto::featureRealisationWithPath)) {
             WorkerProto::write(store, conn, builtOutputs);
@@ -0,0 +1,119 @@
+#include "synthetic-tree.hh"
+
+#include "nix/util/archive.hh"
+#include "nix/util/file-system.hh"
+#include "nix/util/fs-sink.hh"
+
+#include <benchmark/benchmark.h>
+
+namespace nix {
+
+static constexpr size_t treeSize = 16 * 1024 * 1024;
+
+namespace {
+
+/**
+ * Consumes file contents without writing them anywhere, so that
+ * `parseDump()` has to read the whole NAR.
+ */
+struct DiscardingFileSystemObjectSink : FileSystemObjectSink
+{
+    void createDirectory(const CanonPath & path) override {}
+
+    void createSymlink(const CanonPath & path, const std::string & target) override {}
+
+    void createRegularFile(const CanonPath & path, fun<void(CreateRegularFileSink &)> func) override
+    {
+        struct : CreateRegularFileSink
+        {
+            void operator()(std::string_view data) override {}
+
+            void isExecutable() override {}
+        } crf;
+
+        func(crf);
+    }
+};
+
+/**
+ * A synthetic tree on disk and its serialisation, shared by the
+ * benchmarks of each shape.
+ */
+struct Fixture
+{
+    AutoDelete tmpDir{createTempDir()};
+    std::filesystem::path root = tmpDir.path() / "tree";
+    std::string nar;
+
+    Fixture(TreeShape shape)
+    {
+        createSyntheticTree(root, shape, treeSize);
+        StringSink sink;
+        dumpPath(root, sink);
+        nar = std::move(sink.s);
+    }
+};
+
+} // namespace
+
+static void BM_DumpPath(benchmark::State & state)
+{
+    Fixture fixture{TreeShape(state.range(0))};
+
+    for (auto _ : state) {
+        NullSink sink;
+        dumpPath(fixture.root, sink);
+    }
+
+    state.SetBytesProcessed(state.iterations() * fixture.nar.size());
+}
+
+BENCHMARK(BM_DumpPath)
+    ->ArgName("shape")
+    ->Arg(int(TreeShape::ManySmallFiles))
+    ->Arg(int(TreeShape::FewHugeFiles))
+    ->Unit(benchmark::kMillisecond);
+
+static void BM_ParseDump(benchmark::State & state)
+{
+    Fixture fixture{TreeShape(state.range(0))};
+
+    for (auto _ : state) {
+        DiscardingFileSystemObjectSink sink;
+        StringSource source{fixture.nar};
+        parseDump(sink, source);
+    }
+
+    state.SetBytesProcessed(state.iterations() * fixture.nar.size());
+}
+
+BENCHMARK(BM_ParseDump)
+    ->ArgName("shape")
+    ->Arg(int(TreeShape::ManySmallFiles))
+    ->Arg(int(TreeShape::FewHugeFiles))
+    ->Unit(benchmark::kMillisecond);
+
+static void BM_RestorePath(benchmark::State & state)
+{
+    Fixture fixture{TreeShape(state.range(0))};
+    auto dest = fixture.tmpDir.path() / "restored";
+
+    for (auto _ : state) {
+        StringSource source{fixture.nar};
+        restorePath(dest, source);
+
+        state.PauseTiming();
+        deletePath(dest);
+        state.ResumeTiming();
+    }
+
+    state.SetBytesProcessed(state.iterations() * fixture.nar.size());
+}
+
+BENCHMARK(BM_RestorePath)
+    ->ArgName("shape")
+    ->Arg(int(TreeShape::ManySmallFiles))
+    ->Arg(int(TreeShape::FewHugeFiles))
+    ->Unit(benchmark::kMillisecond);
+
+} // namespace nix
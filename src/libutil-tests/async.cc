@@ -0,0 +1,99 @@
+#include "nix/util/async.hh"
+#include <gtest/gtest.h>
+
+#include <boost/asio/detached.hpp>
+
+#include <future>
+#include <thread>
+
+namespace nix {
+
+TEST(startAsync, resultsInStartOrder)
+{
+    std::vector<std::thread> threads;
+    std::vector<int> results;
+
+    auto run = [&]() -> asio::awaitable<void> {
+        std::vector<StartedAsync<int>> started;
+
+        /* Later operations finish first. */
+        for (int i = 0; i < 3; ++i)
+            started.push_back(co_await startAsync<int>([&, i](Callback<int> cb) {
+                threads.emplace_back([i, cb = std::make_shared<Callback<int>>(std::move(cb))]() {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(20 * (3 - i)));
+                    (*cb)(i * 10);
+                });
+            }));
+
+        for (auto & s : started)
+            results.push_back(co_await s.get());
+    };
+
+    asio::io_context ctx;
+    std::exception_ptr ex;
+    asio::co_spawn(ctx, run(), [&](std::exception_ptr e) { ex = e; });
+    ctx.run();
+
+    for (auto & thread : threads)
+        thread.join();
+
+    ASSERT_FALSE(ex);
+    ASSERT_EQ(results, (std::vector<int>{0, 10, 20}));
+}
+
+TEST(startAsync, discardedResultsDontKeepContextAlive)
+{
+    std::thread thread;
+    std::promise<void> contextDone;
+    std::atomic<bool> called = false;
+
+    auto run = [&]() -> asio::awaitable<void> {
+        co_await startAsync<int>([&](Callback<int> cb) {
+            thread = std::thread([&,
+                                  done = contextDone.get_future(),
+                                  cb = std::make_shared<Callback<int>>(std::move(cb))]() {
+                done.wait_for(std::chrono::seconds(10));
+                called = true;
+                (*cb)(42);
+            });
+        });
+    };
+
+    {
+        asio::io_context ctx;
+        asio::co_spawn(ctx, run(), asio::detached);
+        ctx.run();
+    }
+
+    ASSERT_FALSE(called);
+
+    /* The result arrives after the context is gone, and is dropped. */
+    contextDone.set_value();
+    thread.join();
+}
+
+TEST(startAsync, propagatesExceptions)
+{
+    struct TestExn
+    {};
+
+    auto run = [&]() -> asio::awaitable<void> {
+        auto started = co_await startAsync<int>([](Callback<int> cb) {
+            try {
+                throw TestExn();
+            } catch (...) {
+                cb.rethrow();
+            }
+        });
+        co_await started.get();
+    };
+
+    asio::io_context ctx;
+    std::exception_ptr ex;
+    asio::co_spawn(ctx, run(), [&](std::exception_ptr e) { ex = e; });
+    ctx.run();
+
+    ASSERT_THROW(std::rethrow_exception(ex), TestExn);
+}
+
+} // namespace nix
@@ -0,0 +1,14 @@
+#include <benchmark/benchmark.h>
+#include "nix/util/configuration.hh"
+
+// Custom main to set up Nix before running benchmarks
+int main(int argc, char ** argv)
+{
+    // BLAKE3 hashing is behind an experimental feature
+    nix::experimentalFeatureSettings.set("extra-experimental-features", "blake3-hashes");
+
+    // Initialize and run benchmarks
+    ::benchmark::Initialize(&argc, argv);
+    ::benchmark::RunSpecifiedBenchmarks();
+    return 0;
+}
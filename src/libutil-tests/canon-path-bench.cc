@@ -0,0 +1,76 @@
+#include "nix/util/canon-path.hh"
+
+#include <benchmark/benchmark.h>
+
+namespace nix {
+
+/* Paths of the shape found in store paths with many small files. */
+static const std::string_view samplePath =
+    "/lib/python3.12/site-packages/setuptools/_vendor/importlib_metadata/../compat/py39.py";
+
+static void BM_CanonPathParse(benchmark::State & state)
+{
+    for (auto _ : state)
+        benchmark::DoNotOptimize(CanonPath(samplePath));
+}
+
+BENCHMARK(BM_CanonPathParse);
+
+static void BM_CanonPathAppend(benchmark::State & state)
+{
+    CanonPath dir(samplePath);
+
+    for (auto _ : state)
+        benchmark::DoNotOptimize(dir / "__pycache__");
+}
+
+BENCHMARK(BM_CanonPathAppend);
+
+static void BM_CanonPathIterate(benchmark::State & state)
+{
+    CanonPath path(samplePath);
+
+    for (auto _ : state)
+        for (auto component : path)
+            benchmark::DoNotOptimize(component);
+}
+
+BENCHMARK(BM_CanonPathIterate);
+
+static void BM_CanonPathParent(benchmark::State & state)
+{
+    CanonPath path(samplePath);
+
+    for (auto _ : state) {
+        auto p = path;
+        while (!p.isRoot())
+            p.pop();
+        benchmark::DoNotOptimize(p);
+    }
+}
+
+BENCHMARK(BM_CanonPathParent);
+
+static void BM_CanonPathIsWithin(benchmark::State & state)
+{
+    CanonPath path(samplePath);
+    CanonPath prefix("/lib/python3.12/site-packages");
+
+    for (auto _ : state)
+        benchmark::DoNotOptimize(path.isWithin(prefix));
+}
+
+BENCHMARK(BM_CanonPathIsWithin);
+
+static void BM_CanonPathCompare(benchmark::State & state)
+{
+    CanonPath a(samplePath);
+    CanonPath b("/lib/python3.12/site-packages/setuptools/_vendor/importlib_metadata.py");
+
+    for (auto _ : state)
+        benchmark::DoNotOptimize(a < b);
+}
+
+BENCHMARK(BM_CanonPathCompare);
+
+} // namespace nix
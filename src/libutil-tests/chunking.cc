@@ -0,0 +1,91 @@
+#include <gtest/gtest.h>
+
+#include "nix/util/chunking.hh"
+
+#include <random>
+#include <set>
+
+namespace nix {
+
+static std::string randomData(size_t size, uint64_t seed = 42)
+{
+    std::mt19937_64 rng(seed);
+    std::string data(size, 0);
+    for (auto & c : data)
+        c = (char) rng();
+    return data;
+}
+
+static std::vector<std::string> chunk(std::string_view data, size_t writeSize = 4096)
+{
+    std::vector<std::string> chunks;
+    ChunkingSink sink(ChunkingSink::Params::fromAverage(16 * 1024), [&](std::string_view c) { chunks.emplace_back(c); });
+    for (size_t pos = 0; pos < data.size(); pos += writeSize)
+        sink(data.substr(pos, writeSize));
+    sink.finish();
+    return chunks;
+}
+
+TEST(ChunkingSink, empty)
+{
+    EXPECT_TRUE(chunk("").empty());
+}
+
+TEST(ChunkingSink, concatenationIsInput)
+{
+    auto data = randomData(1024 * 1024);
+    std::string joined;
+    for (auto & c : chunk(data))
+        joined += c;
+    EXPECT_EQ(joined, data);
+}
+
+TEST(ChunkingSink, respectsSizeBounds)
+{
+    auto params = ChunkingSink::Params::fromAverage(16 * 1024);
+    auto chunks = chunk(randomData(4 * 1024 * 1024));
+    ASSERT_GT(chunks.size(), 1u);
+    for (size_t i = 0; i < chunks.size(); ++i) {
+        EXPECT_LE(chunks[i].size(), params.maxSize);
+        if (i + 1 < chunks.size())
+            EXPECT_GE(chunks[i].size(), params.minSize);
+    }
+}
+
+TEST(ChunkingSink, independentOfWriteSize)
+{
+    auto data = randomData(1024 * 1024);
+    EXPECT_EQ(chunk(data, 1), chunk(data, data.size()));
+    EXPECT_EQ(chunk(data, 1000), chunk(data, 65536));
+}
+
+TEST(ChunkingSink, maxSizeForUniformData)
+{
+    auto params = ChunkingSink::Params::fromAverage(16 * 1024);
+    auto chunks = chunk(std::string(params.maxSize * 3, 'x'));
+    ASSERT_EQ(chunks.size(), 3u);
+    for (auto & c : chunks)
+        EXPECT_EQ(c.size(), params.maxSize);
+}
+
+TEST(ChunkingSink, insertionOnlyChangesNearbyChunks)
+{
+    auto data = randomData(4 * 1024 * 1024);
+    auto before = chunk(data);
+    auto after = chunk(data.substr(0, 1234567) + "inserted" + data.substr(1234567));
+
+    std::set<std::string> known(before.begin(), before.end());
+    size_t reused = 0;
+    for (auto & c : after)
+        reused += known.count(c);
+
+    EXPECT_GE(reused + 3, after.size());
+}
+
+TEST(ChunkingSink, averageMustBePowerOfTwo)
+{
+    EXPECT_THROW(ChunkingSink::Params::fromAverage(10000), Error);
+    EXPECT_THROW(ChunkingSink::Params::fromAverage(32), Error);
+}
+
+} // namespace nix
@@ -0,0 +1,78 @@
+#include "synthetic-tree.hh"
+
+#include "nix/util/archive.hh"
+#include "nix/util/compression.hh"
+#include "nix/util/file-system.hh"
+
+#include <benchmark/benchmark.h>
+
+namespace nix {
+
+/**
+ * The NAR of a synthetic store path with many small files, which is
+ * what binary caches mostly compress.
+ */
+static const std::string & getNar()
+{
+    static const std::string nar = [] {
+        AutoDelete tmpDir{createTempDir()};
+        auto root = tmpDir.path() / "tree";
+        createSyntheticTree(root, TreeShape::ManySmallFiles, 8 * 1024 * 1024);
+        StringSink sink;
+        dumpPath(root, sink);
+        return std::move(sink.s);
+    }();
+    return nar;
+}
+
+static void BM_CompressionSink(benchmark::State & state, CompressionAlgo algo)
+{
+    auto & nar = getNar();
+    int level = state.range(0);
+
+    size_t compressedSize = 0;
+    for (auto _ : state) {
+        StringSink out;
+        auto sink = makeCompressionSink(algo, out, false, level);
+        (*sink)(nar);
+        sink->finish();
+        compressedSize = out.s.size();
+    }
+
+    state.SetBytesProcessed(state.iterations() * nar.size());
+    state.counters["ratio"] = compressedSize ? double(nar.size()) / compressedSize : 0;
+}
+
+/* -1 is the default level of each algorithm. */
+BENCHMARK_CAPTURE(BM_CompressionSink, none, CompressionAlgo::none)->Arg(-1)->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_CompressionSink, xz, CompressionAlgo::xz)->Arg(-1)->Arg(1)->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_CompressionSink, zstd, CompressionAlgo::zstd)
+    ->Arg(-1)
+    ->Arg(1)
+    ->Arg(9)
+    ->Arg(19)
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_CompressionSink, bzip2, CompressionAlgo::bzip2)->Arg(-1)->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_CompressionSink, brotli, CompressionAlgo::brotli)->Arg(-1)->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_CompressionSink, gzip, CompressionAlgo::gzip)->Arg(-1)->Unit(benchmark::kMillisecond);
+
+static void BM_DecompressionSink(benchmark::State & state, CompressionAlgo algo)
+{
+    auto compressed = compress(algo, getNar());
+
+    for (auto _ : state) {
+        NullSink out;
+        auto sink = makeDecompressionSink(algo, out);
+        (*sink)(compressed);
+        sink->finish();
+    }
+
+    state.SetBytesProcessed(state.iterations() * getNar().size());
+}
+
+BENCHMARK_CAPTURE(BM_DecompressionSink, xz, CompressionAlgo::xz)->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_DecompressionSink, zstd, CompressionAlgo::zstd)->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_DecompressionSink, bzip2, CompressionAlgo::bzip2)->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_DecompressionSink, brotli, CompressionAlgo::brotli)->Unit(benchmark::kMillisecond);
+
+} // namespace nix
@@ -2,6 +2,7 @@
 #include <gmock/gmock.h>
 
 #include "nix/util/file-descriptor.hh"
+#include "nix/util/file-system.hh"
 #include "nix/util/serialise.hh"
 #include "nix/util/signals.hh"
 
@@ -10,6 +11,7 @@
 #ifndef _WIN32
 #  include <fcntl.h>
 #  include <stdlib.h>
+#  include <unistd.h>
 #endif
 
 namespace nix {
@@ -322,4 +324,68 @@ TEST(WriteFull, RespectsAllowInterrupts)
     EXPECT_EQ(source.readLine(/*eofOk=*/true), "hello");
 }
 
+#ifndef _WIN32
+
+TEST(CopyFdRange, IntoFdSink)
+{
+    auto [srcFd, srcPath] = createTempFile();
+    AutoDelete delSrc(srcPath, false);
+    writeFull(srcFd.get(), "0123456789abcdef");
+
+    auto [dstFd, dstPath] = createTempFile();
+    AutoDelete delDst(dstPath, false);
+    {
+        FdSink sink(dstFd.get());
+        sink("xy");
+        copyFdRange(srcFd.get(), 4, 8, sink);
+        sink("z");
+        EXPECT_EQ(sink.written, 11u);
+    }
+
+    EXPECT_EQ(readFile(dstPath), "xy456789abz");
+}
+
+TEST(CopyFdRange, ThrowsOnEof)
+{
+    auto [srcFd, srcPath] = createTempFile();
+    AutoDelete delSrc(srcPath, false);
+    writeFull(srcFd.get(), "0123");
+
+    auto [dstFd, dstPath] = createTempFile();
+    AutoDelete delDst(dstPath, false);
+    FdSink sink(dstFd.get());
+
+    EXPECT_THROW(copyFdRange(srcFd.get(), 2, 8, sink), EndOfFile);
+}
+
+TEST(TeeSource, DrainIntoFdSink)
+{
+    auto [srcFd, srcPath] = createTempFile();
+    AutoDelete delSrc(srcPath, false);
+    writeFull(srcFd.get(), "header\n0123456789abcdef");
+    ASSERT_EQ(lseek(srcFd.get(), 0, SEEK_SET), 0);
+
+    auto [dstFd, dstPath] = createTempFile();
+    AutoDelete delDst(dstPath, false);
+
+    FdSource source(srcFd.get());
+    /* Use a small buffer so that the data is partly buffered and
+       partly still in the file. */
+    source.bufSize = 4;
+    EXPECT_EQ(source.readLine(), "header");
+
+    StringSink tee;
+    TeeSource teeSource(source, tee);
+    {
+        FdSink sink(dstFd.get());
+        teeSource.drainInto(sink, 10);
+    }
+
+    EXPECT_EQ(tee.s, "0123456789");
+    EXPECT_EQ(readFile(dstPath), "0123456789");
+    EXPECT_EQ(source.drain(), "abcdef");
+}
+
+#endif
+
 } // namespace nix
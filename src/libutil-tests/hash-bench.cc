@@ -0,0 +1,80 @@
+#include "synthetic-tree.hh"
+
+#include "nix/util/base-nix-32.hh"
+#include "nix/util/hash.hh"
+
+#include <benchmark/benchmark.h>
+
+namespace nix {
+
+static void BM_HashSink(benchmark::State & state, HashAlgorithm algo)
+{
+    std::mt19937 urng(0);
+    auto data = syntheticFileContents(urng, state.range(0));
+
+    for (auto _ : state) {
+        HashSink sink{algo};
+        sink(data);
+        benchmark::DoNotOptimize(sink.finish());
+    }
+
+    state.SetBytesProcessed(state.iterations() * data.size());
+}
+
+BENCHMARK_CAPTURE(BM_HashSink, sha256, HashAlgorithm::SHA256)->Arg(4 * 1024)->Arg(1024 * 1024)->Arg(64 * 1024 * 1024);
+BENCHMARK_CAPTURE(BM_HashSink, blake3, HashAlgorithm::BLAKE3)->Arg(4 * 1024)->Arg(1024 * 1024)->Arg(64 * 1024 * 1024);
+
+/**
+ * Hashing many small writes, as done when hashing a NAR while it is
+ * serialised.
+ */
+static void BM_HashSinkSmallWrites(benchmark::State & state, HashAlgorithm algo)
+{
+    std::mt19937 urng(0);
+    auto data = syntheticFileContents(urng, 1024 * 1024);
+    size_t chunkSize = state.range(0);
+
+    for (auto _ : state) {
+        HashSink sink{algo};
+        for (size_t pos = 0; pos < data.size(); pos += chunkSize)
+            sink(std::string_view(data).substr(pos, chunkSize));
+        benchmark::DoNotOptimize(sink.finish());
+    }
+
+    state.SetBytesProcessed(state.iterations() * data.size());
+}
+
+BENCHMARK_CAPTURE(BM_HashSinkSmallWrites, sha256, HashAlgorithm::SHA256)->Arg(8)->Arg(64)->Arg(4096);
+BENCHMARK_CAPTURE(BM_HashSinkSmallWrites, blake3, HashAlgorithm::BLAKE3)->Arg(8)->Arg(64)->Arg(4096);
+
+static void BM_BaseNix32Encode(benchmark::State & state)
+{
+    std::mt19937 urng(0);
+    auto data = syntheticFileContents(urng, state.range(0));
+    auto bytes = std::as_bytes(std::span(data));
+
+    for (auto _ : state)
+        benchmark::DoNotOptimize(BaseNix32::encode(bytes));
+
+    state.SetBytesProcessed(state.iterations() * data.size());
+}
+
+/* 20 bytes is the size of the hash part of a store path, 32 bytes
+   that of a SHA-256 hash. */
+BENCHMARK(BM_BaseNix32Encode)->Arg(20)->Arg(32)->Arg(64 * 1024);
+
+static void BM_BaseNix32Decode(benchmark::State & state)
+{
+    std::mt19937 urng(0);
+    auto data = syntheticFileContents(urng, state.range(0));
+    auto encoded = BaseNix32::encode(std::as_bytes(std::span(data)));
+
+    for (auto _ : state)
+        benchmark::DoNotOptimize(BaseNix32::decode(encoded));
+
+    state.SetBytesProcessed(state.iterations() * encoded.size());
+}
+
+BENCHMARK(BM_BaseNix32Decode)->Arg(20)->Arg(32)->Arg(64 * 1024);
+
+} // namespace nix
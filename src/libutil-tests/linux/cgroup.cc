@@ -0,0 +1,65 @@
+#include <gtest/gtest.h>
+
+#include "nix/util/cgroup.hh"
+#include "nix/util/file-system.hh"
+
+namespace nix::linux {
+
+using namespace std::chrono_literals;
+
+TEST(getCgroupStats, parsesAccountingFiles)
+{
+    std::filesystem::path cgroup = createTempDir();
+    AutoDelete delCgroup(cgroup, /*recursive=*/true);
+
+    writeFile(cgroup / "cpu.stat", "usage_usec 3000\nuser_usec 2000\nsystem_usec 1000\n");
+    writeFile(cgroup / "memory.peak", "1073741824\n");
+    writeFile(
+        cgroup / "io.stat",
+        "8:0 rbytes=1000 wbytes=2000 rios=1 wios=2 dbytes=0 dios=0\n"
+        "259:0 rbytes=30 wbytes=40 rios=3 wios=4 dbytes=0 dios=0\n");
+    writeFile(
+        cgroup / "memory.pressure",
+        "some avg10=0.00 avg60=0.00 avg300=0.00 total=1234\n"
+        "full avg10=0.00 avg60=0.00 avg300=0.00 total=567\n");
+
+    auto stats = getCgroupStats(cgroup);
+
+    EXPECT_EQ(stats.cpuUser, 2000us);
+    EXPECT_EQ(stats.cpuSystem, 1000us);
+    EXPECT_EQ(stats.memoryPeak, 1073741824);
+    EXPECT_EQ(stats.ioRead, 1030);
+    EXPECT_EQ(stats.ioWrite, 2040);
+    EXPECT_EQ(stats.memoryPressure, 1234us);
+    EXPECT_EQ(stats.cpuPressure, std::nullopt);
+    EXPECT_EQ(stats.ioPressure, std::nullopt);
+}
+
+TEST(getCgroupStats, missingControllers)
+{
+    std::filesystem::path cgroup = createTempDir();
+    AutoDelete delCgroup(cgroup, /*recursive=*/true);
+
+    auto stats = getCgroupStats(cgroup);
+
+    EXPECT_EQ(stats.cpuUser, std::nullopt);
+    EXPECT_EQ(stats.memoryPeak, std::nullopt);
+    EXPECT_EQ(stats.ioRead, std::nullopt);
+    EXPECT_EQ(stats.ioWrite, std::nullopt);
+}
+
+TEST(enableCgroupControllers, enablesOnlyAvailableControllers)
+{
+    std::filesystem::path cgroup = createTempDir();
+    AutoDelete delCgroup(cgroup, /*recursive=*/true);
+
+    writeFile(cgroup / "cgroup.controllers", "cpuset cpu io memory pids\n");
+    writeFile(cgroup / "cgroup.subtree_control", "memory\n");
+
+    auto missing = enableCgroupControllers(cgroup, {"cpu", "hugetlb", "memory"});
+
+    EXPECT_EQ(missing, StringSet{"hugetlb"});
+    EXPECT_EQ(readFile(cgroup / "cgroup.subtree_control"), "+cpu");
+}
+
+} // namespace nix::linux
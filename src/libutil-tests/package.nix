@@ -10,6 +10,7 @@
 
   rapidcheck,
   gtest,
+  gbenchmark,
   zstd,
   runCommand,
   util-linux,
@@ -17,6 +18,7 @@
   # Configuration Options
 
   version,
+  withBenchmarks ? false,
   withFuzzTargets ? false,
 }:
 
@@ -51,9 +53,13 @@ mkMesonExecutable (finalAttrs: {
   ]
   ++ lib.optionals stdenv.hostPlatform.isLinux [
     util-linux
+  ]
+  ++ lib.optionals withBenchmarks [
+    gbenchmark
   ];
 
   mesonFlags = [
+    (lib.mesonBool "benchmarks" withBenchmarks)
     (lib.mesonBool "fuzzers" withFuzzTargets)
   ];
 
@@ -72,6 +78,11 @@ mkMesonExecutable (finalAttrs: {
             + ''
               export _NIX_TEST_UNIT_DATA=${./data}
               ${stdenv.hostPlatform.emulator buildPackages} ${lib.getExe finalAttrs.finalPackage}
+            ''
+            + lib.optionalString withBenchmarks ''
+              ${stdenv.hostPlatform.emulator buildPackages} ${lib.getExe' finalAttrs.finalPackage "nix-util-benchmarks"}
+            ''
+            + ''
               for target in fuzz-parse-dump fuzz-parse-dump-case-hacked; do
                 ${if withFuzzTargets then "test -x" else "test ! -e"} \
                   "${finalAttrs.finalPackage}/bin/$target${stdenv.hostPlatform.extensions.executable}"
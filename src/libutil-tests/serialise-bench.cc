@@ -0,0 +1,99 @@
+#include "synthetic-tree.hh"
+
+#include "nix/util/file-system.hh"
+#include "nix/util/serialise.hh"
+
+#include <benchmark/benchmark.h>
+
+namespace nix {
+
+namespace {
+
+/**
+ * A `BufferedSink` that discards its output, to measure the cost of
+ * buffering itself.
+ */
+struct DiscardingBufferedSink : BufferedSink
+{
+    using BufferedSink::BufferedSink;
+
+    void writeUnbuffered(std::string_view data) override
+    {
+        benchmark::DoNotOptimize(data.data());
+    }
+};
+
+} // namespace
+
+/**
+ * Many small writes, like the NAR serialiser and the worker protocol
+ * do.
+ */
+static void BM_BufferedSinkSmallWrites(benchmark::State & state)
+{
+    size_t bufSize = state.range(0);
+    size_t writeSize = state.range(1);
+    std::string data(writeSize, 'x');
+    size_t totalSize = 16 * 1024 * 1024;
+
+    for (auto _ : state) {
+        DiscardingBufferedSink sink{bufSize};
+        for (size_t n = 0; n < totalSize; n += writeSize)
+            sink(data);
+        sink.flush();
+    }
+
+    state.SetBytesProcessed(state.iterations() * totalSize);
+}
+
+BENCHMARK(BM_BufferedSinkSmallWrites)
+    ->ArgNames({"bufSize", "writeSize"})
+    ->ArgsProduct({{4 * 1024, 32 * 1024, 256 * 1024}, {8, 128, 4096}});
+
+static void BM_FdSource(benchmark::State & state)
+{
+    AutoDelete tmpDir{createTempDir()};
+    auto path = tmpDir.path() / "data";
+    std::mt19937 urng(0);
+    writeFile(path, syntheticFileContents(urng, 64 * 1024 * 1024));
+    auto fd = openFileReadonly(path);
+
+    FdSource source{fd.get()};
+    source.bufSize = state.range(0);
+
+    for (auto _ : state) {
+        source.restart();
+        NullSink sink;
+        source.drainInto(sink);
+    }
+
+    state.SetBytesProcessed(state.iterations() * 64 * 1024 * 1024);
+}
+
+BENCHMARK(BM_FdSource)->ArgName("bufSize")->Arg(4 * 1024)->Arg(32 * 1024)->Arg(1024 * 1024);
+
+/**
+ * The overhead of turning a sink into a source with a coroutine,
+ * which is used e.g. to stream NARs into compression and hashing.
+ */
+static void BM_SinkToSource(benchmark::State & state)
+{
+    std::mt19937 urng(0);
+    auto data = syntheticFileContents(urng, 16 * 1024 * 1024);
+    size_t writeSize = state.range(0);
+
+    for (auto _ : state) {
+        auto source = sinkToSource([&](Sink & sink) {
+            for (size_t pos = 0; pos < data.size(); pos += writeSize)
+                sink(std::string_view(data).substr(pos, writeSize));
+        });
+        NullSink sink;
+        source->drainInto(sink);
+    }
+
+    state.SetBytesProcessed(state.iterations() * data.size());
+}
+
+BENCHMARK(BM_SinkToSource)->ArgName("writeSize")->Arg(128)->Arg(4 * 1024)->Arg(64 * 1024);
+
+} // namespace nix
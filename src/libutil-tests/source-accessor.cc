@@ -1,4 +1,7 @@
 #include "nix/util/fs-sink.hh"
+#include "nix/util/archive.hh"
+#include "nix/util/config-global.hh"
+#include "nix/util/finally.hh"
 #include "nix/util/file-system.hh"
 #include "nix/util/processes.hh"
 #include "nix/util/tests/gmock-matchers.hh"
@@ -7,6 +10,8 @@
 #include <gmock/gmock.h>
 #include <rapidcheck/gtest.h>
 
+#include <future>
+
 namespace nix {
 
 class FSSourceAccessorTest : public ::testing::Test
@@ -107,6 +112,148 @@ TEST_F(FSSourceAccessorTest, invalidateCacheDropsStaleDirFds)
     EXPECT_THAT(accessor, testing::HasSymlink(CanonPath("a/b/l"), "g"));
 }
 
+TEST_F(FSSourceAccessorTest, dumpPathReadAhead)
+{
+#ifdef _WIN32
+    GTEST_SKIP() << "symlinks have some problems under Wine";
+#endif
+    for (int i = 0; i < 50; ++i) {
+        createDirs(tmpDir / fmt("dir%d", i % 7) / "sub");
+        writeFile(tmpDir / fmt("dir%d", i % 7) / fmt("file%d", i), std::string(i * 997, 'a' + i % 26));
+        writeFile(tmpDir / fmt("dir%d", i % 7) / "sub" / fmt("file%d", i), fmt("%d", i));
+        createSymlink(fmt("file%d", i), tmpDir / fmt("dir%d", i % 7) / fmt("link%d", i));
+    }
+    /* Too large to be read ahead. */
+    writeFile(tmpDir / "dir0" / "large", std::string(3 << 20, 'x'));
+    chmod(tmpDir / "dir1" / "file1", 0755);
+
+    PathFilter filter = [](const std::string & path) { return !hasSuffix(path, "7"); };
+
+    Finally restore([&]() { globalConfig.set("nar-read-ahead", "16"); });
+
+    auto dump = [&](const std::string & readAhead) {
+        globalConfig.set("nar-read-ahead", readAhead);
+        StringSink sink;
+        makeFSSourceAccessor(tmpDir)->dumpPath(CanonPath::root, sink, filter);
+        return std::move(sink.s);
+    };
+
+    auto expected = dump("0");
+    EXPECT_EQ(dump("1"), expected);
+    EXPECT_EQ(dump("16"), expected);
+}
+
+TEST_F(FSSourceAccessorTest, dumpPathReadAheadConcurrent)
+{
+#ifdef _WIN32
+    GTEST_SKIP() << "symlinks have some problems under Wine";
+#endif
+    for (int i = 0; i < 200; ++i) {
+        createDirs(tmpDir / fmt("dir%d", i % 5));
+        writeFile(tmpDir / fmt("dir%d", i % 5) / fmt("file%d", i), std::string(i * 101, 'a' + i % 26));
+    }
+    /* Too few entries to be read ahead. */
+    createDirs(tmpDir / "small");
+    writeFile(tmpDir / "small" / "file", "small");
+
+    auto dump = [&]() {
+        StringSink sink;
+        makeFSSourceAccessor(tmpDir)->dumpPath(CanonPath::root, sink);
+        return std::move(sink.s);
+    };
+
+    auto expected = dump();
+
+    StringSink sequential;
+    dumpPathSequentially(tmpDir, sequential);
+    EXPECT_EQ(sequential.s, expected);
+
+    /* Concurrent calls share the read-ahead threads. */
+    std::vector<std::future<std::string>> results;
+    for (int i = 0; i < 8; ++i)
+        results.push_back(std::async(std::launch::async, dump));
+    for (auto & result : results)
+        EXPECT_EQ(result.get(), expected);
+}
+
+TEST_F(FSSourceAccessorTest, restorePathParallel)
+{
+#ifdef _WIN32
+    GTEST_SKIP() << "symlinks have some problems under Wine";
+#endif
+    auto src = tmpDir / "src";
+    for (int i = 0; i < 200; ++i) {
+        createDirs(src / fmt("dir%d", i % 13));
+        writeFile(src / fmt("dir%d", i % 13) / fmt("file%d", i), std::string(i * 31, 'a' + i % 26));
+        createSymlink(fmt("file%d", i), src / fmt("dir%d", i % 13) / fmt("link%d", i));
+    }
+    /* Too large to be written by the workers. */
+    writeFile(src / "dir0" / "large", std::string(3 << 20, 'x'));
+    chmod(src / "dir1" / "file1", 0755);
+
+    StringSink nar;
+    dumpPath(src, nar);
+
+    Finally restore([&]() { globalConfig.set("restore-threads", "8"); });
+
+    for (auto threads : {"0", "1", "8"}) {
+        globalConfig.set("restore-threads", threads);
+        auto dst = tmpDir / fmt("dst%s", threads);
+        StringSource source{nar.s};
+        restorePath(dst, source);
+        StringSink nar2;
+        dumpPath(dst, nar2);
+        EXPECT_EQ(nar2.s, nar.s);
+    }
+
+    /* Files that are too large for the workers are written through an
+       `FdSink`, so that `FdSource::drainInto()` can let the kernel copy
+       them. */
+    {
+        RestoreSink sink(false);
+        sink.dstPath = tmpDir / "large";
+        sink.enableParallelWrites();
+        sink.createDirectory(CanonPath::root);
+        sink.createRegularFile(CanonPath("small"), [](CreateRegularFileSink & crf) {
+            crf.preallocateContents(5);
+            auto fdSink = dynamic_cast<FdSink *>(&crf);
+            ASSERT_TRUE(fdSink);
+            EXPECT_EQ(fdSink->fd, INVALID_DESCRIPTOR);
+            crf("small");
+        });
+        sink.createRegularFile(CanonPath("large"), [](CreateRegularFileSink & crf) {
+            crf.preallocateContents(3 << 20);
+            auto fdSink = dynamic_cast<FdSink *>(&crf);
+            ASSERT_TRUE(fdSink);
+            EXPECT_NE(fdSink->fd, INVALID_DESCRIPTOR);
+            crf(std::string(3 << 20, 'x'));
+        });
+        sink.finish();
+        EXPECT_EQ(readFile(tmpDir / "large" / "small"), "small");
+        EXPECT_EQ(readFile(tmpDir / "large" / "large"), std::string(3 << 20, 'x'));
+    }
+
+    /* Restoring from a file gives the same result. */
+    writeFile(tmpDir / "nar", nar.s);
+    {
+        AutoCloseFD fd = openFileReadonly(tmpDir / "nar");
+        FdSource source{fd.get()};
+        restorePath(tmpDir / "dst-fd", source);
+        StringSink nar2;
+        dumpPath(tmpDir / "dst-fd", nar2);
+        EXPECT_EQ(nar2.s, nar.s);
+    }
+
+    /* Errors of the workers are reported by finish(). */
+    RestoreSink sink(false);
+    sink.dstPath = tmpDir / "dup";
+    sink.enableParallelWrites();
+    sink.createDirectory(CanonPath::root);
+    sink.createRegularFile(CanonPath("a"), [](CreateRegularFileSink & crf) { crf("1"); });
+    sink.createRegularFile(CanonPath("a"), [](CreateRegularFileSink & crf) { crf("2"); });
+    EXPECT_THROW(sink.finish(), SysError);
+}
+
 /* ----------------------------------------------------------------------------
  * RestoreSink non-directory at root (no dirFd)
  * --------------------------------------------------------------------------*/
@@ -0,0 +1,91 @@
+#include "synthetic-tree.hh"
+
+#include "nix/util/file-system.hh"
+#include "nix/util/fmt.hh"
+
+#include <array>
+
+namespace nix {
+
+std::string syntheticFileContents(std::mt19937 & urng, size_t size)
+{
+    static constexpr std::array words{
+        "the",    "store",   "path",  "derivation", "output", "lib",    "include", "return", "static", "void",
+        "const",  "struct",  "int",   "if",         "else",   "for",    "while",   "nix",    "hash",   "sha256",
+        "{",      "}",       "(",     ")",          ";",      "\n",     "    ",    "=",      "==",     "->",
+        "string", "license", "false", "true",       "null",   "export", "import",  "def",    "self",   "#",
+    };
+
+    std::string res;
+    res.reserve(size + 16);
+
+    std::uniform_int_distribution<size_t> wordDist{0, words.size() - 1};
+    std::uniform_int_distribution<size_t> runDist{64, 4096};
+    std::uniform_int_distribution<int> byteDist{0, 255};
+    std::bernoulli_distribution binaryDist{0.25};
+
+    while (res.size() < size) {
+        auto runEnd = std::min(size, res.size() + runDist(urng));
+        if (binaryDist(urng))
+            while (res.size() < runEnd)
+                res.push_back(static_cast<char>(byteDist(urng)));
+        else
+            while (res.size() < runEnd) {
+                res += words[wordDist(urng)];
+                res.push_back(' ');
+            }
+    }
+
+    res.resize(size);
+    return res;
+}
+
+void createSyntheticTree(const std::filesystem::path & path, TreeShape shape, size_t totalSize)
+{
+    std::mt19937 urng(static_cast<unsigned>(shape));
+
+    createDirs(path);
+
+    switch (shape) {
+
+    case TreeShape::ManySmallFiles: {
+        /* File sizes in store paths are roughly log-normally
+           distributed, with a median of about 1 KiB. */
+        std::lognormal_distribution<double> sizeDist{7.0, 1.5};
+
+        std::filesystem::path dir = path;
+        size_t written = 0;
+        for (size_t n = 0; written < totalSize; ++n) {
+            if (n % 16 == 0) {
+                dir = path;
+                for (size_t depth = 0, d = n / 16; depth < 4; ++depth, d /= 5)
+                    dir /= fmt("dir-%d", d % 5);
+                createDirs(dir);
+            }
+
+            auto file = dir / fmt("file-%d", n);
+            if (n % 32 == 31) {
+                createSymlink(fmt("file-%d", n - 1), file);
+                continue;
+            }
+
+            auto size = std::min<size_t>(sizeDist(urng), 256 * 1024);
+            writeFile(file, syntheticFileContents(urng, size), n % 8 == 0 ? 0755 : 0644);
+            written += size;
+        }
+        break;
+    }
+
+    case TreeShape::FewHugeFiles: {
+        createDirs(path / "bin");
+        createDirs(path / "lib");
+        for (size_t n = 0; n < 4; ++n)
+            writeFile(path / "lib" / fmt("huge-%d.so", n), syntheticFileContents(urng, totalSize / 4), 0755);
+        writeFile(path / "bin" / "tool", syntheticFileContents(urng, 4096), 0755);
+        createSymlink("../lib/huge-0.so", path / "bin" / "huge");
+        break;
+    }
+    }
+}
+
+} // namespace nix
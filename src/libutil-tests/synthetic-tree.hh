@@ -0,0 +1,42 @@
+#pragma once
+///@file
+
+#include <filesystem>
+#include <random>
+#include <string>
+
+namespace nix {
+
+/**
+ * Shapes of store path contents that stress different parts of the
+ * NAR, hashing and compression code.
+ */
+enum class TreeShape : int {
+    /**
+     * Many small files in a deep directory hierarchy, with some
+     * symlinks and executables, like a Python environment or a source
+     * tree.
+     */
+    ManySmallFiles,
+
+    /**
+     * A few huge files, like a compiler toolchain or a disk image.
+     */
+    FewHugeFiles,
+};
+
+/**
+ * Generate `size` bytes of file contents that compress about as well
+ * as typical store path contents: a mix of text made of a small
+ * vocabulary and random binary data.
+ */
+std::string syntheticFileContents(std::mt19937 & urng, size_t size);
+
+/**
+ * Create a file tree of the given shape at `path`, with about
+ * `totalSize` bytes of file contents. The tree only depends on the
+ * arguments, so benchmark results are comparable between runs.
+ */
+void createSyntheticTree(const std::filesystem::path & path, TreeShape shape, size_t totalSize);
+
+} // namespace nix
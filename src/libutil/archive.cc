@@ -1,4 +1,7 @@
+#include <atomic>
 #include <cerrno>
+#include <deque>
+#include <future>
 #include <map>
 
 #include <strings.h> // for strcasecmp
@@ -10,6 +13,8 @@
 #include "nix/util/source-path.hh"
 #include "nix/util/file-system.hh"
 #include "nix/util/signals.hh"
+#include "nix/util/finally.hh"
+#include "nix/util/thread-pool.hh"
 
 namespace nix {
 
@@ -28,6 +33,21 @@ public:
 #endif
         "use-case-hack",
         "Whether to enable a macOS-specific hack for dealing with file name case collisions."};
+
+    Setting<unsigned int> narReadAhead{
+        this,
+        16,
+        "nar-read-ahead",
+        R"(
+          The number of directory entries whose metadata and contents
+          are read in parallel when serialising a file system tree as a
+          NAR, e.g. when copying or hashing store paths. This hides the
+          latency of network file systems and cold storage. Only the
+          contents of files smaller than 1 MiB are read ahead, up to
+          64 MiB in total.
+
+          Set to 0 to read entries one at a time.
+        )"};
 };
 
 static ArchiveSettings archiveSettings;
@@ -41,7 +61,70 @@ static constexpr size_t narMaxDepth = 64;
 
 PathFilter defaultPathFilter = [](const std::string &) { return true; };
 
-void SourceAccessor::dumpPath(const CanonPath & path, Sink & sink, PathFilter & filter)
+/* Regular files up to this size are read ahead into memory; larger
+   ones are streamed to the sink when their turn comes. */
+static constexpr uint64_t readAheadMaxFileSize = 1 << 20;
+
+/* Upper bound on the file contents buffered by the read-ahead of a
+   single dumpPath() call. */
+static constexpr uint64_t readAheadMaxBuffered = 64 << 20;
+
+/* Directories with fewer entries than this are read sequentially,
+   since the read-ahead wouldn't pay for handing them to other
+   threads. */
+static constexpr size_t readAheadMinEntries = 4;
+
+namespace {
+
+/**
+ * A directory entry read ahead by `dumpPath()`.
+ */
+struct ReadAheadEntry
+{
+    SourceAccessor::Stat st;
+
+    /**
+     * The contents of a small regular file, and the number of bytes
+     * this accounts for in the read-ahead buffer.
+     */
+    std::optional<std::string> contents;
+    uint64_t buffered = 0;
+
+    /**
+     * The target of a symlink.
+     */
+    std::optional<std::string> target;
+};
+
+} // namespace
+
+static ReadAheadEntry readAhead(SourceAccessor & accessor, const CanonPath & path, std::atomic<uint64_t> & buffered)
+{
+    ReadAheadEntry entry{.st = accessor.lstat(path)};
+
+    if (entry.st.type == SourceAccessor::tRegular && entry.st.fileSize
+        && *entry.st.fileSize <= readAheadMaxFileSize) {
+        auto size = *entry.st.fileSize;
+        if (buffered.fetch_add(size) + size <= readAheadMaxBuffered) {
+            entry.buffered = size;
+            try {
+                entry.contents = accessor.readFile(path);
+            } catch (...) {
+                buffered -= size;
+                throw;
+            }
+        } else
+            buffered -= size;
+    }
+
+    else if (entry.st.type == SourceAccessor::tSymlink)
+        entry.target = accessor.readLink(path);
+
+    return entry;
+}
+
+static void
+dumpPath(SourceAccessor & rootAccessor, const CanonPath & path, Sink & sink, PathFilter & filter, bool allowReadAhead)
 {
     auto dumpContents = [&sink](SourceAccessor & accessor, const CanonPath & path) {
         sink << "contents";
@@ -54,31 +137,42 @@ void SourceAccessor::dumpPath(const CanonPath & path, Sink & sink, PathFilter &
         writePadding(*size, sink);
     };
 
+    /* If the accessor supports it, the metadata and the contents of
+       small files of the next entries of a directory are read in
+       parallel, while the sink is fed in NAR order. This hides the
+       latency of network file systems and cold storage. */
+    std::atomic<uint64_t> buffered = 0;
+
     sink << narVersionMagic1;
 
-    [&sink, &filter, &dumpContents](
+    [&sink, &filter, &dumpContents, &buffered, allowReadAhead](
         this const auto & dump,
         SourceAccessor & accessor,
         const CanonPath & path,
         const CanonPath & filterPath,
-        size_t depth) -> void {
+        size_t depth,
+        ReadAheadEntry * readAheadEntry) -> void {
         checkInterrupt();
 
         if (depth >= narMaxDepth)
             throw Error("path '%s' exceeds maximum NAR directory depth of %d", accessor.showPath(path), narMaxDepth);
 
-        auto st = accessor.lstat(path);
+        auto st = readAheadEntry ? readAheadEntry->st : accessor.lstat(path);
 
         sink << "(";
 
-        if (st.type == tRegular) {
+        if (st.type == SourceAccessor::tRegular) {
             sink << "type" << "regular";
             if (st.isExecutable)
                 sink << "executable" << "";
-            dumpContents(accessor, path);
+            if (readAheadEntry && readAheadEntry->contents) {
+                sink << "contents" << *readAheadEntry->contents;
+                buffered -= readAheadEntry->buffered;
+            } else
+                dumpContents(accessor, path);
         }
 
-        else if (st.type == tDirectory) {
+        else if (st.type == SourceAccessor::tDirectory) {
             sink << "type" << "directory";
 
             /* If we're on a case-insensitive system like macOS, undo
@@ -99,23 +193,66 @@ void SourceAccessor::dumpPath(const CanonPath & path, Sink & sink, PathFilter &
                     unhacked.emplace(i.first, i.first);
 
             accessor.readDirectory(path, [&](SourceAccessor & subdirAccessor, const CanonPath & subdirRelPath) {
+                size_t window = allowReadAhead ? archiveSettings.narReadAhead.get() : 0;
+
+                std::vector<const StringMap::value_type *> entries;
                 for (auto & i : unhacked)
-                    if (filter((filterPath / i.first).abs())) {
-                        sink << "entry" << "(" << "name" << i.first << "node";
-                        dump(subdirAccessor, subdirRelPath / i.second, filterPath / i.second, depth + 1);
+                    if (filter((filterPath / i.first).abs()))
+                        entries.push_back(&i);
+
+                if (!window || entries.size() < readAheadMinEntries || !subdirAccessor.allowsConcurrentReads()) {
+                    for (auto i : entries) {
+                        sink << "entry" << "(" << "name" << i->first << "node";
+                        dump(subdirAccessor, subdirRelPath / i->second, filterPath / i->second, depth + 1, nullptr);
                         sink << ")";
                     }
+                    return;
+                }
+
+                auto & pool = getSharedThreadPool();
+
+                std::deque<std::future<ReadAheadEntry>> pending;
+                size_t next = 0;
+
+                /* The read-ahead refers to `subdirAccessor`, which only
+                   lives as long as this callback. */
+                Finally waitForPending([&]() {
+                    for (auto & f : pending)
+                        f.wait();
+                });
+
+                for (auto i : entries) {
+                    while (next < entries.size() && pending.size() < window)
+                        pending.push_back(pool.enqueue(
+                            window,
+                            [&subdirAccessor, &buffered, path = subdirRelPath / entries[next++]->second]() {
+                                return readAhead(subdirAccessor, path, buffered);
+                            }));
+
+                    auto entry = pending.front().get();
+                    pending.pop_front();
+
+                    sink << "entry" << "(" << "name" << i->first << "node";
+                    dump(subdirAccessor, subdirRelPath / i->second, filterPath / i->second, depth + 1, &entry);
+                    sink << ")";
+                }
             });
         }
 
-        else if (st.type == tSymlink)
-            sink << "type" << "symlink" << "target" << accessor.readLink(path);
+        else if (st.type == SourceAccessor::tSymlink)
+            sink << "type" << "symlink" << "target"
+                 << (readAheadEntry && readAheadEntry->target ? *readAheadEntry->target : accessor.readLink(path));
 
         else
             throw Error("file '%s' has an unsupported type", path);
 
         sink << ")";
-    }(*this, path, path, 0);
+    }(rootAccessor, path, path, 0, nullptr);
+}
+
+void SourceAccessor::dumpPath(const CanonPath & path, Sink & sink, PathFilter & filter)
+{
+    nix::dumpPath(*this, path, sink, filter, true);
 }
 
 void ArchiveSettings::anchor() {}
@@ -133,6 +270,12 @@ void dumpPath(const std::filesystem::path & path, Sink & sink, PathFilter & filt
     path2.dumpPath(sink, filter);
 }
 
+void dumpPathSequentially(const std::filesystem::path & path, Sink & sink)
+{
+    SourcePath path2 = makeFSSourceAccessor(absPath(path), /*trackLastModified=*/false);
+    dumpPath(*path2.accessor, path2.path, sink, defaultPathFilter, false);
+}
+
 void dumpString(std::string_view s, Sink & sink)
 {
     sink << narVersionMagic1 << "(" << "type" << "regular" << "contents" << s << ")";
@@ -311,7 +454,9 @@ void restorePath(const std::filesystem::path & path, Source & source, bool start
 {
     RestoreSink sink{startFsync};
     sink.dstPath = path;
+    sink.enableParallelWrites();
     parseDump(sink, source);
+    sink.finish();
 }
 
 void copyNAR(Source & source, Sink & sink)
@@ -0,0 +1,116 @@
+#include "nix/util/chunking.hh"
+#include "nix/util/error.hh"
+
+#include <array>
+#include <bit>
+
+namespace nix {
+
+/**
+ * The gear table: one pseudo-random 64-bit value per byte value,
+ * generated with splitmix64 so that it doesn't need to be spelled out
+ * here. Changing it changes all chunk boundaries, and therefore
+ * defeats deduplication against previously uploaded chunks.
+ */
+static constexpr std::array<uint64_t, 256> gearTable = []() {
+    std::array<uint64_t, 256> table{};
+    uint64_t state = 0;
+    for (auto & entry : table) {
+        state += 0x9e3779b97f4a7c15ULL;
+        uint64_t z = state;
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        entry = z ^ (z >> 31);
+    }
+    return table;
+}();
+
+/**
+ * A mask selecting the `n` most significant bits. The gear hash shifts
+ * left, so these depend on the longest window of preceding bytes.
+ */
+static constexpr uint64_t topBits(unsigned int n)
+{
+    return n == 0 ? 0 : ~0ULL << (64 - n);
+}
+
+void ChunkingSink::anchor() {}
+
+ChunkingSink::Params ChunkingSink::Params::fromAverage(size_t avgSize)
+{
+    if (!std::has_single_bit(avgSize) || avgSize < 64)
+        throw Error("average chunk size %d is not a power of two of at least 64", avgSize);
+    return {
+        .minSize = avgSize / 4,
+        .avgSize = avgSize,
+        .maxSize = avgSize * 8,
+    };
+}
+
+ChunkingSink::ChunkingSink(Params params, fun<void(std::string_view chunk)> onChunk)
+    : params(params)
+    , onChunk(std::move(onChunk))
+{
+    assert(params.minSize <= params.avgSize && params.avgSize <= params.maxSize && params.maxSize > 0);
+
+    /* Normalised chunking (level 2): make cuts harder before the
+       average size and easier after it, which narrows the chunk size
+       distribution. */
+    auto bits = (unsigned int) std::bit_width(params.avgSize) - 1;
+    maskSmall = topBits(std::min(bits + 2, 64u));
+    maskLarge = topBits(bits >= 2 ? bits - 2 : 0);
+}
+
+size_t ChunkingSink::findCut(std::string_view pending)
+{
+    auto end = std::min(pending.size(), params.maxSize);
+    auto normal = std::min(params.avgSize, end);
+    auto data = reinterpret_cast<const unsigned char *>(pending.data());
+
+    /* Bytes before the minimum size can never be a cut point, so don't
+       bother hashing them. */
+    size_t i = std::max(scanned, params.minSize);
+
+    for (; i < normal; ++i) {
+        fingerprint = (fingerprint << 1) + gearTable[data[i]];
+        if (!(fingerprint & maskSmall))
+            return i + 1;
+    }
+
+    for (; i < end; ++i) {
+        fingerprint = (fingerprint << 1) + gearTable[data[i]];
+        if (!(fingerprint & maskLarge))
+            return i + 1;
+    }
+
+    scanned = i;
+
+    return end == params.maxSize ? end : 0;
+}
+
+void ChunkingSink::operator()(std::string_view data)
+{
+    buffer.append(data);
+
+    /* Erase the emitted chunks from the buffer all at once, since
+       erasing each of them would move the rest of the buffer. */
+    std::string_view pending(buffer);
+    while (auto cut = findCut(pending)) {
+        onChunk(pending.substr(0, cut));
+        pending.remove_prefix(cut);
+        scanned = 0;
+        fingerprint = 0;
+    }
+    buffer.erase(0, buffer.size() - pending.size());
+}
+
+void ChunkingSink::finish()
+{
+    if (!buffer.empty())
+        onChunk(buffer);
+    buffer.clear();
+    scanned = 0;
+    fingerprint = 0;
+}
+
+} // namespace nix
@@ -205,6 +205,22 @@ std::string drainFD(Descriptor fd, DrainFdOpts opts)
 void copyFdRange(Descriptor fd, off_t offset, size_t nbytes, Sink & sink)
 {
     auto left = nbytes;
+
+    /* If we're writing to a file, let the kernel copy (or clone) the
+       data. If it can't, fall back to copying through a buffer. */
+    if (auto fdSink = dynamic_cast<FdSink *>(&sink); fdSink && fdSink->fd != INVALID_DESCRIPTOR && left) {
+        fdSink->flush();
+        while (left) {
+            auto n = copyFileRange(fd, &offset, fdSink->fd, left);
+            if (!n)
+                break;
+            if (*n == 0)
+                throw EndOfFile("unexpected end-of-file reading from %1%", PathFmt(descriptorToPath(fd)));
+            fdSink->written += *n;
+            left -= *n;
+        }
+    }
+
     std::array<std::byte, 64 * 1024> buf;
 
     while (left) {
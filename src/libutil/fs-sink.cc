@@ -1,9 +1,14 @@
 #include <fcntl.h>
 
+#include <deque>
+#include <future>
+
 #include "nix/util/error.hh"
 #include "nix/util/config-global.hh"
 #include "nix/util/file-system-at.hh"
 #include "nix/util/fs-sink.hh"
+#include "nix/util/thread-pool.hh"
+#include "nix/util/finally.hh"
 
 #ifdef _WIN32
 #  include <fileapi.h>
@@ -72,6 +77,23 @@ struct RestoreSinkSettings : Config
 {
     Setting<bool> preallocateContents{
         this, false, "preallocate-contents", "Whether to preallocate files when writing objects with known size."};
+
+    Setting<unsigned int> restoreThreads{
+        this,
+        8,
+        "restore-threads",
+        R"(
+          The number of threads that create files when unpacking a NAR
+          into the file system, e.g. when substituting a store path. The
+          NAR is still parsed in order, but the files in it are created
+          and written in parallel, which helps for store paths consisting
+          of many small files. Only files smaller than 1 MiB are handed to
+          these threads, up to 64 MiB in total. The threads are shared
+          with the other NARs unpacked by the same process at the same
+          time.
+
+          Set to 0 to create files one at a time.
+        )"};
 };
 
 static RestoreSinkSettings restoreSinkSettings;
@@ -143,6 +165,112 @@ getParentFdAndName(Descriptor dirFd, const std::filesystem::path & dstPath, cons
 }
 #endif
 
+/* Regular files up to this size are buffered and written by the
+   workers; larger ones are written synchronously. */
+static constexpr uint64_t workersMaxFileSize = 1 << 20;
+
+/* Upper bound on the file contents buffered for the workers. */
+static constexpr uint64_t workersMaxBuffered = 64 << 20;
+
+struct RestoreSink::Workers
+{
+    std::atomic<uint64_t> buffered = 0;
+
+    /* The work items run on the shared thread pool, on at most this
+       many threads. */
+    size_t maxThreads;
+
+    /* The work items that haven't been waited for yet, oldest
+       first. */
+    std::deque<std::future<void>> pending;
+
+    Workers(size_t maxThreads)
+        : maxThreads(maxThreads)
+    {
+    }
+
+    /* The work items refer to `buffered`, so wait for them even if
+       the restore failed. */
+    ~Workers()
+    {
+        for (auto & f : pending)
+            f.wait();
+    }
+
+    /**
+     * Reserve space for `size` bytes of buffered file contents. If this
+     * fails, the file must be written synchronously.
+     */
+    bool reserve(uint64_t size)
+    {
+        if (size > workersMaxFileSize || buffered.fetch_add(size) + size > workersMaxBuffered) {
+            buffered -= size;
+            return false;
+        }
+        return true;
+    }
+
+    template<typename F>
+    void enqueue(F && work)
+    {
+        /* Report the error of a work item that already failed, so
+           that we don't carry on restoring. */
+        while (!pending.empty() && pending.front().wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+            popFront();
+        pending.push_back(getSharedThreadPool().enqueue(maxThreads, std::forward<F>(work)));
+    }
+
+    /**
+     * Wait for all work items, and rethrow the first error.
+     */
+    void finish()
+    {
+        while (!pending.empty())
+            popFront();
+    }
+
+private:
+
+    void popFront()
+    {
+        auto f = std::move(pending.front());
+        pending.pop_front();
+        f.get();
+    }
+};
+
+void RestoreSink::enableParallelWrites()
+{
+#ifndef _WIN32
+    if (restoreSinkSettings.restoreThreads)
+        workers = std::make_shared<Workers>(restoreSinkSettings.restoreThreads);
+#endif
+}
+
+void RestoreSink::finish()
+{
+    if (auto workers = std::move(this->workers))
+        workers->finish();
+}
+
+bool RestoreSink::canDefer(const CanonPath & path)
+{
+    return workers && dirFd && !path.isRoot() && path.parent()->isRoot();
+}
+
+Descriptor RestoreSink::getSharedDirFd()
+{
+#ifndef _WIN32
+    if (!sharedDirFd) {
+        AutoCloseFD fd = fcntl(dirFd.get(), F_DUPFD_CLOEXEC, 0);
+        if (!fd)
+            throw SysError("duplicating file descriptor of directory %s", PathFmt(dstPath));
+        sharedDirFd = std::make_shared<AutoCloseFD>(std::move(fd));
+    }
+#endif
+    return sharedDirFd->get();
+}
+
 void RestoreSink::createDirectory(const CanonPath & path, DirectoryCreatedCallback callback)
 {
     if (path.isRoot()) {
@@ -155,6 +283,7 @@ void RestoreSink::createDirectory(const CanonPath & path, DirectoryCreatedCallba
     assert(dirFd); // If that's not true the above call must have thrown an exception.
 
     RestoreSink dirSink{startFsync};
+    dirSink.workers = workers;
     dirSink.dstPath = append(dstPath, path);
     dirSink.dirFd = openFileEnsureBeneathNoSymlinks(
         dirFd.get(),
@@ -240,33 +369,143 @@ struct RestoreRegularFile : CreateRegularFileSink, FdSink
 
 void RestoreRegularFile::anchor() {}
 
-void RestoreSink::createRegularFile(const CanonPath & path, fun<void(CreateRegularFileSink &)> func)
+#ifndef _WIN32
+static AutoCloseFD openNewRegularFile(Descriptor parentFd, const CanonPath & name)
+{
+    /* O_EXCL together with O_CREAT ensures symbolic links in the last
+       component are not followed. The file is opened for reading as
+       well so that data copied into it by the kernel can be hashed by
+       reading it back (see `TeeSource::drainInto()`). */
+    return openFileEnsureBeneathNoSymlinks(parentFd, name, O_CREAT | O_EXCL | O_RDWR | O_CLOEXEC, 0666);
+}
+#endif
+
+AutoCloseFD RestoreSink::openRegularFile(const CanonPath & path)
 {
-    auto crf = RestoreRegularFile(
-        startFsync,
 #ifdef _WIN32
-        CreateFileW(
-            append(dstPath, path).c_str(),
-            GENERIC_READ | GENERIC_WRITE,
-            FILE_SHARE_READ | FILE_SHARE_WRITE,
-            NULL,
-            CREATE_NEW,
-            FILE_ATTRIBUTE_NORMAL,
-            NULL)
+    AutoCloseFD fd = CreateFileW(
+        append(dstPath, path).c_str(),
+        GENERIC_READ | GENERIC_WRITE,
+        FILE_SHARE_READ | FILE_SHARE_WRITE,
+        NULL,
+        CREATE_NEW,
+        FILE_ATTRIBUTE_NORMAL,
+        NULL);
 #else
-        [&]() {
-            /* O_EXCL together with O_CREAT ensures symbolic links in the last
-               component are not followed. */
-            constexpr int flags = O_CREAT | O_EXCL | O_WRONLY | O_CLOEXEC;
-            auto [_parentFd, fd, name] = getParentFdAndName(dirFd.get(), dstPath, path);
-            return openFileEnsureBeneathNoSymlinks(fd, name, flags, 0666);
-        }()
+    auto [_parentFd, parentFd, name] = getParentFdAndName(dirFd.get(), dstPath, path);
+    auto fd = openNewRegularFile(parentFd, name);
 #endif
-    );
-    if (!crf.fd)
+    if (!fd)
         throw NativeSysError("creating file %1%", PathFmt(append(dstPath, path)));
+    return fd;
+}
+
+void RestoreSink::createRegularFile(const CanonPath & path, fun<void(CreateRegularFileSink &)> func)
+{
+    if (!canDefer(path)) {
+        auto crf = RestoreRegularFile(startFsync, openRegularFile(path));
+        func(crf);
+        crf.flush();
+        return;
+    }
+
+#ifndef _WIN32
+    /* Buffer the contents so that a worker can write the file, unless
+       it turns out to be too big. In that case the file is written
+       directly, and since this is still an `FdSink`, the contents can
+       be copied into it by the kernel (see `FdSource::drainInto()`).
+       While buffering, the `FdSink` has no file descriptor. */
+    struct BufferedRegularFile : RestoreRegularFile
+    {
+        RestoreSink & sink;
+        const CanonPath & path;
+        std::string contents;
+        bool executable = false;
+        std::optional<uint64_t> reserved;
+
+        BufferedRegularFile(RestoreSink & sink, const CanonPath & path)
+            : RestoreRegularFile(sink.startFsync, AutoCloseFD{})
+            , sink(sink)
+            , path(path)
+        {
+        }
+
+        void operator()(std::string_view data) override
+        {
+            if (fd)
+                BufferedSink::operator()(data);
+            else
+                contents.append(data);
+        }
+
+        void isExecutable() override
+        {
+            executable = true;
+            if (fd)
+                RestoreRegularFile::isExecutable();
+        }
+
+        void preallocateContents(uint64_t size) override
+        {
+            if (fd || reserved)
+                return;
+            if (contents.empty() && sink.workers->reserve(size)) {
+                reserved = size;
+                contents.reserve(size);
+            } else {
+                writeDirectly();
+                RestoreRegularFile::preallocateContents(size);
+            }
+        }
+
+        void writeDirectly()
+        {
+            fd = sink.openRegularFile(path);
+            FdSink::fd = fd.get();
+            if (executable)
+                RestoreRegularFile::isExecutable();
+            BufferedSink::operator()(contents);
+            contents.clear();
+        }
+    } crf{*this, path};
+
     func(crf);
-    crf.flush();
+
+    if (!crf.fd && !crf.reserved) {
+        if (workers->reserve(crf.contents.size()))
+            crf.reserved = crf.contents.size();
+        else
+            crf.writeDirectly();
+    }
+
+    if (crf.fd) {
+        crf.flush();
+        return;
+    }
+
+    getSharedDirFd();
+
+    /* Note: `~Workers` waits for the work items, so they don't need
+       to keep `workers` alive. */
+    workers->enqueue([&buffered = workers->buffered,
+                      sharedDirFd = sharedDirFd,
+                      dstPath = append(dstPath, path),
+                      name = CanonPath::fromFilename(*path.baseName()),
+                      contents = std::move(crf.contents),
+                      executable = crf.executable,
+                      startFsync = startFsync,
+                      reserved = *crf.reserved]() {
+        Finally releaseBuffer([&]() { buffered -= reserved; });
+        auto fd = openNewRegularFile(sharedDirFd->get(), name);
+        if (!fd)
+            throw NativeSysError("creating file %1%", PathFmt(dstPath));
+        RestoreRegularFile file(startFsync, std::move(fd));
+        if (executable)
+            file.isExecutable();
+        file(contents);
+        file.flush();
+    });
+#endif
 }
 
 void RestoreRegularFile::isExecutable()
@@ -304,6 +543,18 @@ void RestoreRegularFile::preallocateContents(uint64_t len)
 void RestoreSink::createSymlink(const CanonPath & path, const std::string & target)
 {
 #ifndef _WIN32
+    if (canDefer(path)) {
+        getSharedDirFd();
+        workers->enqueue([sharedDirFd = sharedDirFd,
+                          dstPath = append(dstPath, path),
+                          name = CanonPath::fromFilename(*path.baseName()),
+                          target]() {
+            if (::symlinkat(requireCString(target), sharedDirFd->get(), name.rel_c_str()) == -1)
+                throw SysError("creating symlink from %1% -> '%2%'", PathFmt(dstPath), target);
+        });
+        return;
+    }
+
     auto [_parentFd, fd, name] = getParentFdAndName(dirFd.get(), dstPath, path);
     if (::symlinkat(requireCString(target), fd, name.rel_c_str()) == -1)
         throw SysError("creating symlink from %1% -> '%2%'", PathFmt(append(dstPath, path)), target);
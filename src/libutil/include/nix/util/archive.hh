@@ -62,6 +62,12 @@ void dumpPath(const std::filesystem::path & path, Sink & sink, PathFilter & filt
  */
 time_t dumpPathAndGetMtime(const std::filesystem::path & path, Sink & sink, PathFilter & filter = defaultPathFilter);
 
+/**
+ * Same as dumpPath(), but never reads ahead (see `nar-read-ahead`),
+ * so files are only read as fast as `sink` consumes them.
+ */
+void dumpPathSequentially(const std::filesystem::path & path, Sink & sink);
+
 /**
  * Dump an archive with a single file with these contents.
  *
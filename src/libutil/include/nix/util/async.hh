@@ -11,8 +11,11 @@
 #include <boost/asio/awaitable.hpp>
 #include <boost/asio/use_awaitable.hpp>
 #include <boost/asio/associated_cancellation_slot.hpp>
+#include <boost/asio/executor_work_guard.hpp>
 
 #include <concepts>
+#include <functional>
+#include <optional>
 
 namespace nix {
 
@@ -46,10 +49,9 @@ auto callbackToAwaitable(F && initiate, CompletionToken && token)
                 Callback<T>([executor,
                              done,
                              h,
-                             /* Ugly, but we need a work guard for the actual executor to ensure that the io_context
-                                stays alive until the callback has finished on possibly another thread. */
-                             guard = asio::make_work_guard(
-                                 static_cast<asio::io_context &>(asio::query(executor, asio::execution::context)))](
+                             /* We need a work guard for the executor to ensure that the io_context stays alive
+                                until the callback has finished on possibly another thread. */
+                             guard = asio::make_work_guard(executor)](
                                 std::future<T> fut) mutable {
                     auto releaseOwnership = [&]() {
                         /* Release our ownership. If the callback is owned by another thread, we don't want to be
@@ -87,6 +89,81 @@ asio::awaitable<T> callbackToAwaitable(F && initiate)
     co_return fut.get();
 }
 
+/**
+ * An asynchronous operation started by `startAsync()`.
+ */
+template<typename T>
+class StartedAsync
+{
+    struct State
+    {
+        std::optional<std::future<T>> result;
+        std::function<void()> resume;
+
+        /**
+         * Keeps the executor running until the operation finishes,
+         * but only for as long as its result may be consumed.
+         */
+        asio::executor_work_guard<asio::any_io_executor> guard;
+    };
+
+    std::shared_ptr<State> state;
+
+    StartedAsync(asio::any_io_executor executor)
+        : state(std::make_shared<State>(State{.guard = asio::make_work_guard(executor)}))
+    {
+    }
+
+    template<typename U, std::invocable<Callback<U>> F>
+    friend asio::awaitable<StartedAsync<U>> startAsync(F && initiate);
+
+public:
+
+    /**
+     * Wait for the operation to finish, and return its result. Must be
+     * called at most once, on the executor that started the operation.
+     */
+    asio::awaitable<T> get()
+    {
+        if (!state->result)
+            co_await asio::async_initiate<decltype(asio::use_awaitable), void()>(
+                [this](auto handler) {
+                    auto h = std::make_shared<decltype(handler)>(std::move(handler));
+                    state->resume = [h]() { std::move(*h)(); };
+                },
+                asio::use_awaitable);
+        co_return state->result->get();
+    }
+};
+
+/**
+ * Start a callback-based operation now, but wait for its result later
+ * with `StartedAsync::get()`. Unlike with `callbackToAwaitable()`,
+ * several operations can be in flight while their results are
+ * consumed in a fixed order. If the `StartedAsync` is destroyed before
+ * the operation finishes, its result is discarded and the executor is
+ * no longer kept running for it, so that operations whose results
+ * aren't needed anymore don't hold up the caller.
+ */
+template<typename T, std::invocable<Callback<T>> F>
+asio::awaitable<StartedAsync<T>> startAsync(F && initiate)
+{
+    StartedAsync<T> res(co_await asio::this_coro::executor);
+    initiate(Callback<T>([weakState = std::weak_ptr(res.state)](std::future<T> fut) {
+        /* The work guard in the state keeps the executor running
+           while we hold on to it. */
+        auto state = weakState.lock();
+        if (!state)
+            return;
+        asio::post(state->guard.get_executor(), [state, fut = std::move(fut)]() mutable {
+            state->result = std::move(fut);
+            if (auto resume = std::exchange(state->resume, {}))
+                resume();
+        });
+    }));
+    co_return res;
+}
+
 template<typename Range, typename F>
 asio::awaitable<void> forEachAsync(Range && range, const F & f)
 {
@@ -0,0 +1,70 @@
+#pragma once
+///@file
+
+#include "nix/util/serialise.hh"
+#include "nix/util/fun.hh"
+
+namespace nix {
+
+/**
+ * A sink that splits its input into content-defined chunks, using the
+ * FastCDC algorithm (gear rolling hash with normalised chunking).
+ *
+ * Chunk boundaries depend only on the bytes around them, so inserting
+ * or removing data only changes the chunks near the edit. This makes
+ * the chunks suitable for deduplicating similar files by chunk hash.
+ */
+class ChunkingSink : public FinishSink
+{
+    void anchor() override;
+
+public:
+    struct Params
+    {
+        size_t minSize;
+        size_t avgSize;
+        size_t maxSize;
+
+        /**
+         * The parameters recommended by the FastCDC paper for the
+         * given average chunk size, which must be a power of two.
+         */
+        static Params fromAverage(size_t avgSize);
+    };
+
+    /**
+     * @param onChunk Called with each chunk, in order. The data is
+     * only valid for the duration of the call.
+     */
+    ChunkingSink(Params params, fun<void(std::string_view chunk)> onChunk);
+
+    void operator()(std::string_view data) override;
+
+    /**
+     * Emit the final chunk (which may be shorter than `minSize`).
+     */
+    void finish() override;
+
+private:
+
+    Params params;
+    uint64_t maskSmall, maskLarge;
+    fun<void(std::string_view chunk)> onChunk;
+
+    std::string buffer;
+
+    /**
+     * State of the rolling hash, so that we don't rescan the
+     * buffer every time more data arrives.
+     */
+    size_t scanned = 0;
+    uint64_t fingerprint = 0;
+
+    /**
+     * Return the length of the next chunk at the start of `pending`,
+     * or 0 if more data is needed to determine it.
+     */
+    size_t findCut(std::string_view pending);
+};
+
+} // namespace nix
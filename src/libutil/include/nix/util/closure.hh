@@ -26,9 +26,15 @@ template<typename T>
 using GetEdgesAsync = fun<asio::awaitable<std::set<T>>(const T & elt)>;
 
 template<typename T, typename CompletionToken>
-auto computeClosure(std::set<T> startElts, std::set<T> & res, GetEdgesAsync<T> getEdges, CompletionToken token)
+auto computeClosure(
+    std::set<T> startElts,
+    std::set<T> & res,
+    GetEdgesAsync<T> getEdges,
+    std::size_t maxConcurrent,
+    CompletionToken token)
 {
-    auto initiator = [&res, startElts = std::move(startElts), getEdges = std::move(getEdges)](auto handler) {
+    auto initiator = [&res, startElts = std::move(startElts), getEdges = std::move(getEdges), maxConcurrent](
+                         auto handler) {
         auto executor = asio::make_strand(asio::get_associated_executor(handler));
 
         using Executor = decltype(executor);
@@ -56,7 +62,7 @@ auto computeClosure(std::set<T> startElts, std::set<T> & res, GetEdgesAsync<T> g
             /**
              * Maximum number of concurrent coroutines. Implements primitive rate limiting.
              */
-            std::size_t maxConcurrent = 1024;
+            std::size_t maxConcurrent;
             /**
              * Nodes to handle next.
              */
@@ -67,12 +73,18 @@ auto computeClosure(std::set<T> startElts, std::set<T> & res, GetEdgesAsync<T> g
              */
             std::exception_ptr error;
 
-            State(Executor executor_, GetEdgesAsync<T> getEdges, Handler handler, std::set<T> & res)
+            State(
+                Executor executor_,
+                GetEdgesAsync<T> getEdges,
+                Handler handler,
+                std::set<T> & res,
+                std::size_t maxConcurrent)
                 : executor(executor_)
                 , getEdges(std::move(getEdges))
                 , handler(std::move(handler))
                 , res(res)
                 , workGuard(asio::make_work_guard(executor_))
+                , maxConcurrent(std::max<std::size_t>(1, maxConcurrent))
             {
             }
 
@@ -153,7 +165,7 @@ auto computeClosure(std::set<T> startElts, std::set<T> & res, GetEdgesAsync<T> g
             }
         };
 
-        auto state = make_ref<State>(executor, std::move(getEdges), std::move(handler), res);
+        auto state = make_ref<State>(executor, std::move(getEdges), std::move(handler), res, maxConcurrent);
         if (startElts.empty()) {
             /* No work to do. */
             state->complete(std::exception_ptr{});
@@ -166,8 +178,13 @@ auto computeClosure(std::set<T> startElts, std::set<T> & res, GetEdgesAsync<T> g
     return asio::async_initiate<CompletionToken, void(std::exception_ptr)>(std::move(initiator), token);
 }
 
+/**
+ * Compute the closure of `startElts` under `getEdges`, calling
+ * `getEdges` for at most `maxConcurrent` elements at a time.
+ */
 template<typename T>
-void computeClosure(std::set<T> startElts, std::set<T> & res, GetEdgesAsync<T> getEdges)
+void computeClosure(
+    std::set<T> startElts, std::set<T> & res, GetEdgesAsync<T> getEdges, std::size_t maxConcurrent = 1024)
 {
     asio::io_context ctx;
     std::exception_ptr ex = nullptr;
@@ -175,6 +192,7 @@ void computeClosure(std::set<T> startElts, std::set<T> & res, GetEdgesAsync<T> g
         std::move(startElts),
         res,
         std::move(getEdges),
+        maxConcurrent,
         asio::bind_executor(ctx.get_executor(), [&](std::exception_ptr ex2) { ex = ex2; }));
     ctx.run();
     if (ex)
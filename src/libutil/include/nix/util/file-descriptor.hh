@@ -121,6 +121,23 @@ size_t readOffset(Descriptor fd, off_t offset, std::span<std::byte> buffer);
  */
 void copyFdRange(Descriptor fd, off_t offset, size_t nbytes, Sink & sink);
 
+/**
+ * Copy up to @p nbytes from @p from to the current offset of @p to
+ * without passing the data through userspace, using
+ * `copy_file_range()`. On file systems that support reflinks (e.g.
+ * btrfs and XFS) this shares the extents instead of copying them.
+ *
+ * @param offset The offset in @p from to copy from, which is advanced
+ * by the number of bytes copied. If null, the current offset of @p from
+ * is used and advanced.
+ * @return The number of bytes copied (0 indicates EOF), or
+ * `std::nullopt` if the kernel can't copy between these descriptors
+ * (e.g. because they're on different file systems or not regular
+ * files), in which case nothing was copied.
+ * @throws SystemError on other failures
+ */
+std::optional<size_t> copyFileRange(Descriptor from, off_t * offset, Descriptor to, size_t nbytes);
+
 /**
  * Wrappers around read()/write() that read/write exactly the
  * requested number of bytes.
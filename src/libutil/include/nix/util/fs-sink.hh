@@ -119,6 +119,28 @@ struct RestoreSink : FileSystemObjectSink
 private:
     void anchor() override;
 
+    struct Workers;
+
+    /**
+     * Shared with the sinks of subdirectories.
+     */
+    std::shared_ptr<Workers> workers;
+
+    /**
+     * A duplicate of `dirFd` that is kept open by pending writes into
+     * this directory.
+     */
+    std::shared_ptr<AutoCloseFD> sharedDirFd;
+
+    AutoCloseFD openRegularFile(const CanonPath & path);
+
+    /**
+     * Whether `path` can be created by the workers.
+     */
+    bool canDefer(const CanonPath & path);
+
+    Descriptor getSharedDirFd();
+
 public:
     std::filesystem::path dstPath;
     /**
@@ -138,6 +160,20 @@ public:
     {
     }
 
+    /**
+     * Hand the creation of small regular files and symlinks to a pool
+     * of worker threads (see the `restore-threads` setting), while the
+     * caller keeps feeding the sink in order. Directories are still
+     * created synchronously. `finish()` must be called afterwards.
+     */
+    void enableParallelWrites();
+
+    /**
+     * Wait until all files have been written, and rethrow the first
+     * error encountered by a worker.
+     */
+    void finish();
+
     void createDirectory(const CanonPath & path) override;
 
     void createDirectory(const CanonPath & path, DirectoryCreatedCallback callback) override;
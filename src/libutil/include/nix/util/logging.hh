@@ -55,6 +55,16 @@ typedef enum {
     /* The resulting store path of an actFetchToStore activity, emitted once the
        operation completes. Fields: [0] = store path (string). */
     resFetchToStore = 109,
+    /* The resources used by the builder of an actBuild activity, emitted once
+       the builder has finished if it ran in a cgroup. Fields (int, 0 if the
+       kernel doesn't report it):
+         [0] = peak memory usage in bytes
+         [1] = bytes read from block devices
+         [2] = bytes written to block devices
+         [3] = time stalled on CPU in microseconds
+         [4] = time stalled on memory in microseconds
+         [5] = time stalled on IO in microseconds */
+    resBuildResources = 110,
 } ResultType;
 
 typedef uint64_t ActivityId;
@@ -243,6 +243,13 @@ public:
     BackedStringView endOfFileError{"unexpected end-of-file"};
     bool isSeekable = true;
 
+    /**
+     * Whether `drainInto()` should try to let the kernel copy data
+     * into file descriptor sinks. Cleared when that turns out not to
+     * be possible.
+     */
+    bool canCopyFileRange = true;
+
     FdSource()
         : fd(INVALID_DESCRIPTOR)
     {
@@ -270,6 +277,14 @@ public:
 
     void skip(size_t len) override;
 
+    using Source::drainInto;
+
+    /**
+     * If `sink` is an `FdSink`, copy the data inside the kernel if
+     * possible (see `copyFileRange()`).
+     */
+    void drainInto(Sink & sink, uint64_t len) override;
+
 protected:
     size_t readUnbuffered(char * data, size_t len) override;
 private:
@@ -388,6 +403,15 @@ public:
         sink({data, n});
         return n;
     }
+
+    using Source::drainInto;
+
+    /**
+     * If `orig` can copy the data to `sink` inside the kernel (see
+     * `FdSource::drainInto()`), let it do that, and then read the
+     * data back from the file for our own sink.
+     */
+    void drainInto(Sink & sink, uint64_t len) override;
 };
 
 /**
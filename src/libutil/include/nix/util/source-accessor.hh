@@ -169,6 +169,16 @@ public:
 
     virtual std::string readLink(const CanonPath & path) = 0;
 
+    /**
+     * Whether `lstat()`, `readFile()` and `readLink()` may be called
+     * concurrently from multiple threads. If so, `dumpPath()` reads
+     * ahead in parallel (see the `nar-read-ahead` setting).
+     */
+    virtual bool allowsConcurrentReads()
+    {
+        return false;
+    }
+
     virtual void dumpPath(const CanonPath & path, Sink & sink, PathFilter & filter = defaultPathFilter);
 
     Hash
@@ -5,6 +5,7 @@
 #include <mutex>
 #include <shared_mutex>
 #include <condition_variable>
+#include <chrono>
 #include <cassert>
 
 #include "nix/util/error.hh"
@@ -75,6 +76,12 @@ public:
             , lk(s->mutex)
         {
         }
+
+        Lock(SyncBase * s, L && lk)
+            : s(s)
+            , lk(std::move(lk))
+        {
+        }
     public:
         Lock(Lock && l) = delete;
         Lock(const Lock & l) = delete;
@@ -141,6 +148,22 @@ public:
         return WriteLock(this);
     }
 
+    /**
+     * Like `lock()`, but if the lock is held by someone else, call
+     * `onWait` with the time spent waiting for it.
+     */
+    template<typename F>
+    WriteLock lock(F && onWait)
+    {
+        WL lk(mutex, std::try_to_lock);
+        if (!lk.owns_lock()) {
+            auto before = std::chrono::steady_clock::now();
+            lk.lock();
+            onWait(std::chrono::steady_clock::now() - before);
+        }
+        return WriteLock(this, std::move(lk));
+    }
+
     struct ReadLock : Lock<RL>
     {
         using Lock<RL>::Lock;
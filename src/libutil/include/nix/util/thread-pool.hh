@@ -7,6 +7,7 @@
 
 #include <queue>
 #include <functional>
+#include <future>
 #include <thread>
 #include <map>
 #include <atomic>
@@ -81,6 +82,64 @@ private:
     void doWork(bool mainThread);
 };
 
+/**
+ * A pool of threads shared by all users in this process (see
+ * `getSharedThreadPool()`). Unlike `ThreadPool`, work items start
+ * running as soon as they are enqueued, and their results (or
+ * exceptions) are retrieved through futures. Threads are started on
+ * demand and never exit, so the pool has as many threads as the
+ * largest `maxThreads` anyone asked for.
+ */
+class SharedThreadPool
+{
+    struct State
+    {
+        std::queue<std::function<void()>> pending;
+        std::vector<std::thread> workers;
+        size_t idle = 0;
+        bool quit = false;
+    };
+
+    Sync<State> state_;
+
+    std::condition_variable wakeup;
+
+    void work();
+
+    void push(size_t maxThreads, std::function<void()> work);
+
+public:
+
+    /**
+     * The process that created this pool. A child created by `fork()`
+     * doesn't have its threads.
+     */
+    const pid_t pid;
+
+    SharedThreadPool();
+
+    ~SharedThreadPool();
+
+    /**
+     * Run `f` on one of at most `maxThreads` threads.
+     */
+    template<typename F>
+    std::future<std::invoke_result_t<F>> enqueue(size_t maxThreads, F && f)
+    {
+        auto task = std::make_shared<std::packaged_task<std::invoke_result_t<F>()>>(std::forward<F>(f));
+        auto future = task->get_future();
+        push(maxThreads, [task]() { (*task)(); });
+        return future;
+    }
+};
+
+/**
+ * Return the shared thread pool of this process, creating it on first
+ * use. The pool is never destroyed, because its threads keep running
+ * until we exit.
+ */
+SharedThreadPool & getSharedThreadPool();
+
 /**
  * Process in parallel a set of items of type T that have a partial
  * ordering between them. Thus, any item is only processed after all
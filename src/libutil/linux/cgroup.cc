@@ -49,6 +49,30 @@ StringMap getCgroups(const std::filesystem::path & cgroupFile)
     return cgroups;
 }
 
+/**
+ * Return the `total` of the `some` line of a PSI file such as
+ * `memory.pressure`, i.e. the time in which at least one task was
+ * stalled.
+ */
+static std::optional<std::chrono::microseconds> getPressureTotal(const std::filesystem::path & pressurePath)
+{
+    if (!pathExists(pressurePath))
+        return std::nullopt;
+
+    for (auto & line : tokenizeString<std::vector<std::string>>(readFile(pressurePath), "\n")) {
+        if (!hasPrefix(line, "some "))
+            continue;
+        for (auto & field : tokenizeString<std::vector<std::string>>(line)) {
+            std::string_view totalPrefix = "total=";
+            if (hasPrefix(field, totalPrefix))
+                if (auto n = string2Int<uint64_t>(field.substr(totalPrefix.size())))
+                    return std::chrono::microseconds(*n);
+        }
+    }
+
+    return std::nullopt;
+}
+
 CgroupStats getCgroupStats(const std::filesystem::path & cgroup)
 {
     CgroupStats stats;
@@ -73,9 +97,58 @@ CgroupStats getCgroupStats(const std::filesystem::path & cgroup)
         }
     }
 
+    auto memoryPeakPath = cgroup / "memory.peak";
+
+    if (pathExists(memoryPeakPath))
+        stats.memoryPeak = string2Int<uint64_t>(trim(readFile(memoryPeakPath)));
+
+    /* `io.stat` has a line like `8:0 rbytes=1459200 wbytes=314773504
+       rios=192 ...` for every device that the cgroup has done IO
+       on. */
+    auto iostatPath = cgroup / "io.stat";
+
+    if (pathExists(iostatPath)) {
+        stats.ioRead = 0;
+        stats.ioWrite = 0;
+        for (auto & field : tokenizeString<std::vector<std::string>>(readFile(iostatPath))) {
+            std::string_view readPrefix = "rbytes=";
+            if (hasPrefix(field, readPrefix))
+                *stats.ioRead += string2Int<uint64_t>(field.substr(readPrefix.size())).value_or(0);
+
+            std::string_view writePrefix = "wbytes=";
+            if (hasPrefix(field, writePrefix))
+                *stats.ioWrite += string2Int<uint64_t>(field.substr(writePrefix.size())).value_or(0);
+        }
+    }
+
+    stats.cpuPressure = getPressureTotal(cgroup / "cpu.pressure");
+    stats.memoryPressure = getPressureTotal(cgroup / "memory.pressure");
+    stats.ioPressure = getPressureTotal(cgroup / "io.pressure");
+
     return stats;
 }
 
+StringSet enableCgroupControllers(const std::filesystem::path & cgroup, const StringSet & controllers)
+{
+    auto available = tokenizeString<StringSet>(readFile(cgroup / "cgroup.controllers"));
+    auto enabled = tokenizeString<StringSet>(readFile(cgroup / "cgroup.subtree_control"));
+
+    StringSet missing;
+    std::string request;
+
+    for (auto & controller : controllers) {
+        if (!available.contains(controller))
+            missing.insert(controller);
+        else if (!enabled.contains(controller))
+            request += (request.empty() ? "+" : " +") + controller;
+    }
+
+    if (!request.empty())
+        writeFile(cgroup / "cgroup.subtree_control", request);
+
+    return missing;
+}
+
 static CgroupStats destroyCgroup(const std::filesystem::path & cgroup, bool returnStats)
 {
     if (!pathExists(cgroup))
@@ -17,6 +17,25 @@ StringMap getCgroups(const std::filesystem::path & cgroupFile);
 struct CgroupStats
 {
     std::optional<std::chrono::microseconds> cpuUser, cpuSystem;
+
+    /**
+     * The highest memory usage of the cgroup, in bytes. Requires the
+     * `memory` controller.
+     */
+    std::optional<uint64_t> memoryPeak;
+
+    /**
+     * The bytes read from and written to block devices, summed over
+     * all devices. Requires the `io` controller.
+     */
+    std::optional<uint64_t> ioRead, ioWrite;
+
+    /**
+     * The total time during which some tasks in the cgroup were
+     * stalled waiting for CPU, memory or IO, as reported by the
+     * kernel's pressure stall information (PSI).
+     */
+    std::optional<std::chrono::microseconds> cpuPressure, memoryPressure, ioPressure;
 };
 
 /**
@@ -32,6 +51,16 @@ CgroupStats getCgroupStats(const std::filesystem::path & cgroup);
  */
 CgroupStats destroyCgroup(const std::filesystem::path & cgroup);
 
+/**
+ * Enable the given controllers (e.g. `memory`) for the children of
+ * `cgroup` by writing them to its `cgroup.subtree_control`.
+ * Controllers that are already enabled are skipped.
+ *
+ * @return The controllers that aren't available in `cgroup` and
+ * therefore weren't enabled.
+ */
+StringSet enableCgroupControllers(const std::filesystem::path & cgroup, const StringSet & controllers);
+
 CanonPath getCurrentCgroup();
 
 /**
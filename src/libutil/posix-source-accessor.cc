@@ -76,6 +76,11 @@ protected:
             return mtime;
         return std::nullopt;
     }
+
+    bool allowsConcurrentReads() override
+    {
+        return true;
+    }
 };
 
 void PosixSourceAccessorBase::anchor() {}
@@ -15,6 +15,7 @@
 #ifdef _WIN32
 #  include <fileapi.h>
 #else
+#  include <fcntl.h>
 #  include <poll.h>
 #endif
 
@@ -170,6 +171,29 @@ std::string Source::drain()
     return std::move(s.s);
 }
 
+void TeeSource::drainInto(Sink & sink, uint64_t len)
+{
+#ifndef _WIN32
+    auto fdSink = dynamic_cast<FdSink *>(&sink);
+    auto fdSource = dynamic_cast<FdSource *>(&orig);
+    /* Reading the data back requires a readable file. */
+    if (fdSink && fdSink->fd != INVALID_DESCRIPTOR && fdSource && fdSource->canCopyFileRange
+        && (fcntl(fdSink->fd, F_GETFL) & O_ACCMODE) == O_RDWR) {
+        fdSink->flush();
+        auto offset = lseek(fdSink->fd, 0, SEEK_CUR);
+        if (offset != -1) {
+            orig.drainInto(sink, len);
+            fdSink->flush();
+            /* Hash (or otherwise process) exactly the data that ended up
+               in the file. It's likely still in the page cache. */
+            copyFdRange(fdSink->fd, offset, len, this->sink);
+            return;
+        }
+    }
+#endif
+    Source::drainInto(sink, len);
+}
+
 void Source::skip(size_t len)
 {
     std::array<char, 8192> buf;
@@ -258,6 +282,42 @@ size_t FdSource::readUnbuffered(char * data, size_t len)
     return n;
 }
 
+void FdSource::drainInto(Sink & sink, uint64_t len)
+{
+    /* An `FdSink` without a file descriptor buffers the data
+       elsewhere. */
+    auto fdSink = dynamic_cast<FdSink *>(&sink);
+    if (!fdSink || fdSink->fd == INVALID_DESCRIPTOR || !canCopyFileRange)
+        return Source::drainInto(sink, len);
+
+    /* Data that we've already buffered has to be written normally. */
+    if (auto n = std::min<uint64_t>(len, bufPosIn - bufPosOut)) {
+        sink({buffer.get() + bufPosOut, n});
+        bufPosOut += n;
+        if (bufPosIn == bufPosOut)
+            bufPosIn = bufPosOut = 0;
+        len -= n;
+    }
+
+    fdSink->flush();
+    while (len) {
+        auto n = copyFileRange(fd, nullptr, fdSink->fd, std::min<uint64_t>(len, std::numeric_limits<ssize_t>::max()));
+        if (!n) {
+            canCopyFileRange = false;
+            break;
+        }
+        if (*n == 0) {
+            _good = false;
+            throw EndOfFile(std::string(*endOfFileError));
+        }
+        read += *n;
+        fdSink->written += *n;
+        len -= *n;
+    }
+
+    Source::drainInto(sink, len);
+}
+
 bool FdSource::good()
 {
     return _good;
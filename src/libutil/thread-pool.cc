@@ -2,6 +2,8 @@
 #include "nix/util/signals.hh"
 #include "nix/util/util.hh"
 
+#include <unistd.h>
+
 namespace nix {
 
 void ThreadPoolShutDown::anchor() {}
@@ -164,4 +166,70 @@ void ThreadPool::doWork(bool mainThread)
     }
 }
 
+SharedThreadPool::SharedThreadPool()
+    : pid(getpid())
+{
+}
+
+SharedThreadPool::~SharedThreadPool()
+{
+    std::vector<std::thread> workers;
+    {
+        auto state(state_.lock());
+        state->quit = true;
+        std::swap(workers, state->workers);
+    }
+    wakeup.notify_all();
+    for (auto & thr : workers)
+        thr.join();
+}
+
+void SharedThreadPool::push(size_t maxThreads, std::function<void()> work)
+{
+    auto state(state_.lock());
+    state->pending.push(std::move(work));
+    if (state->idle < state->pending.size() && state->workers.size() < maxThreads)
+        state->workers.emplace_back(&SharedThreadPool::work, this);
+    wakeup.notify_one();
+}
+
+void SharedThreadPool::work()
+{
+    ReceiveInterrupts receiveInterrupts;
+
+    while (true) {
+        std::function<void()> w;
+        {
+            auto state(state_.lock());
+            state->idle++;
+            state.wait(wakeup, [&]() { return state->quit || !state->pending.empty(); });
+            state->idle--;
+            if (state->quit)
+                return;
+            w = std::move(state->pending.front());
+            state->pending.pop();
+        }
+        /* Exceptions end up in the future. */
+        w();
+    }
+}
+
+SharedThreadPool & getSharedThreadPool()
+{
+    static std::atomic<SharedThreadPool *> pool = nullptr;
+
+    auto current = pool.load();
+    if (!current || current->pid != getpid()) {
+        /* The pool of the parent process is leaked in a forked child,
+           since its threads don't exist there. */
+        auto fresh = new SharedThreadPool;
+        if (pool.compare_exchange_strong(current, fresh))
+            current = fresh;
+        else
+            delete fresh;
+    }
+
+    return *current;
+}
+
 } // namespace nix
@@ -53,6 +53,29 @@ size_t write(Descriptor fd, std::span<const std::byte> buffer, bool allowInterru
     return static_cast<size_t>(n);
 }
 
+std::optional<size_t> copyFileRange(Descriptor from, off_t * offset, Descriptor to, size_t nbytes)
+{
+#if HAVE_COPY_FILE_RANGE
+    ssize_t n;
+    do {
+        checkInterrupt();
+        n = ::copy_file_range(from, offset, to, nullptr, nbytes, 0);
+    } while (n == -1 && errno == EINTR);
+    if (n == -1) {
+        /* These indicate that the kernel, the file systems or the file
+           types don't support copying, so the caller should fall back
+           to read()/write(). */
+        if (errno == ENOSYS || errno == EXDEV || errno == EINVAL || errno == EOPNOTSUPP || errno == EBADF
+            || errno == EPERM)
+            return std::nullopt;
+        throw SysError("copying %1% bytes between file descriptors", nbytes);
+    }
+    return static_cast<size_t>(n);
+#else
+    return std::nullopt;
+#endif
+}
+
 AutoCloseFD dupDescriptor(Descriptor fd)
 {
     int newFd = fcntl(fd, F_DUPFD_CLOEXEC, 0);
@@ -67,6 +67,11 @@ size_t write(Descriptor fd, std::span<const std::byte> buffer, bool allowInterru
     return static_cast<size_t>(n);
 }
 
+std::optional<size_t> copyFileRange(Descriptor from, off_t * offset, Descriptor to, size_t nbytes)
+{
+    return std::nullopt;
+}
+
 AutoCloseFD dupDescriptor(Descriptor fd)
 {
     HANDLE newHandle;
@@ -100,6 +100,18 @@ builtPathsWithResultToJSON(const std::vector<BuiltPathWithResult> & buildables,
                 j["cpuUser"] = ((double) b.result->cpuUser->count()) / 1000000;
             if (b.result->cpuSystem)
                 j["cpuSystem"] = ((double) b.result->cpuSystem->count()) / 1000000;
+            if (b.result->memoryPeak)
+                j["memoryPeak"] = *b.result->memoryPeak;
+            if (b.result->ioRead)
+                j["ioRead"] = *b.result->ioRead;
+            if (b.result->ioWrite)
+                j["ioWrite"] = *b.result->ioWrite;
+            if (b.result->cpuPressure)
+                j["cpuPressure"] = ((double) b.result->cpuPressure->count()) / 1000000;
+            if (b.result->memoryPressure)
+                j["memoryPressure"] = ((double) b.result->memoryPressure->count()) / 1000000;
+            if (b.result->ioPressure)
+                j["ioPressure"] = ((double) b.result->ioPressure->count()) / 1000000;
         }
         res.push_back(j);
     }
@@ -115,7 +115,17 @@ struct CmdEval : MixJSON, InstallableValueCommand, MixReadOnlyOption
         }
 
         else if (json) {
-            printJSON(printValueAsJSON(*state, true, *v, pos, context, false));
+            if (outputPretty)
+                printJSON(printValueAsJSON(*state, true, *v, pos, context, false));
+            else {
+                /* Don't build a JSON tree first, since the value may
+                   be huge. */
+                std::string out;
+                printValueAsJSON(*state, true, *v, pos, out, context, false);
+                out += "\n";
+                auto suspension = logger->suspend();
+                writeFull(getStandardOutput(), out);
+            }
         }
 
         else {
@@ -3,6 +3,8 @@
 #include "nix/store/store-api.hh"
 #include "nix/main/common-args.hh"
 #include "nix/store/nar-info.hh"
+#include "nix/store/local-store.hh"
+#include "nix/store/reference-graph.hh"
 
 #include <algorithm>
 
@@ -28,6 +30,63 @@ static uint64_t getStoreObjectsTotalSize(Store & store, const StorePathSet & clo
     return totalNarSize;
 }
 
+/**
+ * Computes the closure sizes of store objects. On a local store, this
+ * switches to a snapshot of the reference graph once enough paths have
+ * been asked for, rather than querying every path in the closure from
+ * the database again for every closure it is part of. Loading the
+ * snapshot scans all valid paths, so for a few small closures it's
+ * cheaper to query them one by one.
+ */
+struct ClosureSizes
+{
+    /**
+     * Load the reference graph right away when the closure sizes of at
+     * least this many paths are requested (e.g. `nix path-info -rS`).
+     */
+    static constexpr size_t graphMinPaths = 64;
+
+    /**
+     * Otherwise, load it once the closures computed so far contain this
+     * many paths in total.
+     */
+    static constexpr size_t graphMinQueried = 10000;
+
+    Store & store;
+    LocalStore * localStore;
+    std::shared_ptr<const ReferenceGraph> graph;
+    size_t queried = 0;
+
+    ClosureSizes(Store & store, size_t nrPaths)
+        : store(store)
+        , localStore(dynamic_cast<LocalStore *>(&store))
+    {
+        if (nrPaths >= graphMinPaths)
+            loadGraph();
+    }
+
+    void loadGraph()
+    {
+        if (localStore && !graph)
+            graph = localStore->getReferenceGraph().get_ptr();
+    }
+
+    uint64_t operator()(const StorePath & path)
+    {
+        if (queried >= graphMinQueried)
+            loadGraph();
+
+        if (graph)
+            if (auto i = graph->lookup(path))
+                return graph->closureSize({&*i, 1});
+
+        StorePathSet closure;
+        store.computeFSClosure(path, closure, false, false);
+        queried += closure.size();
+        return getStoreObjectsTotalSize(store, closure);
+    }
+};
+
 /**
  * Write a JSON representation of store object metadata, such as the
  * hash and the references.
@@ -45,6 +104,10 @@ pathInfoToJSON(Store & store, const StorePathSet & storePaths, bool showClosureS
         return format == PathInfoJsonFormat::V1 ? store.printStorePath(path) : std::string(path.to_string());
     };
 
+    std::optional<ClosureSizes> closureSizes;
+    if (showClosureSize)
+        closureSizes.emplace(store, storePaths.size());
+
     for (auto & storePath : storePaths) {
         json jsonObject;
 
@@ -64,26 +127,27 @@ pathInfoToJSON(Store & store, const StorePathSet & storePaths, bool showClosureS
                instead. */
             jsonObject["storeDir"] = store.storeDir;
 
-            if (showClosureSize) {
+            if (showClosureSize && !dynamic_cast<const NarInfo *>(&*info))
+                jsonObject["closureSize"] = (*closureSizes)(storePath);
+
+            else if (showClosureSize) {
                 StorePathSet closure;
                 store.computeFSClosure(storePath, closure, false, false);
 
                 jsonObject["closureSize"] = getStoreObjectsTotalSize(store, closure);
 
-                if (dynamic_cast<const NarInfo *>(&*info)) {
-                    uint64_t totalDownloadSize = 0;
-                    for (auto & p : closure) {
-                        auto depInfo = store.queryPathInfo(p);
-                        if (auto * depNarInfo = dynamic_cast<const NarInfo *>(&*depInfo))
-                            totalDownloadSize += depNarInfo->fileSize;
-                        else
-                            throw Error(
-                                "Missing .narinfo for dep %s of %s",
-                                store.printStorePath(p),
-                                store.printStorePath(storePath));
-                    }
-                    jsonObject["closureDownloadSize"] = totalDownloadSize;
+                uint64_t totalDownloadSize = 0;
+                for (auto & p : closure) {
+                    auto depInfo = store.queryPathInfo(p);
+                    if (auto * depNarInfo = dynamic_cast<const NarInfo *>(&*depInfo))
+                        totalDownloadSize += depNarInfo->fileSize;
+                    else
+                        throw Error(
+                            "Missing .narinfo for dep %s of %s",
+                            store.printStorePath(p),
+                            store.printStorePath(storePath));
                 }
+                jsonObject["closureDownloadSize"] = totalDownloadSize;
             }
         } catch (InvalidPath &) {
             jsonObject = nullptr;
@@ -204,6 +268,10 @@ struct CmdPathInfo : StorePathsCommand, MixJSON
 
         else {
 
+            std::optional<ClosureSizes> closureSizes;
+            if (showClosureSize)
+                closureSizes.emplace(*store, storePaths.size());
+
             for (auto & storePath : storePaths) {
                 auto info = store->queryPathInfo(storePath);
                 auto storePathS = store->printStorePath(info->path);
@@ -218,11 +286,8 @@ struct CmdPathInfo : StorePathsCommand, MixJSON
                 if (showSize)
                     printSize(str, info->narSize);
 
-                if (showClosureSize) {
-                    StorePathSet closure;
-                    store->computeFSClosure(storePath, closure, false, false);
-                    printSize(str, getStoreObjectsTotalSize(*store, closure));
-                }
+                if (showClosureSize)
+                    printSize(str, (*closureSizes)(storePath));
 
                 if (showSigs) {
                     str << '\t';
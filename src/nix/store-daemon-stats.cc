@@ -0,0 +1,39 @@
+#include "nix/cmd/command.hh"
+#include "nix/main/common-args.hh"
+#include "nix/store/daemon-stats.hh"
+#include "nix/store/stats-store.hh"
+#include "nix/store/store-cast.hh"
+#include "nix/util/util.hh"
+
+#include <nlohmann/json.hpp>
+
+namespace nix {
+
+struct CmdStoreDaemonStats : StoreCommand, MixJSON
+{
+    std::string description() override
+    {
+        return "show statistics about the operations performed by the Nix daemon";
+    }
+
+    std::string doc() override
+    {
+        return
+#include "store-daemon-stats.md"
+            ;
+    }
+
+    void run(ref<Store> store) override
+    {
+        auto stats = require<StatsStore>(*store).queryDaemonStats();
+
+        if (json)
+            printJSON(nlohmann::json(stats));
+        else
+            logger->writeToStdout(chomp(stats.toPrometheus()));
+    }
+};
+
+static auto rCmdStoreDaemonStats = registerCommand2<CmdStoreDaemonStats>({"store", "daemon-stats"});
+
+} // namespace nix
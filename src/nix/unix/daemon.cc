@@ -15,6 +15,7 @@
 #include "nix/cmd/legacy.hh"
 #include "nix/cmd/unix-socket-server.hh"
 #include "nix/store/daemon.hh"
+#include "nix/store/daemon-stats.hh"
 #include "man-pages.hh"
 #include "nix/util/socket.hh"
 
@@ -295,6 +296,11 @@ static void daemonLoop(
        someone is intentionally crashing the daemon to brute-force ASLR. */
     static constexpr unsigned crashLimit = 64;
 
+    /* Let the worker processes forked below account their operations in
+       a shared place, so that `nix store daemon-stats` sees all of
+       them. */
+    initSharedStats();
+
     try {
         unix::serveUnixSocket(
             {
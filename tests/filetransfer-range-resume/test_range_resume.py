@@ -0,0 +1,146 @@
+"""
+Integration test for resuming interrupted downloads with Range requests.
+
+Runs an in-process HTTP server that drops the connection half-way through
+the first response, and checks that nix-prefetch-url resumes the download
+(or skips what it already has if the server ignores the range), and that it
+refuses to splice together two different versions of the file.
+"""
+
+import http.server
+import re
+import socketserver
+import subprocess
+import threading
+
+PAYLOAD = bytes(range(256)) * 4096  # 1 MiB
+DROP_AFTER = len(PAYLOAD) // 3
+PORT = 0  # set after server starts
+
+lock = threading.Lock()
+honour_ranges = True
+change_etag = False
+drops = 0
+requests: list[dict[str, str]] = []
+
+
+class DroppingHandler(http.server.BaseHTTPRequestHandler):
+    def do_GET(self):
+        global drops
+        with lock:
+            requests.append({k.lower(): v for k, v in self.headers.items()})
+            n = len(requests)
+            drop = drops > 0
+            if drop:
+                drops -= 1
+            etag = '"v2"' if change_etag and n > 1 else '"v1"'
+
+        start = 0
+        range_header = self.headers.get("Range")
+        if_range = self.headers.get("If-Range")
+        if honour_ranges and range_header and (if_range is None or if_range == etag):
+            m = re.fullmatch(r"bytes=(\d+)-", range_header)
+            assert m, f"unexpected Range header: {range_header}"
+            start = int(m.group(1))
+
+        body = PAYLOAD[start:]
+        if start:
+            self.send_response(206)
+            self.send_header("Content-Range", f"bytes {start}-{len(PAYLOAD) - 1}/{len(PAYLOAD)}")
+        else:
+            self.send_response(200)
+        self.send_header("Content-Type", "application/octet-stream")
+        self.send_header("Content-Length", str(len(body)))
+        self.send_header("ETag", etag)
+        if honour_ranges:
+            self.send_header("Accept-Ranges", "bytes")
+        self.end_headers()
+
+        if drop:
+            self.wfile.write(body[:DROP_AFTER])
+            self.wfile.flush()
+            self.close_connection = True
+            return
+        self.wfile.write(body)
+
+    def log_message(self, *_args):
+        pass
+
+
+def reset(ranges: bool = True, changing: bool = False, n_drops: int = 1) -> None:
+    global honour_ranges, change_etag, drops
+    with lock:
+        honour_ranges = ranges
+        change_etag = changing
+        drops = n_drops
+        requests.clear()
+
+
+def fetch(name: str) -> tuple[int, str, bytes | None]:
+    """Run nix-prefetch-url, return (exit_code, output, downloaded contents)."""
+    cmd = (
+        "nix-prefetch-url --print-path "
+        "--option filetransfer-retry-delay 10 "
+        f"http://127.0.0.1:{PORT}/{name}"
+    )
+    r = subprocess.run(cmd, shell=True, capture_output=True, text=True)
+    out = r.stdout + r.stderr
+    if r.returncode != 0:
+        return r.returncode, out, None
+    path = r.stdout.strip().splitlines()[-1]
+    with open(path, "rb") as f:
+        return r.returncode, out, f.read()
+
+
+def main() -> None:
+    global PORT
+    socketserver.TCPServer.allow_reuse_address = True
+    httpd = socketserver.ThreadingTCPServer(("127.0.0.1", 0), DroppingHandler)
+    PORT = httpd.server_address[1]
+    print(f"Dropping server on port {PORT}")
+    threading.Thread(target=httpd.serve_forever, daemon=True).start()
+
+    try:
+        test_resume_with_range()
+        test_resume_without_range_support()
+        test_changed_file_is_not_spliced()
+    finally:
+        httpd.shutdown()
+
+
+def test_resume_with_range():
+    """The retry asks for the rest of the file, validated by the ETag."""
+    reset()
+    rc, out, data = fetch("range")
+
+    assert rc == 0, f"Expected success: {out}"
+    assert data == PAYLOAD, "Downloaded file differs from the payload"
+    assert "retrying from offset" in out, f"Expected a resumed retry: {out}"
+    assert len(requests) == 2, f"Expected 2 requests, got {len(requests)}"
+    assert requests[1].get("range") == f"bytes={DROP_AFTER}-", f"Bad Range header: {requests[1]}"
+    assert requests[1].get("if-range") == '"v1"', f"Bad If-Range header: {requests[1]}"
+
+
+def test_resume_without_range_support():
+    """A server that ignores ranges sends the whole file again; the part that
+    was already received is skipped."""
+    reset(ranges=False)
+    rc, out, data = fetch("no-range")
+
+    assert rc == 0, f"Expected success: {out}"
+    assert data == PAYLOAD, "Downloaded file differs from the payload"
+    assert len(requests) == 2, f"Expected 2 requests, got {len(requests)}"
+
+
+def test_changed_file_is_not_spliced():
+    """If the file changes between attempts, the download fails rather than
+    combining the two versions."""
+    reset(changing=True)
+    rc, out, data = fetch("changed")
+
+    assert rc != 0, f"Expected failure: {out}"
+    assert "has changed on the server" in out, f"Missing error: {out}"
+
+
+if __name__ == "__main__":
+    main()
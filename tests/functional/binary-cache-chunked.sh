@@ -0,0 +1,57 @@
+#!/usr/bin/env bash
+
+source common.sh
+
+TODO_NixOS # Requires clearing the store
+
+clearStore
+clearBinaryCache
+
+cacheURI="file://$cacheDir?chunk-nars=true&nar-chunk-size=1024&compression=zstd"
+
+outPath=$(nix-build dependencies.nix --no-out-link)
+HASH=$(nix hash path "$outPath")
+
+nix copy --to "$cacheURI" "$outPath"
+
+# NARs are stored as chunk manifests, and the chunks separately.
+ls "$cacheDir/nar/"*.chunks.zst
+ls "$cacheDir/chunks/"*.zst
+if ls "$cacheDir/nar/"*.nar* &>/dev/null; then
+    fail "chunked binary cache should not contain whole NARs"
+fi
+
+# FileSize is the download size of the manifest and its chunks, not
+# just of the manifest.
+for narinfo in "$cacheDir"/*.narinfo; do
+    url=$(sed -n 's/^URL: //p' "$narinfo")
+    fileSize=$(sed -n 's/^FileSize: //p' "$narinfo")
+    (( fileSize > $(wc -c < "$cacheDir/$url") ))
+done
+
+# Copying the paths again doesn't upload the chunks that the cache
+# already has. Uploading a chunk replaces its file, so the inode
+# numbers show whether a chunk was uploaded. The .narinfo files are
+# removed so that the paths aren't skipped as already valid.
+chunkInodes=$(ls -i "$cacheDir/chunks" | sort)
+rm "$cacheDir"/*.narinfo
+clearCacheCache
+nix copy --to "$cacheURI" "$outPath"
+ls "$cacheDir"/*.narinfo
+[[ $(ls -i "$cacheDir/chunks" | sort) == "$chunkInodes" ]]
+
+# Repairing does upload them again.
+nix copy --to "$cacheURI" --repair "$outPath"
+[[ $(ls -i "$cacheDir/chunks" | sort) != "$chunkInodes" ]]
+
+clearStore
+clearCacheCache
+
+nix copy --from "$cacheURI" "$outPath" --no-check-sigs
+[[ $(nix hash path "$outPath") == "$HASH" ]]
+
+# A missing chunk makes the path unsubstitutable.
+clearStore
+clearCacheCache
+find "$cacheDir/chunks" -type f -print -quit | xargs rm
+expectStderr 1 nix copy --from "$cacheURI" "$outPath" --no-check-sigs | grepQuiet "does not exist in binary cache"
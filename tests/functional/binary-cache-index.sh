@@ -0,0 +1,55 @@
+#!/usr/bin/env bash
+
+source common.sh
+
+TODO_NixOS # Requires clearing the store
+
+clearStore
+clearBinaryCache
+clearCacheCache
+
+outPath=$(nix-build dependencies.nix --no-out-link)
+depPath=$(nix-build dependencies.nix -A input0_drv --no-out-link)
+
+# Populate a cache without an index, then enable it: the index is
+# generated from the existing .narinfo files.
+nix copy --to "file://$cacheDir" "$depPath"
+[[ ! -e "$cacheDir/index" ]]
+grepQuietInverse NarInfoIndex "$cacheDir/nix-cache-info"
+
+nix copy --to "file://$cacheDir?write-narinfo-index=true" "$outPath"
+grepQuiet "NarInfoIndex: 1" "$cacheDir/nix-cache-info"
+
+for path in $(nix-store -qR "$outPath"); do
+    hashPart=$(basename "$path" | cut -c1-32)
+    grepQuiet "$hashPart" "$cacheDir/index/$(echo "$hashPart" | cut -c1-2).idx"
+done
+
+clearStore
+clearCacheCache
+
+substituters="file://$cacheDir"
+nix-env --substituters "$substituters" --narinfo-cache-negative-ttl 0 -f dependencies.nix -qas \* | grep -- "--S"
+
+# Validity queries are answered from the index, not from the .narinfo
+# files.
+rm "$cacheDir/$(basename "$outPath" | cut -c1-32).narinfo"
+clearCacheCache
+nix-env --substituters "$substituters" --narinfo-cache-negative-ttl 0 -f dependencies.nix -qas \* | grep -- "--S"
+clearCacheCache
+nix-env --substituters "$substituters?narinfo-index=false" -f dependencies.nix -qas \* | grep -- "---"
+
+# A new cache is indexed from the start.
+clearBinaryCache
+outPath=$(nix-build dependencies.nix --no-out-link)
+nix copy --to "file://$cacheDir?write-narinfo-index=true" "$depPath"
+grepQuiet "NarInfoIndex: 1" "$cacheDir/nix-cache-info"
+[[ -n $(ls "$cacheDir/index/"*.idx) ]]
+
+# Uploads keep the index complete even without
+# `write-narinfo-index`, since clients rely on it.
+nix copy --to "file://$cacheDir" "$outPath"
+for path in $(nix-store -qR "$outPath"); do
+    hashPart=$(basename "$path" | cut -c1-32)
+    grepQuiet "$hashPart" "$cacheDir/index/$(echo "$hashPart" | cut -c1-2).idx"
+done
@@ -0,0 +1,33 @@
+#!/usr/bin/env bash
+
+source common.sh
+
+TODO_NixOS
+
+requireDaemonNewerThan "2.36.0pre20261019"
+
+clearStore
+
+expectStderr 1 nix store daemon-stats --store local | grepQuiet "not supported by store"
+
+startDaemon
+
+path=$(nix store add ./dummy)
+nix path-info "$path"
+
+# Operations performed by earlier connections are accounted as well.
+stats=$(nix store daemon-stats --json)
+[[ $(jq '.ops.AddToStore.count' <<< "$stats") -ge 1 ]]
+[[ $(jq '.ops.AddToStore.bytesIn' <<< "$stats") -gt 0 ]]
+[[ $(jq '.ops.QueryPathInfo.count' <<< "$stats") -ge 1 ]]
+[[ $(jq '.ops.QueryPathInfo.latencyBuckets | add' <<< "$stats") == $(jq '.ops.QueryPathInfo.count' <<< "$stats") ]]
+[[ $(jq '.ops.QueryPathInfo.p50Micros <= .ops.QueryPathInfo.p99Micros' <<< "$stats") == true ]]
+[[ $(jq '.sqliteBusyRetries' <<< "$stats") -ge 0 ]]
+
+prometheus=$(nix store daemon-stats)
+grepQuiet '^# TYPE nix_daemon_op_latency_seconds histogram$' <<< "$prometheus"
+grepQuiet '^nix_daemon_op_latency_seconds_count{op="AddToStore"} [1-9]' <<< "$prometheus"
+grepQuiet '^nix_daemon_op_latency_seconds_bucket{op="AddToStore",le="+Inf"} [1-9]' <<< "$prometheus"
+grepQuiet '^nix_daemon_sqlite_busy_retries_total [0-9]*$' <<< "$prometheus"
+
+killDaemon
@@ -53,3 +53,57 @@ wait $pid4 || fail "instance 4 failed: $?"
 
 if test "$(cat "$_NIX_TEST_SHARED".cur)" != 0; then fail "wrong current process count"; fi
 if test "$(cat "$_NIX_TEST_SHARED".max)" != 3; then fail "not enough parallelism"; fi
+
+
+# Third, test that global-max-jobs limits the builds of all
+# invocations together.
+echo "testing global-max-jobs..."
+
+clearStore
+
+rm -f "$_NIX_TEST_SHARED".cur "$_NIX_TEST_SHARED".max
+
+# Different derivations, so that the invocations don't just wait for
+# each other's output locks.
+drvPath1=$(nix-instantiate parallel.nix --argstr sleepTime 1)
+drvPath2=$(nix-instantiate parallel.nix --argstr sleepTime 2)
+
+nix-store -j10 -r "$drvPath1" --option global-max-jobs 1 &
+pid1=$!
+
+nix-store -j10 -r "$drvPath2" --option global-max-jobs 1 &
+pid2=$!
+
+wait $pid1 || fail "instance 1 failed: $?"
+wait $pid2 || fail "instance 2 failed: $?"
+
+if test "$(cat "$_NIX_TEST_SHARED".cur)" != 0; then fail "wrong current process count"; fi
+if test "$(cat "$_NIX_TEST_SHARED".max)" != 1; then fail "global-max-jobs exceeded"; fi
+
+
+# Fourth, test that an invocation waiting for the output locks held by
+# another one is woken up as soon as they are released, rather than
+# after build-poll-interval.
+echo "testing waiting for output locks..."
+
+clearStore
+
+rm -f "$_NIX_TEST_SHARED".cur "$_NIX_TEST_SHARED".max
+
+drvPath=$(nix-instantiate parallel.nix --argstr sleepTime 3)
+
+cmd="nix-store -j10 -r $drvPath --option build-poll-interval 300"
+
+start=$(date +%s)
+
+$cmd &
+pid1=$!
+
+$cmd &
+pid2=$!
+
+wait $pid1 || fail "instance 1 failed: $?"
+wait $pid2 || fail "instance 2 failed: $?"
+
+if (( $(date +%s) - start >= 60 )); then fail "not woken up when the locks were released"; fi
+if test "$(cat "$_NIX_TEST_SHARED".cur)" != 0; then fail "wrong current process count"; fi
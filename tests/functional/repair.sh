@@ -19,6 +19,18 @@ touch "$path2"/bad
 
 (! nix-store --verify --check-contents -v)
 
+# A checkpoint left by an interrupted verification makes it skip the
+# paths that were already checked. It is removed once verification
+# completes.
+printf 'started %s\n%s\n' "$(date +%s)" "$(basename "$path2")" > "$NIX_STATE_DIR"/verify-contents.checkpoint
+nix-store --verify --check-contents -v
+[[ ! -e "$NIX_STATE_DIR"/verify-contents.checkpoint ]]
+(! nix-store --verify --check-contents -v)
+
+# A checkpoint that is too old is ignored.
+printf 'started %s\n%s\n' "$(( $(date +%s) - 8 * 24 * 60 * 60 ))" "$(basename "$path2")" > "$NIX_STATE_DIR"/verify-contents.checkpoint
+(! nix-store --verify --check-contents -v)
+
 # The path can be repaired by rebuilding the derivation.
 nix-store --verify --check-contents --repair
 
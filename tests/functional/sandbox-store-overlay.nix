@@ -0,0 +1,42 @@
+{
+  n ? 50,
+  secret ? "",
+}:
+
+with import ./config.nix;
+
+rec {
+  inputs = builtins.genList (
+    i:
+    mkDerivation {
+      name = "sandbox-store-overlay-input-${toString i}";
+      buildCommand = "mkdir $out; echo ${toString i} > $out/value";
+    }
+  ) n;
+
+  # Built on its own, so that it's in the store without being an input
+  # of `check`.
+  secretPath = mkDerivation {
+    name = "sandbox-store-overlay-secret";
+    buildCommand = "mkdir $out; echo secret > $out/value";
+  };
+
+  check = mkDerivation {
+    name = "sandbox-store-overlay";
+    inherit inputs secret;
+    buildCommand = ''
+      count=0
+      for i in $inputs; do
+        cat $i/value > /dev/null
+        count=$((count + 1))
+      done
+
+      if test -e "$secret"; then
+        echo "$secret is visible in the sandbox"
+        exit 1
+      fi
+
+      echo $count > $out
+    '';
+  };
+}
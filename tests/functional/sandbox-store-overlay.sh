@@ -0,0 +1,36 @@
+#!/usr/bin/env bash
+
+source common.sh
+
+needLocalStore "the sandbox only runs on the builder side, so it makes no sense to test it with the daemon"
+
+TODO_NixOS
+
+requireSandboxSupport
+requiresUnprivilegedUserNamespaces
+
+# See linux-sandbox.sh.
+if [[ ! $SHELL =~ /nix/store ]]; then skipTest "Shell is not from Nix store"; fi
+nix-sandbox-build () { nix-build --no-out-link --sandbox-paths /nix/store --option sandbox-store-overlay true "$@"; }
+
+export NIX_STORE_DIR=/my/store
+export NIX_REMOTE=$TEST_ROOT/store0
+
+# The number of inputs of the test build. Raise it to compare the
+# setup time of the overlay, which is logged below, with that of bind
+# mounts (`--option sandbox-store-overlay false`).
+n=${SANDBOX_STORE_OVERLAY_INPUTS:-50}
+
+secret=$(nix-sandbox-build sandbox-store-overlay.nix --arg n "$n" -A secretPath)
+
+# All inputs are visible in the sandbox, and other store paths are not.
+outPath=$(nix-sandbox-build sandbox-store-overlay.nix --arg n "$n" --argstr secret "$secret" -A check -vvv 2> "$TEST_ROOT"/log)
+[[ $(cat "$outPath") = "$n" ]]
+
+# The overlay needs root, to set the `trusted.*` attributes that
+# select the inputs. Otherwise the build must fall back to bind mounts.
+if grepQuiet "set up the store overlay with $n inputs" "$TEST_ROOT"/log; then
+    grep "set up the store overlay" "$TEST_ROOT"/log >&2
+else
+    grepQuiet "cannot set up the store overlay" "$TEST_ROOT"/log
+fi
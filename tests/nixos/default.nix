@@ -158,6 +158,8 @@ in
 
   nix-copy-closure = runNixOSTest ./nix-copy-closure.nix;
 
+  ssh-control-persist = runNixOSTest ./ssh-control-persist.nix;
+
   nix-copy = runNixOSTest ./nix-copy.nix;
 
   nix-docker = runNixOSTest ./nix-docker.nix;
@@ -200,6 +202,8 @@ in
 
   cgroups = runNixOSTest ./cgroups;
 
+  sandbox-store-overlay = runNixOSTest ./sandbox-store-overlay;
+
   fetchurl = runNixOSTest ./fetchurl.nix;
 
   fetchersSubstitute = runNixOSTest ./fetchers-substitute.nix;
@@ -0,0 +1,46 @@
+{ pkgs, ... }:
+
+let
+  # A directory that is an input of the test build.
+  input = pkgs.writeTextDir "share/input" "hello";
+
+  # A store path that is in the store, but isn't an input of the test
+  # build.
+  secret = pkgs.writeTextDir "share/secret" "secret";
+in
+
+{
+  name = "sandbox-store-overlay";
+
+  nodes.machine =
+    { pkgs, ... }:
+    {
+      virtualisation.additionalPaths = [
+        input
+        secret
+        pkgs.busybox
+      ];
+      nix.settings.sandbox-store-overlay = true;
+      nix.settings.substituters = [ ];
+    };
+
+  testScript =
+    { nodes }:
+    ''
+      start_all()
+
+      machine.wait_for_unit("multi-user.target")
+
+      log = machine.succeed(
+        "nix-build --no-out-link -vvv ${./test.nix}"
+        " --argstr system ${pkgs.stdenv.hostPlatform.system}"
+        " --argstr busybox ${pkgs.busybox}"
+        " --argstr input ${input}"
+        " --argstr secret ${secret} 2>&1"
+      )
+
+      # The inputs must come from the overlay, not from bind mounts.
+      assert "set up the store overlay" in log, "the store overlay was not used"
+      assert "cannot set up the store overlay" not in log, "the store overlay failed"
+    '';
+}
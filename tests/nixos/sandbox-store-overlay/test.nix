@@ -0,0 +1,37 @@
+{
+  system,
+  busybox,
+  input,
+  secret,
+}:
+
+let
+  busybox' = builtins.storePath busybox;
+  input' = builtins.storePath input;
+in
+
+derivation {
+  name = "sandbox-store-overlay-test";
+  inherit system;
+  builder = "${busybox'}/bin/sh";
+  args = [
+    "-c"
+    ''
+      set -e
+      PATH=${busybox'}/bin
+
+      # Inputs are visible.
+      cat ${input'}/share/input > $out
+
+      # Store paths that aren't inputs are not, even if they exist in
+      # the host store.
+      if test -e ${secret}; then
+        echo "${secret} is visible in the sandbox"
+        exit 1
+      fi
+
+      # The output can be read back.
+      test "$(cat $out)" = hello
+    ''
+  ];
+}
@@ -0,0 +1,88 @@
+# Test that SSH stores with `control-persist` share one master
+# connection between Nix processes, and that it expires after the
+# given idle time.
+
+{
+  lib,
+  config,
+  nixpkgs,
+  ...
+}:
+
+let
+  pkgs = config.nodes.client.nixpkgs.pkgs;
+
+  pkgA = pkgs.hello;
+
+in
+{
+  name = "ssh-control-persist";
+
+  nodes = {
+    client =
+      { lib, ... }:
+      {
+        virtualisation.writableStore = true;
+        nix.settings.substituters = lib.mkForce [ ];
+      };
+
+    server =
+      { ... }:
+      {
+        services.openssh.enable = true;
+        virtualisation.writableStore = true;
+        virtualisation.additionalPaths = [ pkgA ];
+      };
+  };
+
+  testScript =
+    { nodes }:
+    /* python */ ''
+      # fmt: off
+      import subprocess
+
+      start_all()
+
+      # Create an SSH key on the client.
+      subprocess.run([
+        "${pkgs.openssh}/bin/ssh-keygen", "-t", "ed25519", "-f", "key", "-N", ""
+      ], capture_output=True, check=True)
+
+      client.copy_from_host("key", "/root/.ssh/id_ed25519")
+      client.succeed("chmod 600 /root/.ssh/id_ed25519")
+
+      # Install the SSH key on the server.
+      server.copy_from_host("key.pub", "/root/.ssh/authorized_keys")
+      server.wait_for_unit("sshd")
+      server.wait_for_unit("multi-user.target")
+      server.wait_for_unit("network-addresses-eth1.service")
+
+      client.wait_for_unit("network-addresses-eth1.service")
+      client.succeed(f"ssh -o StrictHostKeyChecking=no {server.name} 'echo hello world'")
+
+      def logins():
+          return int(server.succeed("journalctl -u sshd | grep -c 'Accepted publickey' || true"))
+
+      store = "ssh://root@server?control-persist=10"
+
+      # The first connection starts a master that outlives the process.
+      before = logins()
+      client.succeed(f"nix path-info --store '{store}' ${pkgA} >&2")
+      assert logins() == before + 1, "expected one new SSH login"
+      socket = client.succeed("echo /root/.cache/nix/ssh/*.sock").strip()
+      client.succeed(f"ssh -O check -S {socket} root@server")
+
+      # Subsequent processes reuse it instead of logging in again.
+      for _ in range(3):
+          client.succeed(f"nix path-info --store '{store}' ${pkgA} >&2")
+      assert logins() == before + 1, "the SSH master connection was not reused"
+
+      # Once idle for longer than control-persist, the master exits.
+      client.wait_until_fails(f"ssh -O check -S {socket} root@server", timeout=60)
+
+      # The next connection starts a new master.
+      client.succeed(f"nix path-info --store '{store}' ${pkgA} >&2")
+      assert logins() == before + 2, "expected a new SSH login after the master expired"
+      client.succeed(f"ssh -O check -S {socket} root@server")
+    '';
+}